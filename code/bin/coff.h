@@ -47,3 +47,70 @@ struct scnhdr {
     long            s_flags;        /* flags */
 };
 
+
+/* The symbol table.  f_symptr points at a symbolic header, which says
+ * where everything else is; all the offsets in it are from the start
+ * of the file.  We only use the tables needed to name procedures:
+ * the external symbols, and each source file's local symbols.
+ */
+
+typedef struct symhdr {
+    short   magic;          /* SYMMAGIC                             */
+    short   vstamp;         /* version stamp                        */
+    long    ilineMax;       /* number of line number entries        */
+    long    cbLine;         /* size of line number table            */
+    long    cbLineOffset;   /* offset of line number table          */
+    long    idnMax;         /* max index into dense number table    */
+    long    cbDnOffset;     /* offset of dense number table         */
+    long    ipdMax;         /* number of procedure descriptors      */
+    long    cbPdOffset;     /* offset of procedure descriptors      */
+    long    isymMax;        /* number of local symbols              */
+    long    cbSymOffset;    /* offset of local symbols              */
+    long    ioptMax;        /* size of optimization symbol table    */
+    long    cbOptOffset;    /* offset of optimization symbol table  */
+    long    iauxMax;        /* number of auxiliary symbols          */
+    long    cbAuxOffset;    /* offset of auxiliary symbols          */
+    long    issMax;         /* size of local string table           */
+    long    cbSsOffset;     /* offset of local string table         */
+    long    issExtMax;      /* size of external string table        */
+    long    cbSsExtOffset;  /* offset of external string table      */
+    long    ifdMax;         /* number of file descriptors           */
+    long    cbFdOffset;     /* offset of file descriptors           */
+    long    crfd;           /* number of relative file descriptors  */
+    long    cbRfdOffset;    /* offset of relative file descriptors  */
+    long    iextMax;        /* number of external symbols           */
+    long    cbExtOffset;    /* offset of external symbols           */
+} HDRR;
+
+#define SYMMAGIC        0x7009
+
+typedef struct symr {
+    long    iss;            /* offset of name in a string table     */
+    long    value;          /* address, for procedures              */
+    unsigned long bits;     /* symbol type in the low 6 bits,       */
+                            /* storage class in the next 5          */
+} SYMR;
+
+#define SymType(s)      ((s)->bits & 0x3f)
+#define SymClass(s)     (((s)->bits >> 6) & 0x1f)
+
+#define stGlobal        1
+#define stLabel         5
+#define stProc          6
+#define stStaticProc    14
+#define scText          1
+
+typedef struct extr {
+    unsigned short flags;   /* jump table, weak, ...                */
+    short   ifd;            /* file the symbol is defined in        */
+    SYMR    asym;           /* the symbol; iss is into the external */
+                            /* string table                         */
+} EXTR;
+
+/* A file descriptor is 72 bytes; we only need the bases and count of
+ * its local symbols, which are at these byte offsets.
+ */
+#define FDRSIZE         72
+#define FDR_ISSBASE     8       /* its strings in the local string table */
+#define FDR_ISYMBASE    16      /* its first local symbol */
+#define FDR_CSYM        20      /* how many local symbols it has */
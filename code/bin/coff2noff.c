@@ -30,6 +30,7 @@
 #include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "coff.h"
 #include "noff.h"
@@ -90,13 +91,135 @@ void Write(int fd, char *buf, int nBytes)
     }
 }
 
+/* The procedures found in the symbol table, for the ".sym" file */
+struct procSymbol {
+    unsigned int addr;
+    char *name;
+};
+
+struct procSymbol *procs = NULL;
+int numProcs = 0, maxProcs = 0;
+
+/* remember "sym" if it names a procedure; its name is at offset
+ * sym->iss of "strings", which is "stringSize" bytes long
+ */
+void AddSymbol(SYMR *sym, char *strings, long stringSize)
+{
+    SYMR s;
+
+    s.iss = WordToHost(sym->iss);
+    s.value = WordToHost(sym->value);
+    s.bits = WordToHost(sym->bits);
+    if (SymClass(&s) != scText || (SymType(&s) != stProc
+            && SymType(&s) != stStaticProc && SymType(&s) != stGlobal))
+        return;
+    if (s.iss < 0 || s.iss >= stringSize)
+        return;
+    if (numProcs == maxProcs) {
+        maxProcs = maxProcs ? 2 * maxProcs : 64;
+        procs = (struct procSymbol *) realloc(procs,
+                                              maxProcs * sizeof(struct procSymbol));
+    }
+    procs[numProcs].addr = s.value;
+    procs[numProcs].name = strings + s.iss;
+    numProcs++;
+}
+
+int CompareProcs(const void *a, const void *b)
+{
+    unsigned int x = ((struct procSymbol *) a)->addr;
+    unsigned int y = ((struct procSymbol *) b)->addr;
+
+    return (x < y) ? -1 : (x > y);
+}
+
+/* read "size" bytes at "offset" into a new buffer */
+char *ReadTable(int fd, long offset, long size)
+{
+    char *buffer = malloc(size > 0 ? size : 1);
+
+    lseek(fd, offset, 0);
+    Read(fd, buffer, size);
+    return buffer;
+}
+
+/* Write the address and name of every procedure in the COFF file to
+ * "symFileName", one per line, sorted by address.  Nachos reads this
+ * to name procedures when profiling user programs (machine/profile.cc).
+ * Global procedures come from the external symbols, and static ones
+ * from each source file's local symbols.  If there is no symbol
+ * table, the file is left empty.
+ */
+void WriteSymbols(int fdIn, struct filehdr *fileh, char *symFileName)
+{
+    HDRR hdr;
+    EXTR *exts;
+    SYMR *syms;
+    char *extStrings, *strings, *fdrs, *fdr;
+    long issBase, isymBase, csym;
+    FILE *out;
+    int i, j;
+
+    out = fopen(symFileName, "w");
+    if (out == NULL) {
+        perror(symFileName);
+        return;
+    }
+    if (WordToHost(fileh->f_symptr) == 0) {
+        fclose(out);
+        return;
+    }
+    lseek(fdIn, WordToHost(fileh->f_symptr), 0);
+    ReadStruct(fdIn, hdr);
+    if (ShortToHost(hdr.magic) != SYMMAGIC) {
+        fprintf(stderr, "Symbol table has a bad magic number, ignored\n");
+        fclose(out);
+        return;
+    }
+
+    exts = (EXTR *) ReadTable(fdIn, WordToHost(hdr.cbExtOffset),
+                              WordToHost(hdr.iextMax) * sizeof(EXTR));
+    extStrings = ReadTable(fdIn, WordToHost(hdr.cbSsExtOffset),
+                           WordToHost(hdr.issExtMax));
+    for (i = 0; i < WordToHost(hdr.iextMax); i++)
+        AddSymbol(&exts[i].asym, extStrings, WordToHost(hdr.issExtMax));
+
+    fdrs = ReadTable(fdIn, WordToHost(hdr.cbFdOffset),
+                     WordToHost(hdr.ifdMax) * FDRSIZE);
+    syms = (SYMR *) ReadTable(fdIn, WordToHost(hdr.cbSymOffset),
+                              WordToHost(hdr.isymMax) * sizeof(SYMR));
+    strings = ReadTable(fdIn, WordToHost(hdr.cbSsOffset),
+                        WordToHost(hdr.issMax));
+    for (i = 0; i < WordToHost(hdr.ifdMax); i++) {
+        fdr = fdrs + i * FDRSIZE;
+        issBase = WordToHost(*(unsigned int *) (fdr + FDR_ISSBASE));
+        isymBase = WordToHost(*(unsigned int *) (fdr + FDR_ISYMBASE));
+        csym = WordToHost(*(unsigned int *) (fdr + FDR_CSYM));
+        if (issBase < 0 || issBase > WordToHost(hdr.issMax))
+            continue;
+        for (j = isymBase; j < isymBase + csym && j < WordToHost(hdr.isymMax); j++)
+            AddSymbol(&syms[j], strings + issBase,
+                      WordToHost(hdr.issMax) - issBase);
+    }
+
+    /* the same procedure is usually both external and local */
+    qsort(procs, numProcs, sizeof(struct procSymbol), CompareProcs);
+    for (i = j = 0; i < numProcs; i++)
+        if (i == 0 || procs[i].addr != procs[i - 1].addr) {
+            fprintf(out, "%x %s\n", procs[i].addr, procs[i].name);
+            j++;
+        }
+    printf("%d procedures written to %s\n", j, symFileName);
+    fclose(out);
+}
+
 main (int argc, char **argv)
 {
     int fdIn, fdOut, numsections, i, inNoffFile;
     struct filehdr fileh;
     struct aouthdr systemh;
     struct scnhdr *sections;
-    char *buffer;
+    char *buffer, *symFileName;
     NoffHeader noffH;
 
     if (argc < 2) {
@@ -224,6 +347,11 @@ main (int argc, char **argv)
     }
     lseek(fdOut, 0, 0);
     Write(fdOut, (char *)&noffH, sizeof(NoffHeader));
+
+    /* save the procedure names alongside, in <noffFileName>.sym */
+    symFileName = malloc(strlen(argv[2]) + 5);
+    sprintf(symFileName, "%s.sym", argv[2]);
+    WriteSymbols(fdIn, &fileh, symFileName);
     close(fdIn);
     close(fdOut);
     exit(0);
@@ -0,0 +1,414 @@
+/* tracesim.c
+ *
+ * Replay a memory reference trace written by "nachos -mt <file>" (see
+ * machine/memtrace.h), and print how many page faults a memory of
+ * every size, from one page up, would have taken under FIFO, clock,
+ * LRU and OPT replacement.  The same numbers are the misses of a
+ * fully associative TLB with that many entries, if it were tagged by
+ * process rather than flushed on every context switch.
+ *
+ * LRU and OPT are stack algorithms: a memory of n+1 pages always holds
+ * whatever a memory of n pages would, and one more.  So one pass that
+ * finds each reference's depth in the LRU (or OPT) stack gives the
+ * fault count for every memory size at once.  FIFO and clock are not,
+ * so they are simulated for every size side by side, in the same pass.
+ *
+ * A page is a (process, virtual page) pair, and replacement is global,
+ * as it is in the Nachos core map.  A reference to the page referenced
+ * just before it can't fault under any of these policies, so runs of
+ * them are merged before simulating.
+ *
+ * usage: tracesim [-x] [-m maxPages] traceFile
+ *	-x	leave out instruction fetches
+ *	-m	only report memory sizes up to maxPages
+ *
+ * Copyright (c) 1992-1993 The Regents of the University of California.
+ * All rights reserved.  See copyright.h for copyright notice and limitation
+ * of liability and disclaimer of warranty provisions.
+ */
+
+#define MAIN
+#include "copyright.h"
+#undef MAIN
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TraceMagic	0x4e545243	/* as in machine/memtrace.h */
+#define NEVER		0x7fffffff	/* next use of a page not used again */
+
+/* the trace, read into memory */
+unsigned char *trace;
+int traceSize, tracePos;
+
+/* pages, numbered densely as they are first seen */
+int *pageProcess, *pageNumber;	/* what each page number stands for */
+int numPages, maxPages;
+int *hashTable, hashSize;	/* page number + 1 for each (process, vpn) */
+
+/* merged references, as page numbers */
+int *refs, numRefs, maxRefs;
+
+void *Allocate(int bytes)
+{
+    void *p = malloc(bytes > 0 ? bytes : 1);
+
+    if (p == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    memset(p, 0, bytes);
+    return p;
+}
+
+void *Grow(void *p, int bytes)
+{
+    p = realloc(p, bytes);
+    if (p == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+/* read a 4 byte little-endian word from the trace header */
+unsigned int GetWord(int pos)
+{
+    return trace[pos] | (trace[pos + 1] << 8) | (trace[pos + 2] << 16)
+           | ((unsigned int) trace[pos + 3] << 24);
+}
+
+/* read the next varint from the trace */
+unsigned int GetNumber()
+{
+    unsigned int n = 0;
+    int shift = 0;
+
+    while (tracePos < traceSize) {
+        n |= (trace[tracePos] & 0x7f) << shift;
+        if (!(trace[tracePos++] & 0x80))
+            return n;
+        shift += 7;
+    }
+    fprintf(stderr, "Trace ends in the middle of a record\n");
+    exit(1);
+}
+
+unsigned int Hash(int process, int vpn)
+{
+    return (process * 0x9e3779b1u) ^ (vpn * 0x85ebca6bu);
+}
+
+/* return the page number of "vpn" in "process", making one if needed */
+int PageFor(int process, int vpn)
+{
+    unsigned int i;
+    int page, *old, oldSize;
+
+    for (i = Hash(process, vpn) & (hashSize - 1); hashTable[i] != 0;
+         i = (i + 1) & (hashSize - 1)) {
+        page = hashTable[i] - 1;
+        if (pageProcess[page] == process && pageNumber[page] == vpn)
+            return page;
+    }
+
+    if (numPages == maxPages) {
+        maxPages = maxPages ? 2 * maxPages : 256;
+        pageProcess = Grow(pageProcess, maxPages * sizeof(int));
+        pageNumber = Grow(pageNumber, maxPages * sizeof(int));
+    }
+    page = numPages++;
+    pageProcess[page] = process;
+    pageNumber[page] = vpn;
+    hashTable[i] = page + 1;
+
+    if (2 * numPages > hashSize) {	/* keep the table half empty */
+        old = hashTable;
+        oldSize = hashSize;
+        hashSize *= 2;
+        hashTable = Allocate(hashSize * sizeof(int));
+        for (oldSize--; oldSize >= 0; oldSize--)
+            if (old[oldSize] != 0) {
+                page = old[oldSize] - 1;
+                for (i = Hash(pageProcess[page], pageNumber[page])
+                         & (hashSize - 1);
+                     hashTable[i] != 0; i = (i + 1) & (hashSize - 1))
+                    ;
+                hashTable[i] = page + 1;
+            }
+        free(old);
+    }
+    return page;
+}
+
+/* the number of faults for each memory size, from "depths", the
+ * histogram of stack depths (0 for a first reference)
+ */
+void FaultsFromDepths(int *depths, int *faults, int sizes)
+{
+    int n, beyond = depths[0];	/* first references always fault */
+
+    for (n = numPages; n > sizes; n--)
+        beyond += depths[n];
+    for (n = sizes; n >= 1; n--) {
+        faults[n] = beyond;
+        beyond += depths[n];
+    }
+}
+
+/* depth of "page" in "stack" (1 is the top), or 0 if it isn't there */
+int Depth(int *stack, int height, int page)
+{
+    int i;
+
+    for (i = 0; i < height; i++)
+        if (stack[i] == page)
+            return i + 1;
+    return 0;
+}
+
+/* LRU: a reference moves its page to the top of the stack */
+void SimulateLRU(int *faults, int sizes)
+{
+    int *stack = Allocate(numPages * sizeof(int));
+    int *depths = Allocate((numPages + 1) * sizeof(int));
+    int height = 0, t, i, d;
+
+    for (t = 0; t < numRefs; t++) {
+        d = Depth(stack, height, refs[t]);
+        depths[d]++;
+        if (d == 0)
+            d = ++height;
+        for (i = d - 1; i > 0; i--)
+            stack[i] = stack[i - 1];
+        stack[0] = refs[t];
+    }
+    FaultsFromDepths(depths, faults, sizes);
+    free(stack);
+    free(depths);
+}
+
+/* OPT: the referenced page goes to the top of the stack; below it,
+ * at each level down to where it came from, the page that will be
+ * referenced sooner stays and the other is pushed down a level
+ */
+void SimulateOPT(int *faults, int sizes)
+{
+    int *stack = Allocate(numPages * sizeof(int));
+    int *depths = Allocate((numPages + 1) * sizeof(int));
+    int *nextUse = Allocate(numRefs * sizeof(int));
+    int *pageNextUse = Allocate(numPages * sizeof(int));
+    int height = 0, t, i, d, carry, swap;
+
+    for (i = 0; i < numPages; i++)
+        pageNextUse[i] = NEVER;
+    for (t = numRefs - 1; t >= 0; t--) {
+        nextUse[t] = pageNextUse[refs[t]];
+        pageNextUse[refs[t]] = t;
+    }
+
+    for (t = 0; t < numRefs; t++) {
+        d = Depth(stack, height, refs[t]);
+        depths[d]++;
+        pageNextUse[refs[t]] = nextUse[t];
+        if (d == 0)
+            d = ++height;
+        if (d == 1)
+            continue;
+        carry = stack[0];
+        stack[0] = refs[t];
+        for (i = 1; i < d - 1; i++)
+            if (pageNextUse[stack[i]] > pageNextUse[carry]) {
+                swap = stack[i];
+                stack[i] = carry;
+                carry = swap;
+            }
+        stack[d - 1] = carry;
+    }
+    FaultsFromDepths(depths, faults, sizes);
+    free(stack);
+    free(depths);
+    free(nextUse);
+    free(pageNextUse);
+}
+
+/* FIFO and clock, for every memory size from 1 to "sizes" */
+void SimulateFIFOAndClock(int *fifoFaults, int *clockFaults, int sizes)
+{
+    int **fifoFrames = Allocate((sizes + 1) * sizeof(int *));
+    int **fifoSlot = Allocate((sizes + 1) * sizeof(int *));
+    int **clockFrames = Allocate((sizes + 1) * sizeof(int *));
+    int **clockSlot = Allocate((sizes + 1) * sizeof(int *));
+    char **clockUse = Allocate((sizes + 1) * sizeof(char *));
+    int *fifoHand = Allocate((sizes + 1) * sizeof(int));
+    int *clockHand = Allocate((sizes + 1) * sizeof(int));
+    int *filled = Allocate((sizes + 1) * sizeof(int));
+    int n, t, i, page, slot;
+
+    for (n = 1; n <= sizes; n++) {
+        fifoFrames[n] = Allocate(n * sizeof(int));
+        clockFrames[n] = Allocate(n * sizeof(int));
+        clockUse[n] = Allocate(n);
+        fifoSlot[n] = Allocate(numPages * sizeof(int));
+        clockSlot[n] = Allocate(numPages * sizeof(int));
+        for (i = 0; i < numPages; i++)
+            fifoSlot[n][i] = clockSlot[n][i] = -1;
+    }
+
+    for (t = 0; t < numRefs; t++) {
+        page = refs[t];
+        for (n = 1; n <= sizes; n++) {
+            /* both fill up the same way, and fault together until full */
+            if (filled[n] < n && fifoSlot[n][page] < 0) {
+                slot = filled[n]++;
+                fifoFrames[n][slot] = clockFrames[n][slot] = page;
+                fifoSlot[n][page] = clockSlot[n][page] = slot;
+                clockUse[n][slot] = 1;
+                fifoFaults[n]++;
+                clockFaults[n]++;
+                continue;
+            }
+
+            if (fifoSlot[n][page] < 0) {
+                slot = fifoHand[n];
+                fifoHand[n] = (slot + 1) % n;
+                fifoSlot[n][fifoFrames[n][slot]] = -1;
+                fifoFrames[n][slot] = page;
+                fifoSlot[n][page] = slot;
+                fifoFaults[n]++;
+            }
+
+            slot = clockSlot[n][page];
+            if (slot >= 0) {
+                clockUse[n][slot] = 1;
+                continue;
+            }
+            while (clockUse[n][clockHand[n]]) {
+                clockUse[n][clockHand[n]] = 0;
+                clockHand[n] = (clockHand[n] + 1) % n;
+            }
+            slot = clockHand[n];
+            clockHand[n] = (slot + 1) % n;
+            clockSlot[n][clockFrames[n][slot]] = -1;
+            clockFrames[n][slot] = page;
+            clockSlot[n][page] = slot;
+            clockUse[n][slot] = 1;
+            clockFaults[n]++;
+        }
+    }
+
+    for (n = 1; n <= sizes; n++) {
+        free(fifoFrames[n]);
+        free(fifoSlot[n]);
+        free(clockFrames[n]);
+        free(clockSlot[n]);
+        free(clockUse[n]);
+    }
+}
+
+main(int argc, char **argv)
+{
+    char *fileName = NULL;
+    FILE *file;
+    int noFetches = 0, maxSize = 0, pageSize, sizes, n;
+    int lastAddr[3], lastProcess = -1, counts[3], numProcesses = 0;
+    int process, addr, kind, page, lastPage = -1;
+    unsigned int record, zigzag;
+    int *lruFaults, *optFaults, *fifoFaults, *clockFaults;
+
+    for (argc--, argv++; argc > 0; argc--, argv++) {
+        if (!strcmp(*argv, "-x"))
+            noFetches = 1;
+        else if (!strcmp(*argv, "-m") && argc > 1) {
+            maxSize = atoi(*++argv);
+            argc--;
+        } else if (**argv != '-' && fileName == NULL)
+            fileName = *argv;
+        else
+            fileName = NULL, argc = 0;
+    }
+    if (fileName == NULL) {
+        fprintf(stderr, "Usage: tracesim [-x] [-m maxPages] traceFile\n");
+        exit(1);
+    }
+
+    /* read the whole trace */
+    file = fopen(fileName, "rb");
+    if (file == NULL) {
+        perror(fileName);
+        exit(1);
+    }
+    fseek(file, 0, SEEK_END);
+    traceSize = ftell(file);
+    rewind(file);
+    trace = Allocate(traceSize);
+    if (fread(trace, 1, traceSize, file) != traceSize || traceSize < 8
+            || GetWord(0) != TraceMagic) {
+        fprintf(stderr, "%s is not a Nachos memory trace\n", fileName);
+        exit(1);
+    }
+    fclose(file);
+    pageSize = GetWord(4);
+    tracePos = 8;
+
+    /* decode it into merged page references */
+    hashSize = 1024;
+    hashTable = Allocate(hashSize * sizeof(int));
+    process = 0;
+    for (kind = 0; kind < 3; kind++)
+        lastAddr[kind] = counts[kind] = 0;
+    while (tracePos < traceSize) {
+        record = GetNumber();
+        kind = record & 3;
+        if (record & 4) {
+            process = GetNumber();
+            if (process != lastProcess)
+                numProcesses++;		/* counts switches back, too */
+            lastProcess = process;
+        }
+        if (kind > 2) {
+            fprintf(stderr, "Bad record in the trace\n");
+            exit(1);
+        }
+        zigzag = record >> 3;
+        addr = lastAddr[kind] + (int) ((zigzag >> 1) ^ -(zigzag & 1));
+        lastAddr[kind] = addr;
+        counts[kind]++;
+
+        if (noFetches && kind == 0)
+            continue;
+        page = PageFor(process, (unsigned) addr / pageSize);
+        if (page == lastPage)
+            continue;
+        if (numRefs == maxRefs) {
+            maxRefs = maxRefs ? 2 * maxRefs : 65536;
+            refs = Grow(refs, maxRefs * sizeof(int));
+        }
+        refs[numRefs++] = lastPage = page;
+    }
+
+    printf("%d references: %d fetches, %d loads, %d stores\n",
+           counts[0] + counts[1] + counts[2], counts[0], counts[1], counts[2]);
+    printf("%d pages of %d bytes touched, %d page references after merging "
+           "repeats, %d process switches\n",
+           numPages, pageSize, numRefs, numProcesses);
+    if (numPages == 0)
+        exit(0);
+
+    /* past numPages, every policy only takes the first-reference faults */
+    sizes = (maxSize > 0 && maxSize < numPages) ? maxSize : numPages;
+    lruFaults = Allocate((sizes + 1) * sizeof(int));
+    optFaults = Allocate((sizes + 1) * sizeof(int));
+    fifoFaults = Allocate((sizes + 1) * sizeof(int));
+    clockFaults = Allocate((sizes + 1) * sizeof(int));
+    SimulateLRU(lruFaults, sizes);
+    SimulateOPT(optFaults, sizes);
+    SimulateFIFOAndClock(fifoFaults, clockFaults, sizes);
+
+    printf("\n  pages        FIFO       clock         LRU         OPT\n");
+    for (n = 1; n <= sizes; n++)
+        printf("%7d %11d %11d %11d %11d\n", n, fifoFaults[n], clockFaults[n],
+               lruFaults[n], optFaults[n]);
+    exit(0);
+}
@@ -0,0 +1,690 @@
+// bufcache.cc
+//	Routines to cache disk sectors in memory.  See bufcache.h.
+//
+//	A thread using a sector first finds (or loads) its buffer with
+//	Get, holding the cache-wide lock only while it looks, then waits
+//	for the buffer's own lock.  The buffer can't be given to another
+//	sector in between, because it has a user.  Only buffers with no
+//	users, and nothing dirty in them, are ever re-used; a dirty victim
+//	is written back first, and then looked for again.
+//
+//	Read-ahead and write-behind are queued as CacheJobs for the worker
+//	thread.  They can't be done by an interrupt handler, which must not
+//	wait for a buffer's lock.
+//
+//	A thread writing back a run of buffers holds all their locks at
+//	once.  It takes them in order of the sectors the buffers hold once
+//	it has pinned them, so that they can't change, and any other
+//	thread holds at most one buffer's lock that it may have to wait
+//	for, so they can't deadlock.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "bufcache.h"
+#include "system.h"
+
+// A run of sectors to read ahead, or to write behind, queued for the
+// worker.
+class CacheJob {
+public:
+    CacheJob(int s, int n, bool w) {
+        sector = s;
+        numSectors = n;
+        writing = w;
+    }
+    int sector;
+    int numSectors;
+    bool writing;
+};
+
+//----------------------------------------------------------------------
+// CacheFlushDue, CacheFlusher, CacheWorker
+// 	Interrupt handler for the flush interrupt, and the flusher and
+//	worker threads' bodies.  Need these to be C routines, because C++
+//	can't handle pointers to member functions.
+//----------------------------------------------------------------------
+
+static void
+CacheFlushDue(int arg)
+{
+    BufferCache *cache = (BufferCache *) arg;
+
+    cache->FlushDue();
+}
+
+static void
+CacheFlusher(int arg)
+{
+    BufferCache *cache = (BufferCache *) arg;
+
+    cache->Flusher();
+}
+
+static void
+CacheWorker(int arg)
+{
+    BufferCache *cache = (BufferCache *) arg;
+
+    cache->Worker();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::BufferCache
+// 	Initialize an empty cache, and start the thread that writes back
+//	dirty sectors, and the one that reads ahead and writes behind.
+//
+//	"nBuffers" -- how many sectors to cache
+//----------------------------------------------------------------------
+
+BufferCache::BufferCache(int nBuffers)
+{
+    numBuffers = nBuffers;
+    buffers = new CacheBuffer[numBuffers];
+    hashTable = new CacheBuffer *[numBuffers];
+    for (int i = 0; i < numBuffers; i++) {
+        buffers[i].sector = -1;
+        buffers[i].valid = FALSE;
+        buffers[i].dirty = FALSE;
+        buffers[i].use = FALSE;
+        buffers[i].users = 0;
+        buffers[i].lock = new Lock("cache buffer");
+        buffers[i].hashNext = NULL;
+        hashTable[i] = NULL;
+    }
+    hand = 0;
+    lock = new Lock("buffer cache");
+    bufferFree = new Condition("buffer free");
+    flushScheduled = FALSE;
+    flushRequest = new Semaphore("cache flush", 0);
+    jobs = new List;
+    jobRequest = new Semaphore("cache job", 0);
+    workerBusy = FALSE;
+    workerIdle = new Condition("cache worker idle");
+
+    Thread *t = new Thread("cache flusher");
+
+    t->Fork(CacheFlusher, (int) this);
+    t = new Thread("cache worker");
+    t->Fork(CacheWorker, (int) this);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::~BufferCache
+// 	De-allocate the cache.  Anything still dirty is lost; call
+//	Flush first to keep it.
+//----------------------------------------------------------------------
+
+BufferCache::~BufferCache()
+{
+    for (int i = 0; i < numBuffers; i++)
+        delete buffers[i].lock;
+    delete [] buffers;
+    delete [] hashTable;
+    delete lock;
+    delete bufferFree;
+    delete flushRequest;
+    delete jobs;
+    delete jobRequest;
+    delete workerIdle;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::ReadSector/WriteSector
+// 	Read or write a whole sector, through the cache.
+//
+//	"sector" -- the disk sector to read or write
+//	"data" -- SectorSize bytes to read into, or to write
+//	"metadata" -- FALSE if the sector is file data
+//----------------------------------------------------------------------
+
+void
+BufferCache::ReadSector(int sector, char *data)
+{
+    ReadBytes(sector, data, 0, SectorSize);
+}
+
+void
+BufferCache::WriteSector(int sector, char *data, bool metadata)
+{
+    WriteBytes(sector, data, 0, SectorSize, metadata);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::ReadBytes/WriteBytes
+// 	Read or write part of a sector, through the cache.  If a write
+//	covers the whole sector, there is no need to read it in first.
+//
+//	A metadata write is given to the journal.  A data write isn't,
+//	but first lets the journal make sure that the sector can't be
+//	put back as metadata after a crash.
+//
+//	"sector" -- the disk sector to read or write
+//	"into" -- the buffer to read into
+//	"from" -- the data to write
+//	"offset" -- where in the sector to start
+//	"numBytes" -- how many bytes to transfer
+//	"metadata" -- FALSE if the sector is file data
+//----------------------------------------------------------------------
+
+void
+BufferCache::ReadBytes(int sector, char *into, int offset, int numBytes)
+{
+    CacheBuffer *buf;
+
+    ASSERT(offset >= 0 && numBytes >= 0 && offset + numBytes <= SectorSize);
+    buf = Get(sector, FALSE);
+    bcopy(&buf->data[offset], into, numBytes);
+    Put(buf, FALSE);
+}
+
+void
+BufferCache::WriteBytes(int sector, char *from, int offset, int numBytes,
+                        bool metadata)
+{
+    CacheBuffer *buf;
+
+    ASSERT(offset >= 0 && numBytes >= 0 && offset + numBytes <= SectorSize);
+    if (!metadata && journal != NULL)
+        journal->WriteData(sector);
+    buf = Get(sector, numBytes == SectorSize);
+    bcopy(from, &buf->data[offset], numBytes);
+    if (metadata && journal != NULL)
+        journal->Write(sector, buf->data);
+    Put(buf, TRUE);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Get
+// 	Return the buffer holding "sector", locked, reading the sector
+//	from disk if it isn't cached.
+//
+//	"sector" -- the disk sector wanted
+//	"overwrite" -- TRUE if the caller will overwrite the whole
+//		sector, so there's no need to read it
+//----------------------------------------------------------------------
+
+CacheBuffer *
+BufferCache::Get(int sector, bool overwrite)
+{
+    CacheBuffer *buf;
+
+    lock->Acquire();
+    for (;;) {
+        buf = Lookup(sector);
+        if (buf != NULL) {			// hit
+            stats->numCacheHits++;
+            buf->users++;
+            buf->use = TRUE;
+            lock->Release();
+            buf->lock->Acquire();	// wait for anyone still using it,
+            return buf;			// or still reading it in
+        }
+
+        buf = FindVictim();
+        if (buf == NULL) {			// all in use, wait for one
+            bufferFree->Wait(lock);
+            continue;
+        }
+        if (buf->dirty) {		// write it back, then look again
+            WriteIfDirty(&buf, 1);
+            continue;
+        }
+
+        // a clean buffer no one is using: it's ours.  Nobody holds
+        // its lock, so we get it right away, and anyone who finds it
+        // under its new sector from now on waits until it's read in.
+        stats->numCacheMisses++;
+        Rehash(buf, sector);
+        buf->valid = FALSE;
+        buf->use = TRUE;
+        buf->users++;
+        buf->lock->Acquire();
+        lock->Release();
+        if (!overwrite && (journal == NULL
+                           || !journal->Read(sector, buf->data)))
+            synchDisk->ReadSector(sector, buf->data);
+        buf->valid = TRUE;
+        return buf;
+    }
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Put
+// 	Unlock a buffer returned by Get.  If it has been changed, make sure
+//	the flusher will write it back.
+//
+//	"buf" -- the buffer, from Get
+//	"dirty" -- TRUE if the caller changed it
+//----------------------------------------------------------------------
+
+void
+BufferCache::Put(CacheBuffer *buf, bool dirty)
+{
+    if (dirty) {
+        buf->dirty = TRUE;
+        if (!flushScheduled) {
+            flushScheduled = TRUE;
+            interrupt->Schedule(CacheFlushDue, (int) this, FlushDelay,
+                                CacheFlushInt);
+        }
+    }
+    buf->lock->Release();
+    lock->Acquire();
+    Unpin(buf);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Unpin
+// 	Note that one fewer thread is using "buf", and if no one is,
+//	wake up the threads waiting for a buffer to replace, or for
+//	Invalidate's sake, for every buffer to be free.  The cache lock
+//	must be held.
+//----------------------------------------------------------------------
+
+void
+BufferCache::Unpin(CacheBuffer *buf)
+{
+    buf->users--;
+    if (buf->users == 0)
+        bufferFree->Broadcast(lock);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::WriteIfDirty
+// 	Write back those buffers of "run" that are still dirty once we
+//	have their locks -- unless the journal has the sector, and will
+//	write it.  Once the buffers are pinned, so that they keep their
+//	sectors, "run" is sorted by sector, and their locks are taken in
+//	that order.  Those written are written with one disk request for
+//	each stretch of consecutive sectors.  The cache lock must be held;
+//	it is let go while we wait, and held again on return.
+//
+//	"run" -- the buffers
+//	"count" -- how many
+//----------------------------------------------------------------------
+
+void
+BufferCache::WriteIfDirty(CacheBuffer **run, int count)
+{
+    char **data = new char *[count];
+    CacheBuffer *buf;
+    int i, j, first = 0, n = 0;
+
+    for (i = 0; i < count; i++)
+        run[i]->users++;		// so they stay these sectors
+    for (i = 1; i < count; i++) {	// ties are forgotten buffers, at -1
+        buf = run[i];
+        for (j = i; j > 0 && (run[j - 1]->sector > buf->sector
+                              || (run[j - 1]->sector == buf->sector
+                                  && run[j - 1] > buf)); j--)
+            run[j] = run[j - 1];
+        run[j] = buf;
+    }
+    lock->Release();
+    for (i = 0; i < count; i++)
+        run[i]->lock->Acquire();
+    for (i = 0; i < count; i++) {
+        if (n > 0 && run[i]->sector != first + n) {	// a gap
+            synchDisk->WriteSectors(first, n, data);
+            n = 0;
+        }
+        if (run[i]->dirty) {
+            if (journal == NULL || !journal->Holds(run[i]->sector)) {
+                if (n == 0)
+                    first = run[i]->sector;
+                data[n++] = run[i]->data;
+            }
+            run[i]->dirty = FALSE;
+        }
+    }
+    if (n > 0)
+        synchDisk->WriteSectors(first, n, data);
+    for (i = 0; i < count; i++)
+        run[i]->lock->Release();
+    lock->Acquire();
+    for (i = 0; i < count; i++)
+        Unpin(run[i]);
+    delete [] data;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::ReadRun
+// 	Read into the cache the sectors from "sector" on, up to
+//	"numSectors" of them, that aren't cached, and that the journal
+//	doesn't have, with one disk request.  Stop at the first sector
+//	that is, or when no buffer is free, rather than waiting for one.
+//	Return how many sectors were read.
+//
+//	"sector" -- the first sector to read
+//	"numSectors" -- the most to read
+//----------------------------------------------------------------------
+
+int
+BufferCache::ReadRun(int sector, int numSectors)
+{
+    CacheBuffer **run = new CacheBuffer *[numSectors];
+    char **data = new char *[numSectors];
+    CacheBuffer *buf;
+    int i, n = 0;
+
+    lock->Acquire();
+    while (n < numSectors) {
+        if (Lookup(sector + n) != NULL
+                || (journal != NULL && journal->Holds(sector + n)))
+            break;
+        buf = FindVictim();
+        if (buf == NULL)
+            break;
+        if (buf->dirty) {
+            if (n > 0)			// don't wait, holding the run
+                break;
+            WriteIfDirty(&buf, 1);	// write it back, then look again
+            continue;
+        }
+
+        // as in Get: the buffer is ours, and anyone who finds it under
+        // its new sector waits until the run has been read in
+        stats->numCacheMisses++;
+        stats->numCacheReadAheads++;
+        Rehash(buf, sector + n);
+        buf->valid = FALSE;
+        buf->use = TRUE;
+        buf->users++;
+        buf->lock->Acquire();
+        run[n] = buf;
+        data[n++] = buf->data;
+    }
+    lock->Release();
+
+    if (n > 0)
+        synchDisk->ReadSectors(sector, n, data);
+    for (i = 0; i < n; i++) {
+        run[i]->valid = TRUE;
+        Put(run[i], FALSE);
+    }
+    delete [] run;
+    delete [] data;
+    return n;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Lookup
+// 	Return the buffer for "sector", or NULL if it isn't cached.  The
+//	cache lock must be held.
+//----------------------------------------------------------------------
+
+CacheBuffer *
+BufferCache::Lookup(int sector)
+{
+    CacheBuffer *buf;
+
+    for (buf = hashTable[sector % numBuffers]; buf != NULL; buf = buf->hashNext)
+        if (buf->sector == sector)
+            return buf;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Rehash
+// 	Take "buf" out of the hash bucket for its old sector, and put it
+//	in the one for "sector".  The cache lock must be held.
+//----------------------------------------------------------------------
+
+void
+BufferCache::Rehash(CacheBuffer *buf, int sector)
+{
+    CacheBuffer **link;
+
+    if (buf->sector >= 0) {
+        for (link = &hashTable[buf->sector % numBuffers]; *link != buf;
+                link = &(*link)->hashNext)
+            ASSERT(*link != NULL);
+        *link = buf->hashNext;
+    }
+    buf->sector = sector;
+    buf->hashNext = hashTable[sector % numBuffers];
+    hashTable[sector % numBuffers] = buf;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::FindVictim
+// 	Choose a buffer to hold a sector that isn't cached, using the
+//	clock algorithm: go round the buffers no one is using, giving
+//	each that has been used recently a second chance.  Return NULL
+//	if every buffer is in use.  The cache lock must be held.
+//----------------------------------------------------------------------
+
+CacheBuffer *
+BufferCache::FindVictim()
+{
+    CacheBuffer *buf;
+
+    for (int i = 0; i < 2 * numBuffers; i++) {
+        buf = &buffers[hand];
+        hand = (hand + 1) % numBuffers;
+        if (buf->users > 0)
+            continue;
+        if (buf->use && buf->sector >= 0)
+            buf->use = FALSE;
+        else
+            return buf;
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Flush
+// 	Write back every dirty sector, and return once they are all on
+//	disk.  Sectors dirtied while we're at it may or may not be written.
+//	The journal's running transaction is committed first, so the
+//	sectors it has are on disk too, in the log.
+//----------------------------------------------------------------------
+
+void
+BufferCache::Flush()
+{
+    CacheBuffer **dirty = new CacheBuffer *[numBuffers];
+    CacheBuffer *buf;
+    int i, j, n = 0;
+
+    if (journal != NULL)
+        journal->Commit();
+    lock->Acquire();
+
+    // the dirty buffers, in order of sector number
+    for (i = 0; i < numBuffers; i++) {
+        buf = &buffers[i];
+        if (!buf->dirty)
+            continue;
+        for (j = n; j > 0 && dirty[j - 1]->sector > buf->sector; j--)
+            dirty[j] = dirty[j - 1];
+        dirty[j] = buf;
+        n++;
+    }
+
+    // write back each run of consecutive sectors together.  The cache
+    // lock is let go in between, so by the time a run is written some
+    // of its buffers may hold other sectors, or be clean; WriteIfDirty
+    // puts the run back in order, and skips those
+    for (i = 0; i < n; i = j) {
+        for (j = i + 1; j < n && dirty[j]->sector == dirty[j - 1]->sector + 1;
+                j++)
+            ;
+        WriteIfDirty(&dirty[i], j - i);
+    }
+    lock->Release();
+    delete [] dirty;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Invalidate
+// 	Forget the contents of every buffer, without writing anything
+//	back, once no one is using them.  For simulating a crash.
+//
+//	Read-ahead and write-behind not yet started are dropped, and any
+//	the worker is doing is let finish, so that nothing left over from
+//	before the crash gets into the cache, or onto the disk, after it.
+//	Nothing is forgotten until then, so that no one finds a buffer
+//	half-forgotten; then everything is, without letting go of the
+//	cache lock.
+//----------------------------------------------------------------------
+
+void
+BufferCache::Invalidate()
+{
+    CacheBuffer *buf;
+    CacheJob *job;
+    int i;
+
+    lock->Acquire();
+    for (;;) {
+        while ((job = (CacheJob *) jobs->Remove()) != NULL)
+            delete job;
+        if (workerBusy) {
+            workerIdle->Wait(lock);
+            continue;
+        }
+        for (i = 0; i < numBuffers && buffers[i].users == 0; i++)
+            ;
+        if (i == numBuffers)
+            break;
+        bufferFree->Wait(lock);		// then look at them all again
+    }
+    for (i = 0; i < numBuffers; i++) {
+        buf = &buffers[i];
+        buf->sector = -1;
+        buf->valid = FALSE;
+        buf->dirty = FALSE;
+        buf->use = FALSE;
+        buf->hashNext = NULL;
+        hashTable[i] = NULL;
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::ReadAhead/WriteBehind
+// 	Ask the worker thread to read a run of consecutive sectors into
+//	the cache, or to write back those that are dirty, and return
+//	without waiting.  Nothing is queued to read a run that is already
+//	cached.
+//
+//	"sector" -- the first disk sector to read or write
+//	"numSectors" -- how many
+//----------------------------------------------------------------------
+
+void
+BufferCache::ReadAhead(int sector, int numSectors)
+{
+    bool cached = TRUE;
+
+    lock->Acquire();
+    for (int i = 0; i < numSectors && cached; i++)
+        cached = (Lookup(sector + i) != NULL);
+    if (!cached)
+        jobs->Append((void *) new CacheJob(sector, numSectors, FALSE));
+    lock->Release();
+    if (!cached)
+        jobRequest->V();
+}
+
+void
+BufferCache::WriteBehind(int sector, int numSectors)
+{
+    lock->Acquire();
+    jobs->Append((void *) new CacheJob(sector, numSectors, TRUE));
+    lock->Release();
+    jobRequest->V();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::FlushDue
+// 	Interrupt handler: it's FlushDelay ticks since a sector was
+//	dirtied, so wake up the flusher thread.  The next sector to be
+//	dirtied will schedule another flush.
+//----------------------------------------------------------------------
+
+void
+BufferCache::FlushDue()
+{
+    flushScheduled = FALSE;
+    flushRequest->V();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Flusher
+// 	The flusher thread: write back the dirty sectors whenever
+//	FlushDue says it's time.  Never returns.
+//
+//	While a sector is dirty, a flush interrupt is pending, so Nachos
+//	won't decide it has nothing left to do and halt before the sector
+//	has been written.
+//----------------------------------------------------------------------
+
+void
+BufferCache::Flusher()
+{
+    for (;;) {
+        flushRequest->P();
+        Flush();
+    }
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Worker
+// 	The worker thread: read ahead and write behind the runs of
+//	sectors it is asked to, one run at a time, in the order asked.
+//	Sectors to be read that have been cached in the meantime are
+//	skipped, and the rest read with as few requests as they allow;
+//	the dirty sectors of a run to be written are written together.
+//	A job dropped by Invalidate is just skipped.  Never returns.
+//----------------------------------------------------------------------
+
+void
+BufferCache::Worker()
+{
+    CacheJob *job;
+    CacheBuffer **run;
+    CacheBuffer *buf;
+    int i, n;
+
+    for (;;) {
+        jobRequest->P();
+        lock->Acquire();
+        job = (CacheJob *) jobs->Remove();
+        if (job == NULL) {		// dropped by Invalidate
+            lock->Release();
+            continue;
+        }
+        workerBusy = TRUE;
+        if (job->writing) {
+            run = new CacheBuffer *[job->numSectors];
+            n = 0;
+            for (i = 0; i < job->numSectors; i++) {
+                buf = Lookup(job->sector + i);
+                if (buf != NULL && buf->dirty)
+                    run[n++] = buf;
+                else if (n > 0) {
+                    WriteIfDirty(run, n);
+                    n = 0;
+                }
+            }
+            if (n > 0)
+                WriteIfDirty(run, n);
+            delete [] run;
+        } else {
+            lock->Release();
+            for (i = 0; i < job->numSectors; i += max(n, 1))
+                n = ReadRun(job->sector + i, job->numSectors - i);
+            lock->Acquire();
+        }
+        delete job;
+        workerBusy = FALSE;
+        workerIdle->Broadcast(lock);
+        lock->Release();
+    }
+}
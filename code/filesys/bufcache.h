@@ -0,0 +1,140 @@
+// bufcache.h
+//	Data structures for a cache of disk sectors, kept in memory
+//	between the file system and the synchronous disk.
+//
+//	Every sector the file system reads or writes -- file data, file
+//	headers, the directory and the bitmap of free sectors -- goes
+//	through the cache.  Reads are satisfied from memory if the sector
+//	is cached; writes only change the cached copy, and mark it dirty.
+//	Dirty sectors are written back when their buffer is needed for
+//	another sector, when Flush is called, or by the flusher thread,
+//	FlushDelay ticks after a sector first becomes dirty.
+//
+//	Metadata sectors changed by file system operations are also given
+//	to the journal (see journal.h), and while the journal has a
+//	sector, the cache doesn't write it back, and reads it from the
+//	journal.  Writes of file data say so, and are never journaled.
+//
+//	A file being read or written sequentially can also ask for the
+//	sectors it will want next to be read ahead, and for the ones it
+//	has finished writing to be written behind.  Both are done by the
+//	cache's worker thread, so the caller doesn't wait for the disk.
+//
+//	Dirty sectors next to each other on disk are written back with
+//	one disk request, and so are runs of sectors read ahead.
+//
+//	Buffers are replaced using the clock algorithm.  Each buffer has
+//	its own lock, held while its contents are being read or changed
+//	(including while the disk is reading or writing it), so that
+//	threads using different sectors only wait for each other to look
+//	up a buffer, not for each other's disk I/O.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef BUFCACHE_H
+#define BUFCACHE_H
+
+#include "disk.h"
+#include "synch.h"
+#include "list.h"
+
+#define NumCacheBuffers	64	// sectors kept in the cache
+#define FlushDelay	50000	// ticks a sector may stay dirty before
+				// the flusher thread writes it
+
+// One sector's worth of cache.  "users" counts the threads that have
+// found this buffer and are using it or waiting for its lock; a buffer
+// with users can't be given to another sector.
+class CacheBuffer {
+public:
+    int sector;			// the sector cached here, or -1
+    bool valid;			// TRUE once "data" holds the sector
+    bool dirty;			// TRUE if "data" is newer than the disk
+    bool use;			// for the clock algorithm
+    int users;
+    Lock *lock;			// held while reading or changing "data"
+    CacheBuffer *hashNext;	// next buffer in the same hash bucket
+    char data[SectorSize];
+};
+
+// The following class defines the cache.  Callers transfer only whole
+// sectors or parts of one sector at a time; only the cache's own
+// reads and writes to the disk may be of runs of sectors.
+class BufferCache {
+public:
+    BufferCache(int numBuffers);	// Initialize an empty cache, and
+    // start the flusher and worker threads
+    ~BufferCache();			// De-allocate the cache; does not
+    // write anything back
+
+    void ReadSector(int sector, char *data);	// Read a whole sector
+    void WriteSector(int sector, char *data, bool metadata = TRUE);
+    // Write a whole sector
+
+    void ReadBytes(int sector, char *into, int offset, int numBytes);
+    // Read part of a sector
+    void WriteBytes(int sector, char *from, int offset, int numBytes,
+                    bool metadata = TRUE);
+    // Write part of a sector; file data
+    // isn't "metadata"
+
+    void Flush();			// Write back every dirty sector,
+    // returning once they're on disk
+    void Invalidate();			// Forget every sector, dirty or
+    // not, and any read-ahead or
+    // write-behind, as if the system
+    // had crashed
+
+    void ReadAhead(int sector, int numSectors);
+    // Have a run of sectors read into
+    // the cache, without waiting for it
+    void WriteBehind(int sector, int numSectors);
+    // Have a run of sectors written back,
+    // if they're dirty, without waiting
+
+    void FlushDue();			// Called by the flush interrupt
+    void Flusher();			// Loop forever, flushing the cache
+    // whenever FlushDue says to
+    void Worker();			// Loop forever, doing the read-ahead
+    // and write-behind asked for
+
+private:
+    CacheBuffer *Get(int sector, bool overwrite);
+    // Find or load "sector", and return
+    // its buffer, locked
+    void Put(CacheBuffer *buf, bool dirty);
+    // Unlock a buffer returned by Get
+    CacheBuffer *Lookup(int sector);	// Find "sector" in the hash table
+    CacheBuffer *FindVictim();		// Choose a buffer to replace
+    void Rehash(CacheBuffer *buf, int sector);
+    // Move "buf" to the bucket for "sector"
+    void Unpin(CacheBuffer *buf);	// Stop using "buf"
+    void WriteIfDirty(CacheBuffer **run, int count);
+    // Write back those of a run of
+    // buffers that are dirty
+    int ReadRun(int sector, int numSectors);
+    // Read in uncached sectors from
+    // "sector" on, as one request
+
+    CacheBuffer *buffers;		// the buffers
+    int numBuffers;
+    CacheBuffer **hashTable;		// buffers, by sector % numBuffers
+    int hand;				// clock hand, for FindVictim
+    Lock *lock;				// protects everything but "data"
+    Condition *bufferFree;		// signalled when a buffer's last
+    // user is done with it
+    bool flushScheduled;		// TRUE if a flush interrupt is pending
+    Semaphore *flushRequest;		// for FlushDue to wake up Flusher
+    List *jobs;				// read-ahead and write-behind for
+    // Worker to do
+    Semaphore *jobRequest;		// counts the jobs queued (some may
+    // since have been dropped)
+    bool workerBusy;			// TRUE while Worker is doing a job
+    Condition *workerIdle;		// signalled when it has done one
+};
+
+#endif // BUFCACHE_H
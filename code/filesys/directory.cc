@@ -1,20 +1,22 @@
 // directory.cc
 //	Routines to manage a directory of file names.
 //
-//	The directory is a table of fixed length entries; each
+//	The directory is a hash table of fixed length entries; each
 //	entry represents a single file, and contains the file name,
 //	and the location of the file header on disk.  The fixed size
 //	of each directory entry means that we have the restriction
 //	of a fixed maximum size for file names.
 //
-//	The constructor initializes an empty directory of a certain size;
-//	we use ReadFrom/WriteBack to fetch the contents of the directory
-//	from disk, and to write back any modifications back to disk.
+//	The table is kept in the directory's file, after a small header
+//	giving its size, and is never read into memory as a whole: a
+//	name is looked up by reading the entry its hash says to start at,
+//	and the ones after that (linear probing), until the name or an
+//	entry that has never been used is found.  Changes are written
+//	straight back to the file.
 //
-//	Also, this implementation has the restriction that the size
-//	of the directory cannot expand.  In other words, once all the
-//	entries in the directory are used, no more files can be created.
-//	Fixing this is one of the parts to the assignment.
+//	When three-quarters of the entries have been used, the table is
+//	rebuilt, twice the size if it's at least half full -- the
+//	directory's file grows to make room.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation
@@ -27,56 +29,86 @@
 
 //----------------------------------------------------------------------
 // Directory::Directory
-// 	Initialize a directory; initially, the directory is completely
-//	empty.  If the disk is being formatted, an empty directory
-//	is all we need, but otherwise, we need to call FetchFrom in order
-//	to initialize it from disk.
+// 	Get ready to use the directory kept in "file", by reading the
+//	header at its start.  If the disk is being formatted, or the
+//	directory has just been created, Initialize must be called to
+//	make it an empty directory.
 //
-//	"size" is the number of entries in the directory
+//	"file" -- file containing the directory contents
 //----------------------------------------------------------------------
 
-Directory::Directory(int size)
+Directory::Directory(OpenFile *dirFile)
 {
-    table = new DirectoryEntry[size];
-    tableSize = size;
-    for (int i = 0; i < tableSize; i++)
-        table[i].inUse = FALSE;
+    file = dirFile;
+    header.tableSize = header.numFilled = header.numFiles = 0;
+    (void) file->ReadAt((char *)&header, sizeof(DirectoryHeader), 0);
 }
 
 //----------------------------------------------------------------------
-// Directory::~Directory
-// 	De-allocate directory data structure.
+// Directory::Initialize
+// 	Make the directory empty, with a table of "size" entries.  Return
+//	FALSE, with nothing changed, if there is no room on disk for the
+//	table.
+//
+//	"size" is the number of entries in the table
 //----------------------------------------------------------------------
 
-Directory::~Directory()
+bool
+Directory::Initialize(int size)
 {
+    int numBytes = size * sizeof(DirectoryEntry);
+    char *table = new char[numBytes];
+    bool success;
+
+    bzero(table, numBytes);
+    success = (file->WriteAt(table, numBytes, sizeof(DirectoryHeader))
+               == numBytes);
     delete [] table;
+    if (!success)
+        return FALSE;			// disk full
+    header.tableSize = size;
+    header.numFilled = header.numFiles = 0;
+    (void) file->WriteAt((char *)&header, sizeof(DirectoryHeader), 0);
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
-// Directory::FetchFrom
-// 	Read the contents of the directory from disk.
+// Directory::ReadEntry/WriteEntry
+// 	Read or write entry "i" of the table.  WriteEntry returns FALSE
+//	if the disk is full.
 //
-//	"file" -- file containing the directory contents
+//	"i" -- which entry
+//	"entry" -- where to read it into, or what to write
 //----------------------------------------------------------------------
 
 void
-Directory::FetchFrom(OpenFile *file)
+Directory::ReadEntry(int i, DirectoryEntry *entry)
 {
-    (void) file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    (void) file->ReadAt((char *)entry, sizeof(DirectoryEntry),
+                        sizeof(DirectoryHeader) + i * sizeof(DirectoryEntry));
+}
+
+bool
+Directory::WriteEntry(int i, DirectoryEntry *entry)
+{
+    return file->WriteAt((char *)entry, sizeof(DirectoryEntry),
+                         sizeof(DirectoryHeader) + i * sizeof(DirectoryEntry))
+           == sizeof(DirectoryEntry);
 }
 
 //----------------------------------------------------------------------
-// Directory::WriteBack
-// 	Write any modifications to the directory back to disk
-//
-//	"file" -- file to contain the new directory contents
+// Directory::Hash
+// 	Return the entry of the table to start looking for "name" at.
 //----------------------------------------------------------------------
 
-void
-Directory::WriteBack(OpenFile *file)
+int
+Directory::Hash(char *name)
 {
-    (void) file->WriteAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    unsigned int hash = 0;
+
+    for (int i = 0; i < FileNameMaxLen && name[i] != '\0'; i++)
+        hash = hash * 31 + (unsigned char) name[i];
+    return hash % header.tableSize;
 }
 
 //----------------------------------------------------------------------
@@ -90,9 +122,20 @@ Directory::WriteBack(OpenFile *file)
 int
 Directory::FindIndex(char *name)
 {
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen))
+    DirectoryEntry entry;
+    int i;
+
+    if (header.tableSize == 0)
+        return -1;
+    i = Hash(name);
+    for (int n = 0; n < header.tableSize; n++) {
+        ReadEntry(i, &entry);
+        if (!entry.inUse && !entry.removed)
+            return -1;		// never used, so the name would be here
+        if (entry.inUse && !strncmp(entry.name, name, FileNameMaxLen))
             return i;
+        i = (i + 1) % header.tableSize;
+    }
     return -1;		// name not in directory
 }
 
@@ -103,43 +146,107 @@ Directory::FindIndex(char *name)
 //	in the directory.
 //
 //	"name" -- the file name to look up
+//	"isDirectory" -- if not NULL, where to store whether the file is
+//		a directory
 //----------------------------------------------------------------------
 
 int
-Directory::Find(char *name)
+Directory::Find(char *name, bool *isDirectory)
 {
+    DirectoryEntry entry;
     int i = FindIndex(name);
 
-    if (i != -1)
-        return table[i].sector;
-    return -1;
+    if (i == -1)
+        return -1;
+    ReadEntry(i, &entry);
+    if (isDirectory != NULL)
+        *isDirectory = entry.isDirectory;
+    return entry.sector;
 }
 
 //----------------------------------------------------------------------
 // Directory::Add
 // 	Add a file into the directory.  Return TRUE if successful;
 //	return FALSE if the file name is already in the directory, or if
-//	the directory is completely full, and has no more space for
-//	additional file names.
+//	the table is full and there's no room on disk to make it bigger.
 //
 //	"name" -- the name of the file being added
 //	"newSector" -- the disk sector containing the added file's header
+//	"isDirectory" -- TRUE if the file is a directory
 //----------------------------------------------------------------------
 
 bool
-Directory::Add(char *name, int newSector)
+Directory::Add(char *name, int newSector, bool isDirectory)
 {
     if (FindIndex(name) != -1)
         return FALSE;
+    if (4 * (header.numFilled + 1) > 3 * header.tableSize && !Grow())
+        return FALSE;		// no space
+    return Insert(name, newSector, isDirectory);
+}
+
+//----------------------------------------------------------------------
+// Directory::Insert
+// 	Put a new entry in the first free place its hash leads to, and
+//	update the header.  The caller makes sure there is a free entry.
+//----------------------------------------------------------------------
+
+bool
+Directory::Insert(char *name, int newSector, bool isDirectory)
+{
+    DirectoryEntry entry;
+    bool wasRemoved;
+    int i = Hash(name);
 
-    for (int i = 0; i < tableSize; i++)
-        if (!table[i].inUse) {
-            table[i].inUse = TRUE;
-            strncpy(table[i].name, name, FileNameMaxLen);
-            table[i].sector = newSector;
+    for (int n = 0; n < header.tableSize; n++) {
+        ReadEntry(i, &entry);
+        if (!entry.inUse) {
+            wasRemoved = entry.removed;
+            bzero((char *)&entry, sizeof(DirectoryEntry));
+            entry.inUse = TRUE;
+            entry.isDirectory = isDirectory;
+            strncpy(entry.name, name, FileNameMaxLen);
+            entry.sector = newSector;
+            if (!WriteEntry(i, &entry))
+                return FALSE;
+            if (!wasRemoved)
+                header.numFilled++;
+            header.numFiles++;
+            (void) file->WriteAt((char *)&header, sizeof(DirectoryHeader), 0);
             return TRUE;
         }
-    return FALSE;	// no space.  Fix when we have extensible files.
+        i = (i + 1) % header.tableSize;
+    }
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// Directory::Grow
+// 	Rebuild the table without the removed entries, twice the size if
+//	it is at least half full of files.  Return FALSE, with the table
+//	unchanged, if there's no room on disk.
+//----------------------------------------------------------------------
+
+bool
+Directory::Grow()
+{
+    int oldSize = header.tableSize;
+    DirectoryEntry *old = new DirectoryEntry[oldSize];
+    int newSize = oldSize;
+
+    if (2 * (header.numFiles + 1) > oldSize)
+        newSize = 2 * oldSize;
+    (void) file->ReadAt((char *)old, oldSize * sizeof(DirectoryEntry),
+                        sizeof(DirectoryHeader));
+    if (!Initialize(newSize)) {
+        delete [] old;
+        return FALSE;
+    }
+    for (int i = 0; i < oldSize; i++)
+        if (old[i].inUse)
+            (void) Insert(old[i].name, old[i].sector, old[i].isDirectory);
+    delete [] old;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -153,45 +260,161 @@ Directory::Add(char *name, int newSector)
 bool
 Directory::Remove(char *name)
 {
+    DirectoryEntry entry;
     int i = FindIndex(name);
 
     if (i == -1)
         return FALSE; 		// name not in directory
-    table[i].inUse = FALSE;
+    ReadEntry(i, &entry);
+    entry.inUse = FALSE;
+    entry.removed = TRUE;
+    (void) WriteEntry(i, &entry);
+    header.numFiles--;
+    (void) file->WriteAt((char *)&header, sizeof(DirectoryHeader), 0);
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Directory::IsEmpty
+// 	Return TRUE if there are no files in the directory.
+//----------------------------------------------------------------------
+
+bool
+Directory::IsEmpty()
+{
+    return header.numFiles == 0;
+}
+
+//----------------------------------------------------------------------
+// Directory::Check
+// 	Mark the header and the sectors of every file in the directory,
+//	and in the directories under it, in "used", and check that the
+//	directory's header agrees with its table.  Return FALSE, having
+//	printed what's wrong, if a sector is used twice or the header is
+//	wrong.
+//
+//	"used" -- the bit map of sectors seen so far
+//----------------------------------------------------------------------
+
+bool
+Directory::Check(BitMap *used)
+{
+    FileHeader *hdr = new FileHeader;
+    DirectoryEntry entry;
+    OpenFile *subFile;
+    Directory *sub;
+    int numFiles = 0, numFilled = 0;
+    bool ok = TRUE;
+
+    for (int i = 0; i < header.tableSize; i++) {
+        ReadEntry(i, &entry);
+        if (entry.inUse || entry.removed)
+            numFilled++;
+        if (!entry.inUse)
+            continue;
+        numFiles++;
+        if (entry.sector < 0 || entry.sector >= NumSectors
+                || used->Test(entry.sector)) {
+            printf("Check: %s has a bad header sector %d\n", entry.name,
+                   entry.sector);
+            ok = FALSE;
+            continue;
+        }
+        used->Mark(entry.sector);
+        hdr->FetchFrom(entry.sector);
+        if (!hdr->MarkSectors(used)) {
+            printf("Check: %s uses a sector twice, or a bad one\n",
+                   entry.name);
+            ok = FALSE;
+        } else if (entry.isDirectory) {
+            subFile = new OpenFile(entry.sector, TRUE);
+            sub = new Directory(subFile);
+            if (!sub->Check(used))
+                ok = FALSE;
+            delete sub;
+            delete subFile;
+        }
+    }
+    if (numFiles != header.numFiles || numFilled != header.numFilled) {
+        printf("Check: directory has %d files in %d entries, not %d in %d\n",
+               numFiles, numFilled, header.numFiles, header.numFilled);
+        ok = FALSE;
+    }
+    delete hdr;
+    return ok;
+}
+
 //----------------------------------------------------------------------
 // Directory::List
-// 	List all the file names in the directory.
+// 	List all the file names in the directory, and in the directories
+//	under it, with "path" in front of each.  Directories have a "/"
+//	after their names.
+//
+//	"path" -- the path to this directory ("" at the root)
 //----------------------------------------------------------------------
 
 void
-Directory::List()
+Directory::List(char *path)
 {
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse)
-            printf("%s\n", table[i].name);
+    DirectoryEntry entry;
+    OpenFile *subFile;
+    Directory *sub;
+    char *subPath;
+
+    for (int i = 0; i < header.tableSize; i++) {
+        ReadEntry(i, &entry);
+        if (!entry.inUse)
+            continue;
+        printf("%s%s%s\n", path, entry.name, entry.isDirectory ? "/" : "");
+        if (entry.isDirectory) {
+            subPath = new char[strlen(path) + FileNameMaxLen + 2];
+            sprintf(subPath, "%s%s/", path, entry.name);
+            subFile = new OpenFile(entry.sector, TRUE);
+            sub = new Directory(subFile);
+            sub->List(subPath);
+            delete sub;
+            delete subFile;
+            delete [] subPath;
+        }
+    }
 }
 
 //----------------------------------------------------------------------
 // Directory::Print
 // 	List all the file names in the directory, their FileHeader locations,
-//	and the contents of each file.  For debugging.
+//	and the contents of each file, and then do the same for each
+//	directory under it.  For debugging.
 //----------------------------------------------------------------------
 
 void
 Directory::Print()
 {
     FileHeader *hdr = new FileHeader;
+    DirectoryEntry entry;
+    OpenFile *subFile;
+    Directory *sub;
 
     printf("Directory contents:\n");
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse) {
-            printf("Name: %s, Sector: %d\n", table[i].name, table[i].sector);
-            hdr->FetchFrom(table[i].sector);
+    for (int i = 0; i < header.tableSize; i++) {
+        ReadEntry(i, &entry);
+        if (entry.inUse) {
+            printf("Name: %s, Sector: %d%s\n", entry.name, entry.sector,
+                   entry.isDirectory ? ", Directory" : "");
+            hdr->FetchFrom(entry.sector);
             hdr->Print();
         }
+    }
     printf("\n");
+    for (int i = 0; i < header.tableSize; i++) {
+        ReadEntry(i, &entry);
+        if (entry.inUse && entry.isDirectory) {
+            printf("Directory %s:\n", entry.name);
+            subFile = new OpenFile(entry.sector, TRUE);
+            sub = new Directory(subFile);
+            sub->Print();
+            delete sub;
+            delete subFile;
+        }
+    }
     delete hdr;
 }
@@ -4,7 +4,14 @@
 //      A directory is a table of pairs: <file name, sector #>,
 //	giving the name of each file in the directory, and
 //	where to find its file header (the data structure describing
-//	where to find the file's data blocks) on disk.
+//	where to find the file's data blocks) on disk.  A file named in
+//	a directory may itself be a directory, so directories form a
+//	tree, whose root has its file header in a well-known sector.
+//
+//	The table is a hash table, kept in the directory's file, and read
+//	and written an entry at a time, so finding a name only reads the
+//	entries its hash leads to, however big the directory is.  When
+//	the table is three-quarters full, it is doubled in size.
 //
 //      We assume mutual exclusion is provided by the caller.
 //
@@ -18,13 +25,16 @@
 #define DIRECTORY_H
 
 #include "openfile.h"
+#include "bitmap.h"
 
-#define FileNameMaxLen 		9	// for simplicity, we assume 
+#define FileNameMaxLen 		9	// for simplicity, we assume
 // file names are <= 9 characters long
 
 // The following class defines a "directory entry", representing a file
 // in the directory.  Each entry gives the name of the file, and where
-// the file's header is to be found on disk.
+// the file's header is to be found on disk.  An entry whose file has
+// been removed is marked "removed" rather than cleared, so that a
+// search for a name that hashed to the same place goes on past it.
 //
 // Internal data structures kept public so that Directory operations can
 // access them directly.
@@ -32,52 +42,72 @@
 class DirectoryEntry {
 public:
     bool inUse;				// Is this directory entry in use?
+    bool removed;			// Was it in use, until a Remove?
+    bool isDirectory;			// Is the file a directory?
     int sector;				// Location on disk to find the
     //   FileHeader for this file
     char name[FileNameMaxLen + 1];	// Text name for file, with +1 for
     // the trailing '\0'
 };
 
+// The start of a directory's file, ahead of the table of entries.
+class DirectoryHeader {
+public:
+    int tableSize;			// Number of directory entries
+    int numFilled;			// Entries in use, or removed
+    int numFiles;			// Entries in use
+};
+
 // The following class defines a UNIX-like "directory".  Each entry in
 // the directory describes a file, and where to find it on disk.
 //
-// The directory data structure can be stored in memory, or on disk.
-// When it is on disk, it is stored as a regular Nachos file.
-//
-// The constructor initializes a directory structure in memory; the
-// FetchFrom/WriteBack operations shuffle the directory information
-// from/to disk.
+// The directory data structure is stored on disk, as a regular Nachos
+// file; a Directory object is only a handle for reading and changing
+// that file, with a copy of its header.
 
 class Directory {
 public:
-    Directory(int size); 		// Initialize an empty directory
-    // with space for "size" files
-    ~Directory();			// De-allocate the directory
+    Directory(OpenFile *file); 		// Use the directory stored in "file"
 
-    void FetchFrom(OpenFile *file);  	// Init directory contents from disk
-    void WriteBack(OpenFile *file);	// Write modifications to
-    // directory contents back to disk
+    bool Initialize(int size);		// Make the directory empty, with
+    // space for "size" files to start
+    // with; FALSE if the disk is full
 
-    int Find(char *name);		// Find the sector number of the
+    int Find(char *name, bool *isDirectory = NULL);
+    // Find the sector number of the
     // FileHeader for file: "name"
 
-    bool Add(char *name, int newSector);  // Add a file name into the directory
+    bool Add(char *name, int newSector, bool isDirectory);
+    // Add a file name into the directory
 
     bool Remove(char *name);		// Remove a file from the directory
 
-    void List();			// Print the names of all the files
-    //  in the directory
+    bool IsEmpty();			// Are there no files in it?
+
+    bool Check(BitMap *used);		// Mark the sectors of the files in
+    //  the directory, and in the ones
+    //  under it; FALSE if any is wrong
+
+    void List(char *path);		// Print the names of all the files
+    //  in the directory, and in the
+    //  directories under it
     void Print();			// Verbose print of the contents
     //  of the directory -- all the file
     //  names and their contents.
 
 private:
-    int tableSize;			// Number of directory entries
-    DirectoryEntry *table;		// Table of pairs:
-    // <file name, file header location>
+    OpenFile *file;			// Where the directory is kept
+    DirectoryHeader header;		// Copy of the start of "file"
 
     int FindIndex(char *name);		// Find the index into the directory
     //  table corresponding to "name"
+    int Hash(char *name);		// Where to start looking for "name"
+    void ReadEntry(int i, DirectoryEntry *entry);
+    bool WriteEntry(int i, DirectoryEntry *entry);
+    // Read or write entry "i" of the table
+    bool Insert(char *name, int newSector, bool isDirectory);
+    // Add an entry, without growing
+    bool Grow();			// Double the size of the table
 };
 
 #endif // DIRECTORY_H
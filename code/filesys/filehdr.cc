@@ -5,10 +5,15 @@
 //	The file header is used to locate where on disk the
 //	file's data is stored.  We implement this as a fixed size
 //	table of pointers -- each entry in the table points to the
-//	disk sector containing that portion of the file data
-//	(in other words, there are no indirect or doubly indirect
-//	blocks). The table size is chosen so that the file header
-//	will be just big enough to fit in one disk sector,
+//	disk sector containing that portion of the file data -- followed
+//	by a single indirect and a double indirect block for the rest.
+//	The table size is chosen so that the file header will be just big
+//	enough to fit in one disk sector.
+//
+//	A new file's sectors are taken from runs of free sectors, as long
+//	as can be found, in the order they will be read: each indirect
+//	block just before the data it points to.  So on an empty disk, a
+//	file is laid out in one piece, and can be read a track at a time.
 //
 //      Unlike in a real system, we do not keep track of file permissions,
 //	ownership, last modification date, etc., in the file header.
@@ -27,33 +32,268 @@
 #include "system.h"
 #include "filehdr.h"
 
+// Hands out the sectors a file is to be given, in runs of free sectors.
+class SectorRun {
+public:
+    SectorRun(BitMap *map, int count, int goal) {
+        freeMap = map;
+        wanted = count;
+        next = goal;
+        left = 0;
+    }
+    int Next() {			// return the next sector to use
+        if (left == 0) {
+            next = freeMap->FindRun(wanted, &left, next);
+            ASSERT(next >= 0);
+        }
+        left--;
+        wanted--;
+        return next++;
+    }
+
+private:
+    BitMap *freeMap;
+    int wanted;				// sectors still to hand out
+    int next;				// next sector of the current run
+    int left;				// sectors left in the current run
+};
+
+//----------------------------------------------------------------------
+// ClearTable
+// 	Set every pointer in a table of sector numbers (a file header or
+//	an indirect block) to -1, meaning "none".
+//----------------------------------------------------------------------
+
+static void
+ClearTable(int *table, int size)
+{
+    for (int i = 0; i < size; i++)
+        table[i] = -1;
+}
+
+//----------------------------------------------------------------------
+// ReadPointer, WritePointer, NewTable
+// 	Read or write the "i"th pointer in the indirect block at sector
+//	"table", through the buffer cache, or make a new indirect block
+//	with every pointer -1.
+//----------------------------------------------------------------------
+
+static int
+ReadPointer(int table, int i)
+{
+    int sector;
+
+    bufferCache->ReadBytes(table, (char *) &sector, i * sizeof(int),
+                           sizeof(int));
+    return sector;
+}
+
+static void
+WritePointer(int table, int i, int sector)
+{
+    bufferCache->WriteBytes(table, (char *) &sector, i * sizeof(int),
+                            sizeof(int));
+}
+
+static int
+NewTable(SectorRun *run)
+{
+    int table[NumIndirect];
+    int sector = run->Next();
+
+    ClearTable(table, NumIndirect);
+    bufferCache->WriteSector(sector, (char *) table);
+    return sector;
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Allocate
 // 	Initialize a fresh file header for a newly created file.
-//	Allocate data blocks for the file out of the map of free disk blocks.
+//	Allocate data blocks for the file out of the map of free disk
+//	blocks, along with the indirect blocks needed to find them.
 //	Return FALSE if there are not enough free blocks to accomodate
 //	the new file.
 //
+//	A file created with no data can be given sectors later, as it is
+//	written, with AllocateSectors.
+//
 //	"freeMap" is the bit map of free disk sectors
-//	"fileSize" is the bit map of free disk sectors
+//	"fileSize" is the number of bytes in the file
+//	"near" is where on disk to look for free blocks first
 //----------------------------------------------------------------------
 
 bool
-FileHeader::Allocate(BitMap *freeMap, int fileSize)
+FileHeader::Allocate(BitMap *freeMap, int fileSize, int near)
 {
     numBytes = fileSize;
     numSectors  = divRoundUp(fileSize, SectorSize);
-    if (freeMap->NumClear() < numSectors)
-        return FALSE;		// not enough space
+    ClearTable(dataSectors, NumDirect);
+    indirect = doubleIndirect = -1;
+    if (numSectors == 0)
+        return TRUE;
+    return AllocateSectors(freeMap, 0, numSectors - 1, near);
+}
 
-    for (int i = 0; i < numSectors; i++)
-        dataSectors[i] = freeMap->Find();
+//----------------------------------------------------------------------
+// FileHeader::AllocateSectors
+// 	Give a disk sector to every sector of the file from "firstSector"
+//	to "lastSector" that doesn't have one, making the indirect blocks
+//	needed to find them.  All of them are taken at once, as a run of
+//	free sectors if possible, starting just after the file sector
+//	before "firstSector", so a file written in order is laid out in
+//	order (or at "near", if that sector is a hole -- usually just
+//	after the file's header).  Return FALSE, with nothing allocated,
+//	if there are not enough free blocks or the file would be too big.
+//
+//	The caller must write the header back, and the free map; the
+//	indirect blocks are written through the buffer cache.  The length
+//	of the file isn't changed.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"firstSector", "lastSector" -- the sectors of the file to allocate
+//	"near" is where on disk to look for free blocks, if not after the
+//		sector before "firstSector"
+//----------------------------------------------------------------------
+
+bool
+FileHeader::AllocateSectors(BitMap *freeMap, int firstSector, int lastSector,
+                            int near)
+{
+    int i, count, goal;
+    int firstTable, lastTable;
+
+    if (lastSector >= MaxFileSectors)
+        return FALSE;			// too big
+
+    // count the sectors needed; any missing indirect block in the range
+    // will be needed, since every pointer in it is to a hole
+    count = 0;
+    for (i = firstSector; i <= lastSector; i++)
+        if (SectorOf(i) < 0)
+            count++;
+    if (count == 0)
+        return TRUE;
+    if (lastSector >= NumDirect && firstSector < NumDirect + NumIndirect
+            && indirect < 0)
+        count++;
+    if (lastSector >= NumDirect + NumIndirect) {
+        if (doubleIndirect < 0)
+            count++;
+        firstTable = max(firstSector - NumDirect - NumIndirect, 0) / NumIndirect;
+        lastTable = (lastSector - NumDirect - NumIndirect) / NumIndirect;
+        for (i = firstTable; i <= lastTable; i++)
+            if (doubleIndirect < 0 || ReadPointer(doubleIndirect, i) < 0)
+                count++;
+    }
+    if (freeMap->NumClear() < count)
+        return FALSE;			// not enough space
+
+    goal = near;
+    if (firstSector > 0 && SectorOf(firstSector - 1) >= 0)
+        goal = SectorOf(firstSector - 1) + 1;
+
+    SectorRun run(freeMap, count, goal);
+
+    for (i = firstSector; i <= lastSector; i++)
+        if (SectorOf(i) < 0)
+            SetSectorOf(i, &run);
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// FileHeader::SetLength
+// 	Change the length of the file.  Sectors past the end are not
+//	freed, and sectors up to the end are not allocated: reading a
+//	sector that has none gives zeroes.
+//
+//	"length" is the new number of bytes in the file
+//----------------------------------------------------------------------
+
+void
+FileHeader::SetLength(int length)
+{
+    numBytes = length;
+    numSectors = divRoundUp(length, SectorSize);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::SectorOf
+// 	Return the disk sector holding sector "i" of the file, or -1 if
+//	it has none.
+//----------------------------------------------------------------------
+
+int
+FileHeader::SectorOf(int i)
+{
+    int table;
+
+    if (i < NumDirect)
+        return dataSectors[i];
+    i -= NumDirect;
+    if (i < NumIndirect)
+        return (indirect < 0) ? -1 : ReadPointer(indirect, i);
+    i -= NumIndirect;
+    if (doubleIndirect < 0)
+        return -1;
+    table = ReadPointer(doubleIndirect, i / NumIndirect);
+    return (table < 0) ? -1 : ReadPointer(table, i % NumIndirect);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::SetSectorOf
+// 	Give sector "i" of the file the next sector from "run", first
+//	taking from it any indirect block that's needed to point to it.
+//----------------------------------------------------------------------
+
+void
+FileHeader::SetSectorOf(int i, SectorRun *run)
+{
+    int table;
+
+    if (i < NumDirect) {
+        dataSectors[i] = run->Next();
+        return;
+    }
+    i -= NumDirect;
+    if (i < NumIndirect) {
+        if (indirect < 0)
+            indirect = NewTable(run);
+        WritePointer(indirect, i, run->Next());
+        return;
+    }
+    i -= NumIndirect;
+    if (doubleIndirect < 0)
+        doubleIndirect = NewTable(run);
+    table = ReadPointer(doubleIndirect, i / NumIndirect);
+    if (table < 0) {
+        table = NewTable(run);
+        WritePointer(doubleIndirect, i / NumIndirect, table);
+    }
+    WritePointer(table, i % NumIndirect, run->Next());
+}
+
+//----------------------------------------------------------------------
+// FreeTable
+// 	Return the sectors in a table of sector numbers to the free map.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"table", "size" -- the table, and the number of pointers in it
+//----------------------------------------------------------------------
+
+static void
+FreeTable(BitMap *freeMap, int *table, int size)
+{
+    for (int i = 0; i < size; i++)
+        if (table[i] >= 0) {
+            ASSERT(freeMap->Test(table[i]));  // ought to be marked!
+            freeMap->Clear(table[i]);
+        }
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Deallocate
-// 	De-allocate all the space allocated for data blocks for this file.
+// 	De-allocate all the space allocated for data blocks for this file,
+//	and for the indirect blocks.
 //
 //	"freeMap" is the bit map of free disk sectors
 //----------------------------------------------------------------------
@@ -61,12 +301,87 @@ FileHeader::Allocate(BitMap *freeMap, int fileSize)
 void
 FileHeader::Deallocate(BitMap *freeMap)
 {
-    for (int i = 0; i < numSectors; i++) {
-        ASSERT(freeMap->Test((int) dataSectors[i]));  // ought to be marked!
-        freeMap->Clear((int) dataSectors[i]);
+    int table[NumIndirect], outer[NumIndirect];
+
+    FreeTable(freeMap, dataSectors, NumDirect);
+    if (indirect >= 0) {
+        bufferCache->ReadSector(indirect, (char *) table);
+        FreeTable(freeMap, table, NumIndirect);
+        FreeTable(freeMap, &indirect, 1);
+    }
+    if (doubleIndirect >= 0) {
+        bufferCache->ReadSector(doubleIndirect, (char *) outer);
+        for (int i = 0; i < NumIndirect; i++)
+            if (outer[i] >= 0) {
+                bufferCache->ReadSector(outer[i], (char *) table);
+                FreeTable(freeMap, table, NumIndirect);
+            }
+        FreeTable(freeMap, outer, NumIndirect);
+        FreeTable(freeMap, &doubleIndirect, 1);
     }
 }
 
+//----------------------------------------------------------------------
+// MarkTable
+// 	Mark the sectors in a table of sector numbers in "used".  Return
+//	FALSE if one isn't on the disk, or is marked already.
+//
+//	"used" is the bit map of sectors seen so far
+//	"table", "size" -- the table, and the number of pointers in it
+//----------------------------------------------------------------------
+
+static bool
+MarkTable(BitMap *used, int *table, int size)
+{
+    for (int i = 0; i < size; i++)
+        if (table[i] >= 0) {
+            if (table[i] >= NumSectors || used->Test(table[i]))
+                return FALSE;
+            used->Mark(table[i]);
+        }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::MarkSectors
+// 	Mark every sector this file uses, for data and for indirect
+//	blocks, in "used".  Return FALSE if any of them is marked already
+//	(used by another file, or twice by this one), or isn't on the
+//	disk.  For checking the file system.
+//
+//	"used" is the bit map of sectors seen so far
+//----------------------------------------------------------------------
+
+bool
+FileHeader::MarkSectors(BitMap *used)
+{
+    int table[NumIndirect], outer[NumIndirect];
+
+    if (!MarkTable(used, dataSectors, NumDirect))
+        return FALSE;
+    if (indirect >= 0) {
+        if (!MarkTable(used, &indirect, 1))
+            return FALSE;
+        bufferCache->ReadSector(indirect, (char *) table);
+        if (!MarkTable(used, table, NumIndirect))
+            return FALSE;
+    }
+    if (doubleIndirect >= 0) {
+        if (!MarkTable(used, &doubleIndirect, 1))
+            return FALSE;
+        bufferCache->ReadSector(doubleIndirect, (char *) outer);
+        if (!MarkTable(used, outer, NumIndirect))
+            return FALSE;
+        for (int i = 0; i < NumIndirect; i++)
+            if (outer[i] >= 0) {
+                bufferCache->ReadSector(outer[i], (char *) table);
+                if (!MarkTable(used, table, NumIndirect))
+                    return FALSE;
+            }
+    }
+    return TRUE;
+}
+
 //----------------------------------------------------------------------
 // FileHeader::FetchFrom
 // 	Fetch contents of file header from disk.
@@ -77,7 +392,7 @@ FileHeader::Deallocate(BitMap *freeMap)
 void
 FileHeader::FetchFrom(int sector)
 {
-    synchDisk->ReadSector(sector, (char *)this);
+    bufferCache->ReadSector(sector, (char *)this);
 }
 
 //----------------------------------------------------------------------
@@ -90,7 +405,7 @@ FileHeader::FetchFrom(int sector)
 void
 FileHeader::WriteBack(int sector)
 {
-    synchDisk->WriteSector(sector, (char *)this);
+    bufferCache->WriteSector(sector, (char *)this);
 }
 
 //----------------------------------------------------------------------
@@ -98,7 +413,9 @@ FileHeader::WriteBack(int sector)
 // 	Return which disk sector is storing a particular byte within the file.
 //      This is essentially a translation from a virtual address (the
 //	offset in the file) to a physical address (the sector where the
-//	data at the offset is stored).
+//	data at the offset is stored).  Past the direct pointers, this
+//	means looking in the indirect blocks, through the buffer cache.
+//	Returns -1 if the byte is in a hole -- a sector never written.
 //
 //	"offset" is the location within the file of the byte in question
 //----------------------------------------------------------------------
@@ -106,7 +423,7 @@ FileHeader::WriteBack(int sector)
 int
 FileHeader::ByteToSector(int offset)
 {
-    return(dataSectors[offset / SectorSize]);
+    return SectorOf(offset / SectorSize);
 }
 
 //----------------------------------------------------------------------
@@ -134,10 +451,13 @@ FileHeader::Print()
 
     printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
     for (i = 0; i < numSectors; i++)
-        printf("%d ", dataSectors[i]);
+        printf("%d ", ByteToSector(i * SectorSize));
     printf("\nFile contents:\n");
     for (i = k = 0; i < numSectors; i++) {
-        synchDisk->ReadSector(dataSectors[i], data);
+        if (ByteToSector(i * SectorSize) < 0)
+            bzero(data, SectorSize);		// a hole
+        else
+            bufferCache->ReadSector(ByteToSector(i * SectorSize), data);
         for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
             if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
                 printf("%c", data[j]);
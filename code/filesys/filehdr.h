@@ -17,19 +17,27 @@
 #include "disk.h"
 #include "bitmap.h"
 
-#define NumDirect 	((SectorSize - 2 * sizeof(int)) / sizeof(int))
-#define MaxFileSize 	(NumDirect * SectorSize)
+class SectorRun;
+
+#define NumDirect 	(int) ((SectorSize - 4 * sizeof(int)) / sizeof(int))
+#define NumIndirect	(int) (SectorSize / sizeof(int))
+#define MaxFileSectors	(NumDirect + NumIndirect + NumIndirect * NumIndirect)
+#define MaxFileSize 	(MaxFileSectors * SectorSize)
 
 // The following class defines the Nachos "file header" (in UNIX terms,
 // the "i-node"), describing where on disk to find all of the data in the file.
-// The file header is organized as a simple table of pointers to
-// data blocks.
+// The file header is organized as a table of pointers to the first
+// NumDirect data blocks, followed by the sector of a single indirect
+// block -- a table of pointers to the next NumIndirect data blocks --
+// and the sector of a double indirect block, a table of pointers to
+// more single indirect blocks.  Unused pointers are -1: a sector of
+// the file with no disk sector is a hole, and reads as zeroes.
 //
 // The file header data structure can be stored in memory or on disk.
 // When it is on disk, it is stored in a single sector -- this means
 // that we assume the size of this data structure to be the same
-// as one disk sector.  Without indirect addressing, this
-// limits the maximum file length to just under 4K bytes.
+// as one disk sector.  With the indirect blocks, a file can be bigger
+// than the whole disk.
 //
 // There is no constructor; rather the file header can be initialized
 // by allocating blocks for the file (if it is a new file), or by
@@ -37,11 +45,19 @@
 
 class FileHeader {
 public:
-    bool Allocate(BitMap *bitMap, int fileSize);// Initialize a file header,
+    bool Allocate(BitMap *bitMap, int fileSize, int near = 0);
+    // Initialize a file header,
     //  including allocating space
-    //  on disk for the file data
+    //  on disk for the file data,
+    //  from sector "near" on
+    bool AllocateSectors(BitMap *bitMap, int firstSector, int lastSector,
+                         int near = 0);
+    // Fill in the holes in part of the
+    // file, with new data blocks
     void Deallocate(BitMap *bitMap);  		// De-allocate this file's
     //  data blocks
+    bool MarkSectors(BitMap *used);	// Mark the sectors the file uses;
+    // FALSE if any already were
 
     void FetchFrom(int sectorNumber); 	// Initialize file header from disk
     void WriteBack(int sectorNumber); 	// Write modifications to file header
@@ -53,14 +69,21 @@ public:
 
     int FileLength();			// Return the length of the file
     // in bytes
+    void SetLength(int length);		// Make the file longer or shorter
 
     void Print();			// Print the contents of the file.
 
 private:
+    int SectorOf(int i);		// Disk sector of file sector "i"
+    void SetSectorOf(int i, SectorRun *run);
+    // Give file sector "i" a disk sector
+
     int numBytes;			// Number of bytes in the file
     int numSectors;			// Number of data sectors in the file
     int dataSectors[NumDirect];		// Disk sector numbers for each data
     // block in the file
+    int indirect;			// Single indirect block, or -1
+    int doubleIndirect;			// Double indirect block, or -1
 };
 
 #endif // FILEHDR_H
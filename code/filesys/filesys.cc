@@ -7,37 +7,49 @@
 //		(the size of the file header data structure is arranged
 //		to be precisely the size of 1 disk sector)
 //	   A number of data blocks
-//	   An entry in the file system directory
+//	   An entry in a directory
 //
 // 	The file system consists of several data structures:
 //	   A bitmap of free disk sectors (cf. bitmap.h)
-//	   A directory of file names and file headers
+//	   A tree of directories of file names and file headers
+//	   A journal of changes to them (cf. journal.h)
 //
-//      Both the bitmap and the directory are represented as normal
-//	files.  Their file headers are located in specific sectors
-//	(sector 0 and sector 1), so that the file system can find them
-//	on bootup.
+//      The bitmap, the directories and the journal's log are represented
+//	as normal files.  The file headers of the bitmap, the root
+//	directory and the log are located in specific sectors (sectors 0,
+//	1 and 2), so that the file system can find them on bootup.
 //
-//	The file system assumes that the bitmap and directory files are
-//	kept "open" continuously while Nachos is running.
+//	The file system assumes that the bitmap and root directory files
+//	are kept "open" continuously while Nachos is running; the other
+//	directories on the path to a file are opened as they're needed.
+//	The sectors of recently looked up names are kept in a NameCache,
+//	so finding them again doesn't read the directories at all.
+//
+//	The bitmap is also kept in memory, so allocating a sector doesn't
+//	read it.  It keeps count of the free sectors on each track, so a
+//	new file's header can be put on a track with room for its data,
+//	as near as possible to its directory, and its data just after it.
 //
 //	For those operations (such as Create, Remove) that modify the
 //	directory and/or bitmap, if the operation succeeds, the changes
-//	are written immediately back to disk (the two files are kept
-//	open during all this time).  If the operation fails, and we have
-//	modified part of the directory and/or bitmap, we simply discard
-//	the changed version, without writing it back to disk.
+//	are written immediately back to the buffer cache (the two files
+//	are kept open during all this time); only the words of the bitmap
+//	that changed are written.  If the operation fails, and we have
+//	modified part of the bitmap, we undo the change.  A directory is
+//	changed on disk as it's changed, so it is changed last.
+//
+//	Each operation is one journal operation, so if Nachos exits in
+//	the middle of it, it is either done or not done when the file
+//	system is next mounted.  Only metadata is journaled: headers,
+//	indirect blocks, and the bitmap and directory files, which are
+//	opened as metadata.  File data never is, whatever other threads
+//	are doing.
 //
 // 	Our implementation at this point has the following restrictions:
 //
 //	   there is no synchronization for concurrent accesses
-//	   files have a fixed size, set when the file is created
-//	   files cannot be bigger than about 3KB in size
-//	   there is no hierarchical directory structure, and only a limited
-//	     number of files can be added to the system
-//	   there is no attempt to make the system robust to failures
-//	    (if Nachos exits in the middle of an operation that modifies
-//	    the file system, it may corrupt the disk)
+//	   a file removed while it's open has its sectors freed when it
+//	    is closed; if Nachos exits in between, they stay in use
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation
@@ -50,19 +62,22 @@
 #include "directory.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "journal.h"
+#include "system.h"
 
 // Sectors containing the file headers for the bitmap of free sectors,
 // and the directory of files.  These file headers are placed in well-known
 // sectors, so that they can be located on boot-up.
 #define FreeMapSector 		0
 #define DirectorySector 	1
+#define JournalSector 		2
 
-// Initial file sizes for the bitmap and directory; until the file system
-// supports extensible files, the directory size sets the maximum number
-// of files that can be loaded onto the disk.
+// Initial file sizes for the bitmap and root directory; a directory
+// grows as files are added to it.
 #define FreeMapFileSize 	(NumSectors / BitsInByte)
 #define NumDirEntries 		10
-#define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
+#define DirectoryFileSize 	(sizeof(DirectoryHeader) \
+				 + sizeof(DirectoryEntry) * NumDirEntries)
 
 //----------------------------------------------------------------------
 // FileSystem::FileSystem
@@ -71,8 +86,8 @@
 //	an empty directory, and a bitmap of free sectors (with almost but
 //	not all of the sectors marked as free).
 //
-//	If format = FALSE, we just have to open the files
-//	representing the bitmap and the directory.
+//	If format = FALSE, we just have to recover from the journal, and
+//	open the files representing the bitmap and the directory.
 //
 //	"format" -- should we initialize the disk?
 //----------------------------------------------------------------------
@@ -80,24 +95,28 @@
 FileSystem::FileSystem(bool format)
 {
     DEBUG('f', "Initializing the file system.\n");
+    names = new NameCache(NumNameCacheSlots);
+    freeMap = new BitMap(NumSectors, SectorsPerTrack);
     if (format) {
-        BitMap *freeMap = new BitMap(NumSectors);
-        Directory *directory = new Directory(NumDirEntries);
+        Directory *directory;
         FileHeader *mapHdr = new FileHeader;
         FileHeader *dirHdr = new FileHeader;
+        FileHeader *logHdr = new FileHeader;
 
         DEBUG('f', "Formatting the file system.\n");
 
-        // First, allocate space for FileHeaders for the directory and bitmap
-        // (make sure no one else grabs these!)
+        // First, allocate space for FileHeaders for the directory, bitmap
+        // and log (make sure no one else grabs these!)
         freeMap->Mark(FreeMapSector);
         freeMap->Mark(DirectorySector);
+        freeMap->Mark(JournalSector);
 
         // Second, allocate space for the data blocks containing the contents
         // of the directory and bitmap files.  There better be enough space!
 
         ASSERT(mapHdr->Allocate(freeMap, FreeMapFileSize));
         ASSERT(dirHdr->Allocate(freeMap, DirectoryFileSize));
+        ASSERT(logHdr->Allocate(freeMap, JournalSectors * SectorSize));
 
         // Flush the bitmap and directory FileHeaders back to disk
         // We need to do this before we can "Open" the file, since open
@@ -107,13 +126,14 @@ FileSystem::FileSystem(bool format)
         DEBUG('f', "Writing headers back to disk.\n");
         mapHdr->WriteBack(FreeMapSector);
         dirHdr->WriteBack(DirectorySector);
+        logHdr->WriteBack(JournalSector);
 
         // OK to open the bitmap and directory files now
         // The file system operations assume these two files are left open
         // while Nachos is running.
 
-        freeMapFile = new OpenFile(FreeMapSector);
-        directoryFile = new OpenFile(DirectorySector);
+        freeMapFile = new OpenFile(FreeMapSector, TRUE);
+        directoryFile = new OpenFile(DirectorySector, TRUE);
 
         // Once we have the files "open", we can write the initial version
         // of each file back to disk.  The directory at this point is completely
@@ -122,95 +142,247 @@ FileSystem::FileSystem(bool format)
         // to hold the file data for the directory and bitmap.
 
         DEBUG('f', "Writing bitmap and directory back to disk.\n");
+        journal = new Journal(JournalSector, TRUE);	// empty the log
         freeMap->WriteBack(freeMapFile);	 // flush changes to disk
-        directory->WriteBack(directoryFile);
+        directory = new Directory(directoryFile);
+        ASSERT(directory->Initialize(NumDirEntries));
 
         if (DebugIsEnabled('f')) {
             freeMap->Print();
             directory->Print();
 
-            delete freeMap;
             delete directory;
             delete mapHdr;
             delete dirHdr;
+            delete logHdr;
         }
     } else {
-        // if we are not formatting the disk, just open the files representing
-        // the bitmap and directory; these are left open while Nachos is running
-        freeMapFile = new OpenFile(FreeMapSector);
-        directoryFile = new OpenFile(DirectorySector);
+        // if we are not formatting the disk, finish what was committed to
+        // the journal, and open the files representing the bitmap and
+        // directory; these are left open while Nachos is running
+        journal = new Journal(JournalSector, FALSE);
+        freeMapFile = new OpenFile(FreeMapSector, TRUE);
+        directoryFile = new OpenFile(DirectorySector, TRUE);
+        freeMap->FetchFrom(freeMapFile);
+    }
+}
+
+//----------------------------------------------------------------------
+// FileSystem::~FileSystem
+// 	De-allocate the file system's data structures, and the journal.
+//	Nothing is written back; the buffer cache must be flushed first to
+//	keep what isn't committed.
+//----------------------------------------------------------------------
+
+FileSystem::~FileSystem()
+{
+    delete freeMapFile;
+    delete directoryFile;
+    delete freeMap;
+    delete names;
+    delete journal;
+    journal = NULL;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FindParent
+// 	Find the directory that the file named by "path" is in, and
+//	return the sector of its header.  Return -1 if some directory along
+//	the path doesn't exist.  The last part of the path, the file's name
+//	in the directory, is copied into "name" (cut to FileNameMaxLen
+//	characters).
+//
+//	"path" -- the path name of a file, such as "usr/bin/sort"
+//	"name" -- where to put the name in the directory, such as "sort"
+//----------------------------------------------------------------------
+
+int
+FileSystem::FindParent(char *path, char *name)
+{
+    int dirSector = DirectorySector;
+    char *end;
+    int length;
+    bool isDirectory;
+
+    for (;;) {
+        while (*path == '/')
+            path++;
+        end = strchr(path, '/');
+        length = (end == NULL) ? strlen(path) : end - path;
+        length = min(length, FileNameMaxLen);
+        strncpy(name, path, length);
+        name[length] = '\0';
+        if (end == NULL)
+            break;			// the last part
+
+        dirSector = Lookup(dirSector, name, &isDirectory);
+        if (dirSector == -1 || !isDirectory)
+            return -1;			// no such directory
+        path = end;
     }
+    if (*name == '\0')			// path ended in "/"
+        return -1;
+    return dirSector;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Lookup
+// 	Return the sector of the header of the file "name", in the
+//	directory whose header is at "dirSector", or -1 if there's no such
+//	file.  Recent lookups are remembered, so they don't need to read
+//	the directory.
+//
+//	"dirSector" -- the directory to look in
+//	"name" -- the name of the file in the directory
+//	"isDirectory" -- where to store whether the file is a directory
+//----------------------------------------------------------------------
+
+int
+FileSystem::Lookup(int dirSector, char *name, bool *isDirectory)
+{
+    OpenFile *dirFile;
+    Directory *directory;
+    int sector;
+
+    sector = names->Lookup(dirSector, name, isDirectory);
+    if (sector != -1)
+        return sector;
+    dirFile = new OpenFile(dirSector, TRUE);
+    directory = new Directory(dirFile);
+    sector = directory->Find(name, isDirectory);
+    delete directory;
+    delete dirFile;
+    if (sector != -1)
+        names->Enter(dirSector, name, sector, *isDirectory);
+    return sector;
 }
 
 //----------------------------------------------------------------------
 // FileSystem::Create
 // 	Create a file in the Nachos file system (similar to UNIX create).
-//	Since we can't increase the size of files dynamically, we have
-//	to give Create the initial size of the file.
+//	We give Create the initial size of the file; it can grow later,
+//	as it is written.
+//
+//	"name" -- path name of file to be created
+//	"initialSize" -- size of file to be created
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Create(char *name, int initialSize)
+{
+    return MakeFile(name, initialSize, FALSE);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CreateDirectory
+// 	Create an empty directory in the Nachos file system (similar to
+//	UNIX mkdir).
+//
+//	"name" -- path name of directory to be created
+//----------------------------------------------------------------------
+
+bool
+FileSystem::CreateDirectory(char *name)
+{
+    return MakeFile(name, 0, TRUE);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::MakeFile
+// 	Create a file or a directory.
 //
 //	The steps to create a file are:
+//	  Find the directory it is to go in
 //	  Make sure the file doesn't already exist
-//        Allocate a sector for the file header
-// 	  Allocate space on disk for the data blocks for the file
-//	  Add the name to the directory
+//        Allocate a sector for the file header, on the first track with
+//	    room for the whole file, from the directory's track on
+// 	  Allocate space on disk for the data blocks for the file, just
+//	    after the header
 //	  Store the new file header on disk
-//	  Flush the changes to the bitmap and the directory back to disk
+//	  Flush the changes to the bitmap back to disk
+//	  For a directory, make it empty
+//	  Add the name to the directory it goes in
+//
+//	The last two steps may need more space on disk, which is allocated
+//	and written back separately, so they are done once the file has
+//	its space; if they fail, the file's space is given back.
 //
 //	Return TRUE if everything goes ok, otherwise, return FALSE.
 //
 // 	Create fails if:
+//		a directory on the way to the file doesn't exist
 //   		file is already in directory
 //	 	no free space for file header
-//	 	no free entry for file in directory
 //	 	no free space for data blocks for the file
+//	 	no free space for the new entry in the directory
 //
 // 	Note that this implementation assumes there is no concurrent access
 //	to the file system!
 //
-//	"name" -- name of file to be created
+//	"path" -- path name of file to be created
 //	"initialSize" -- size of file to be created
+//	"isDirectory" -- TRUE to create a directory
 //----------------------------------------------------------------------
 
 bool
-FileSystem::Create(char *name, int initialSize)
+FileSystem::MakeFile(char *path, int initialSize, bool isDirectory)
 {
-    Directory *directory;
-    BitMap *freeMap;
+    OpenFile *dirFile, *file;
+    Directory *directory, *newDirectory;
     FileHeader *hdr;
-    int sector;
-    bool success;
+    char name[FileNameMaxLen + 1];
+    int dirSector, sector, track;
+    bool success, found;
 
-    DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
+    DEBUG('f', "Creating %s %s, size %d\n", isDirectory ? "directory" : "file",
+          path, initialSize);
 
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
+    dirSector = FindParent(path, name);
+    if (dirSector == -1)
+        return FALSE;			// no such directory
 
-    if (directory->Find(name) != -1)
+    journal->Begin();
+    if (Lookup(dirSector, name, &found) != -1)
         success = FALSE;			// file is already in directory
     else {
-        freeMap = new BitMap(NumSectors);
-        freeMap->FetchFrom(freeMapFile);
-        sector = freeMap->Find();	// find a sector to hold the file header
+        // find a sector to hold the file header
+        track = freeMap->FindGroup(dirSector / SectorsPerTrack,
+                                   1 + divRoundUp(initialSize, SectorSize));
+        sector = freeMap->FindNear(track * SectorsPerTrack);
+        hdr = new FileHeader;
         if (sector == -1)
             success = FALSE;		// no free block for file header
-        else if (!directory->Add(name, sector))
-            success = FALSE;	// no space in directory
-        else {
-            hdr = new FileHeader;
-            if (!hdr->Allocate(freeMap, initialSize))
-                success = FALSE;	// no space on disk for data
-            else {
-                success = TRUE;
-                // everthing worked, flush all changes back to disk
-                hdr->WriteBack(sector);
-                directory->WriteBack(directoryFile);
-                freeMap->WriteBack(freeMapFile);
+        else if (!hdr->Allocate(freeMap, initialSize, sector + 1)) {
+            freeMap->Clear(sector);
+            success = FALSE;	// no space on disk for data
+        } else {
+            success = TRUE;
+            // everthing worked, flush all changes back to disk
+            hdr->WriteBack(sector);
+            freeMap->WriteBack(freeMapFile);
+
+            if (isDirectory) {
+                file = new OpenFile(sector, TRUE);
+                newDirectory = new Directory(file);
+                success = newDirectory->Initialize(NumDirEntries);
+                delete newDirectory;
+                delete file;
+            }
+            if (success) {
+                dirFile = new OpenFile(dirSector, TRUE);
+                directory = new Directory(dirFile);
+                success = directory->Add(name, sector, isDirectory);
+                delete directory;
+                delete dirFile;
             }
-            delete hdr;
+            if (success)
+                names->Enter(dirSector, name, sector, isDirectory);
+            else
+                FreeFile(sector);	// no space in directory
         }
-        delete freeMap;
+        delete hdr;
     }
-    delete directory;
+    journal->End();
     return success;
 }
 
@@ -218,87 +390,192 @@ FileSystem::Create(char *name, int initialSize)
 // FileSystem::Open
 // 	Open a file for reading and writing.
 //	To open a file:
-//	  Find the location of the file's header, using the directory
+//	  Find the location of the file's header, using the directories
 //	  Bring the header into memory
 //
-//	"name" -- the text name of the file to be opened
+//	"name" -- the path name of the file to be opened
 //----------------------------------------------------------------------
 
 OpenFile *
-FileSystem::Open(char *name)
+FileSystem::Open(char *path)
 {
-    Directory *directory = new Directory(NumDirEntries);
     OpenFile *openFile = NULL;
-    int sector;
+    char name[FileNameMaxLen + 1];
+    int dirSector, sector;
+    bool isDirectory;
     fprintf(stderr," this shit \n");
-    DEBUG('f', "Opening file %s\n", name);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(name);
-    if (sector >= 0)
-        openFile = new OpenFile(sector);	// name was found in directory
-    delete directory;
+    DEBUG('f', "Opening file %s\n", path);
+    dirSector = FindParent(path, name);
+    if (dirSector == -1)
+        return NULL;			// no such directory
+    sector = Lookup(dirSector, name, &isDirectory);
+    if (sector >= 0)			// name was found in directory
+        openFile = new OpenFile(sector, isDirectory);
     return openFile;				// return NULL if not found
 }
 
 //----------------------------------------------------------------------
 // FileSystem::Remove
 // 	Delete a file from the file system.  This requires:
-//	    Remove it from the directory
+//	    Remove it from its directory, and the name cache
 //	    Delete the space for its header
 //	    Delete the space for its data blocks
 //	    Write changes to directory, bitmap back to disk
+//	If the file is open, the last three steps are put off until it
+//	is closed.
 //
 //	Return TRUE if the file was deleted, FALSE if the file wasn't
-//	in the file system.
+//	in the file system, or is a directory with files still in it.
 //
-//	"name" -- the text name of the file to be removed
+//	"name" -- the path name of the file to be removed
 //----------------------------------------------------------------------
 
 bool
-FileSystem::Remove(char *name)
+FileSystem::Remove(char *path)
+{
+    Directory *directory, *subDirectory;
+    OpenFile *dirFile, *subFile;
+    char name[FileNameMaxLen + 1];
+    int dirSector, sector;
+    bool isDirectory, empty;
+
+    dirSector = FindParent(path, name);
+    if (dirSector == -1)
+        return FALSE;			// no such directory
+    sector = Lookup(dirSector, name, &isDirectory);
+    if (sector == -1)
+        return FALSE;			// file not found
+    if (isDirectory) {
+        subFile = new OpenFile(sector, TRUE);
+        subDirectory = new Directory(subFile);
+        empty = subDirectory->IsEmpty();
+        delete subDirectory;
+        delete subFile;
+        if (!empty)
+            return FALSE;		// still has files in it
+    }
+
+    journal->Begin();
+    dirFile = new OpenFile(dirSector, TRUE);
+    directory = new Directory(dirFile);
+    directory->Remove(name);		// flushed to disk
+    delete directory;
+    delete dirFile;
+    names->Remove(dirSector, name);
+    if (!OpenFile::RemoveWhenClosed(sector))
+        FreeFile(sector);
+    journal->End();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FreeFile
+// 	Give back the disk space of the file whose header is in "sector",
+//	and write the bitmap back to disk.  Called once the file has been
+//	removed from its directory, and isn't open.
+//----------------------------------------------------------------------
+
+void
+FileSystem::FreeFile(int sector)
 {
-    Directory *directory;
-    BitMap *freeMap;
     FileHeader *fileHdr;
-    int sector;
+    BitMap *sectors;
 
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(name);
-    if (sector == -1) {
-        delete directory;
-        return FALSE;			 // file not found
-    }
+    journal->Begin();
     fileHdr = new FileHeader;
     fileHdr->FetchFrom(sector);
 
-    freeMap = new BitMap(NumSectors);
-    freeMap->FetchFrom(freeMapFile);
+    // none of its sectors may be written as data until this is committed
+    sectors = new BitMap(NumSectors);
+    (void) fileHdr->MarkSectors(sectors);
+    sectors->Mark(sector);
+    journal->Freed(sectors);
+    delete sectors;
 
     fileHdr->Deallocate(freeMap);  		// remove data blocks
     freeMap->Clear(sector);			// remove header block
-    directory->Remove(name);
 
     freeMap->WriteBack(freeMapFile);		// flush to disk
-    directory->WriteBack(directoryFile);        // flush to disk
     delete fileHdr;
+    journal->End();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::AllocateSectors
+// 	Give disk sectors to the holes in part of an open file, before
+//	it is written, and write the bitmap back to disk.  The caller
+//	writes back the file header, in the same journal operation.
+//	Return FALSE if there isn't room.
+//
+//	"hdr" -- the header of the file being written
+//	"hdrSector" -- where the header is, for the data to go near
+//	"firstSector", "lastSector" -- the sectors of the file to be written
+//----------------------------------------------------------------------
+
+bool
+FileSystem::AllocateSectors(FileHeader *hdr, int hdrSector, int firstSector,
+                            int lastSector)
+{
+    bool success;
+
+    success = hdr->AllocateSectors(freeMap, firstSector, lastSector,
+                                   hdrSector + 1);
+    if (success)
+        freeMap->WriteBack(freeMapFile);
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Check
+// 	Check that the file system is consistent: that no sector is used
+//	by two files, or twice by one, that each directory's header agrees
+//	with its entries, and that the bitmap marks exactly the sectors in
+//	use.  Print what's wrong, and return FALSE, if it isn't.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Check()
+{
+    BitMap *used = new BitMap(NumSectors);
+    FileHeader *hdr = new FileHeader;
+    Directory *directory = new Directory(directoryFile);
+    int wellKnown[3] = { FreeMapSector, DirectorySector, JournalSector };
+    bool ok = TRUE;
+
+    for (int i = 0; i < 3; i++) {
+        used->Mark(wellKnown[i]);
+        hdr->FetchFrom(wellKnown[i]);
+        if (!hdr->MarkSectors(used)) {
+            printf("Check: sector %d's file uses a bad sector\n",
+                   wellKnown[i]);
+            ok = FALSE;
+        }
+    }
+    if (!directory->Check(used))
+        ok = FALSE;
+    for (int i = 0; i < NumSectors; i++)
+        if (used->Test(i) != freeMap->Test(i)) {
+            printf("Check: sector %d is %s, but the bitmap says not\n", i,
+                   used->Test(i) ? "in use" : "free");
+            ok = FALSE;
+        }
+    delete used;
+    delete hdr;
     delete directory;
-    delete freeMap;
-    return TRUE;
+    return ok;
 }
 
 //----------------------------------------------------------------------
 // FileSystem::List
-// 	List all the files in the file system directory.
+// 	List all the files in the file system, by path name.
 //----------------------------------------------------------------------
 
 void
 FileSystem::List()
 {
-    Directory *directory = new Directory(NumDirEntries);
+    Directory *directory = new Directory(directoryFile);
 
-    directory->FetchFrom(directoryFile);
-    directory->List();
+    directory->List("");
     delete directory;
 }
 
@@ -317,8 +594,7 @@ FileSystem::Print()
 {
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
-    BitMap *freeMap = new BitMap(NumSectors);
-    Directory *directory = new Directory(NumDirEntries);
+    Directory *directory = new Directory(directoryFile);
 
     printf("Bit map file header:\n");
     bitHdr->FetchFrom(FreeMapSector);
@@ -328,14 +604,11 @@ FileSystem::Print()
     dirHdr->FetchFrom(DirectorySector);
     dirHdr->Print();
 
-    freeMap->FetchFrom(freeMapFile);
     freeMap->Print();
 
-    directory->FetchFrom(directoryFile);
     directory->Print();
 
     delete bitHdr;
     delete dirHdr;
-    delete freeMap;
     delete directory;
 }
@@ -20,9 +20,10 @@
 //	file system (in a file named "DISK").
 //
 //	In the "real" implementation, there are two key data structures used
-//	in the file system.  There is a single "root" directory, listing
-//	all of the files in the file system; unlike UNIX, the baseline
-//	system does not provide a hierarchical directory structure.
+//	in the file system.  There is a "root" directory, listing files
+//	and further directories, as in UNIX; a file is named by the path
+//	from the root to it, such as "usr/bin/sort" (a leading "/" is
+//	allowed, but there is no current directory, and no "." or "..").
 //	In addition, there is a bitmap for allocating
 //	disk sectors.  Both the root directory and the bitmap are themselves
 //	stored as files in the Nachos file system -- this causes an interesting
@@ -37,6 +38,8 @@
 
 #include "copyright.h"
 #include "openfile.h"
+#include "namecache.h"
+#include "bitmap.h"
 
 #ifdef FILESYS_STUB 		// Temporarily implement file system calls as 
 // calls to UNIX, until the real file system
@@ -75,23 +78,43 @@ public:
     // If "format", there is nothing on
     // the disk, so initialize the directory
     // and the bitmap of free blocks.
+    ~FileSystem();
 
     bool Create(char *name, int initialSize);
     // Create a file (UNIX creat)
+    bool CreateDirectory(char *name);	// Create a directory (UNIX mkdir)
 
     OpenFile* Open(char *name); 	// Open a file (UNIX open)
 
     bool Remove(char *name);  		// Delete a file (UNIX unlink)
 
+    bool AllocateSectors(FileHeader *hdr, int hdrSector, int firstSector,
+                         int lastSector);
+    // Give an open file disk sectors
+    // for the part being written
+    void FreeFile(int sector);		// Give back a removed file's disk
+    // space
+
+    bool Check();			// Is the file system consistent?
+
     void List();			// List all the files in the file system
 
     void Print();			// List all the files and their contents
 
 private:
+    bool MakeFile(char *name, int initialSize, bool isDirectory);
+    // Create a file or a directory
+    int FindParent(char *path, char *name);
+    // Find the directory "path" is in
+    int Lookup(int dirSector, char *name, bool *isDirectory);
+    // Find "name" in a directory
+
     OpenFile* freeMapFile;		// Bit map of free disk blocks,
     // represented as a file
+    BitMap *freeMap;			// The bit map, kept in memory
     OpenFile* directoryFile;		// "Root" directory -- list of
     // file names, represented as a file
+    NameCache *names;			// Recent lookups in directories
 };
 
 #endif // FILESYS
@@ -6,7 +6,13 @@
 //	   Print -- cat the contents of a Nachos file
 //	   Perftest -- a stress test for the Nachos file system
 //		read and write a really large file in tiny chunks
-//		(won't work on baseline system!)
+//		(the file starts empty, and grows as it's written),
+//		through the buffer cache, whose hits and misses are
+//		in the statistics
+//	   CrashTest -- crash Nachos at every point in a series of
+//		file system operations, made while another thread
+//		writes file data, and check that the journal brings
+//		back a consistent file system each time
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation
@@ -180,6 +186,142 @@ PerformanceTest()
         printf("Perf test: unable to remove %s\n", FileName);
         return;
     }
+    bufferCache->Flush();	// so the disk writes are counted
     stats->Print();
 }
 
+
+//----------------------------------------------------------------------
+// CrashTest
+// 	Check that the journal keeps the file system consistent, however
+//	Nachos crashes.  For each number of disk writes "n", format the
+//	disk, and do a series of creates, writes and removes, with the
+//	power failing after the first "n" writes.  Meanwhile another
+//	thread writes a file, so that its data is written while the
+//	operations are under way, and into sectors they free.  Then
+//	recover, as if Nachos had been started again, and check the file
+//	system.  Stop at the first "n" with no writes lost, and check
+//	that everything was done.
+//
+//	Implemented as four routines:
+//	  CrashWork -- the file system operations
+//	  CrashWriter -- the thread writing file data
+//	  Restart -- forget everything in memory, and mount the disk again
+//	  CrashTest -- overall control
+//----------------------------------------------------------------------
+
+#define NumCrashFiles	12
+#define NumCrashWrites	300		// times CrashWriter writes Contents
+
+static Semaphore *writerDone;
+
+static void
+CrashWriter(int arg)
+{
+    OpenFile *openFile = (OpenFile *) arg;
+
+    for (int i = 0; i < NumCrashWrites; i++) {
+        openFile->Write(Contents, ContentSize);
+        currentThread->Yield();
+    }
+    delete openFile;
+    writerDone->V();
+}
+
+static void
+CrashWork()
+{
+    OpenFile *openFile;
+    Thread *writer;
+    char name[FileNameMaxLen + 1];
+    int i;
+
+    writerDone = new Semaphore("crash writer", 0);
+    fileSystem->Create("data", 0);
+    if ((openFile = fileSystem->Open("data")) != NULL) {
+        writer = new Thread("crash writer");
+        writer->Fork(CrashWriter, (int) openFile);
+    } else
+        writerDone->V();
+
+    fileSystem->CreateDirectory("d");
+    for (i = 0; i < NumCrashFiles; i++) {
+        sprintf(name, "d/f%d", i);
+        fileSystem->Create(name, i * 300);
+    }
+    if ((openFile = fileSystem->Open("d/f1")) != NULL) {
+        for (i = 0; i < 200; i++)	// make it grow
+            openFile->Write(Contents, ContentSize);
+        delete openFile;
+    }
+    for (i = 0; i < NumCrashFiles; i += 3) {
+        sprintf(name, "d/f%d", i);
+        fileSystem->Remove(name);
+    }
+    fileSystem->Create("big", 20000);
+    fileSystem->Remove("d/f1");
+    writerDone->P();
+    delete writerDone;
+    bufferCache->Flush();
+}
+
+static bool
+Restart(bool format)
+{
+    bool crashed;
+
+    bufferCache->Flush();	// lost, if the disk has crashed
+    delete fileSystem;
+    bufferCache->Invalidate();	// waits for read-ahead and write-behind
+				// under way, so none follows recovery
+    crashed = synchDisk->Restart();
+    fileSystem = new FileSystem(format);
+    return crashed;
+}
+
+void
+CrashTest()
+{
+    OpenFile *openFile, *dataFile;
+    char *buffer = new char[ContentSize];
+    int i, numWrites, numBad = 0;
+    bool crashed = TRUE;
+
+    printf("Starting file system crash test:\n");
+    for (numWrites = 0; crashed; numWrites++) {
+        Restart(TRUE);
+        bufferCache->Flush();		// get the new file system on disk
+        synchDisk->CrashAfter(numWrites);
+        CrashWork();
+        crashed = Restart(FALSE);
+        if (!fileSystem->Check()) {
+            printf("Crash test: inconsistent after %d writes\n", numWrites);
+            numBad++;
+        }
+    }
+
+    // the last time round, nothing was lost
+    openFile = fileSystem->Open("big");
+    dataFile = fileSystem->Open("data");
+    if (openFile == NULL || openFile->Length() != 20000
+            || dataFile == NULL
+            || dataFile->Length() != (int) (NumCrashWrites * ContentSize)
+            || fileSystem->Open("d/f1") != NULL
+            || fileSystem->Open("d/f3") != NULL) {
+        printf("Crash test: operations missing without a crash\n");
+        numBad++;
+    } else
+        for (i = 0; i < NumCrashWrites; i++) {
+            dataFile->Read(buffer, ContentSize);
+            if (strncmp(buffer, Contents, ContentSize) != 0) {
+                printf("Crash test: data overwritten at %d\n",
+                       (int) (i * ContentSize));
+                numBad++;
+                break;
+            }
+        }
+    delete openFile;
+    delete dataFile;
+    delete [] buffer;
+    printf("Crash test: %d crashes, %d inconsistent\n", numWrites - 1, numBad);
+}
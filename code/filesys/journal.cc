@@ -0,0 +1,463 @@
+// journal.cc
+//	Routines to keep a write-ahead journal of the file system's
+//	metadata.  See journal.h.
+//
+//	The journal keeps two tables of sectors in memory: the running
+//	transaction, and the sectors committed since the last checkpoint.
+//	A sector is in each at most once, with its newest contents.  A
+//	sector in either belongs to the journal: the buffer cache doesn't
+//	write it back, and gets it from the journal if it has to read it.
+//
+//	A sector that is written as data, but is in one of the tables,
+//	was metadata and has been freed.  The journal is committed if
+//	need be, and checkpointed, before the data is written, so that
+//	recovering can't put the old contents back over the data.  So is
+//	a metadata sector written outside any operation.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#include "journal.h"
+#include "filehdr.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// Journal::Journal
+// 	Find the sectors of the log, and then either empty it, for a
+//	newly formatted disk, or recover the committed transactions in it.
+//	Must be done before anything that may be in the log is read
+//	through the buffer cache.
+//
+//	"hdrSector" -- the sector of the log's file header
+//	"format" -- TRUE if the disk is being formatted
+//----------------------------------------------------------------------
+
+Journal::Journal(int hdrSector, bool format)
+{
+    FileHeader *hdr = new FileHeader;
+    char zeroes[SectorSize];
+    char *data[JournalSectors];
+
+    hdr->FetchFrom(hdrSector);
+    for (int i = 0; i < JournalSectors; i++)
+        logSectors[i] = hdr->ByteToSector(i * SectorSize);
+    delete hdr;
+
+    running = new JournalEntry[JournalSectors];
+    committed = new JournalEntry[JournalSectors];
+    numRunning = numCommitted = handles = 0;
+    lock = new Lock("journal");
+    idle = new Condition("journal idle");
+    freed = new BitMap(NumSectors);
+    logEnd = 1;
+
+    if (format) {
+        // nothing left on the disk should look like a record
+        bzero(zeroes, SectorSize);
+        for (int i = 1; i < JournalSectors; i++)
+            data[i] = zeroes;
+        WriteLog(1, JournalSectors - 1, &data[1]);
+        sequence = 1;
+        WriteHeader();
+    } else
+        Recover();
+}
+
+//----------------------------------------------------------------------
+// Journal::~Journal
+// 	De-allocate the journal.  Anything not committed is lost.
+//----------------------------------------------------------------------
+
+Journal::~Journal()
+{
+    delete [] running;
+    delete [] committed;
+    delete lock;
+    delete idle;
+    delete freed;
+}
+
+//----------------------------------------------------------------------
+// Journal::Recover
+// 	Copy the sectors of each committed transaction in the log to
+//	their places on disk, in the order they were committed, and then
+//	empty the log.  A transaction without its commit record -- the
+//	one being written when the system crashed -- is ignored.
+//----------------------------------------------------------------------
+
+void
+Journal::Recover()
+{
+    JournalRecord record;
+    int pendingSector[JournalSectors], pendingLog[JournalSectors];
+    int numPending = 0, pos = 1;
+    char data[SectorSize];
+
+    synchDisk->ReadSector(logSectors[0], (char *) &record);
+    sequence = record.sequence;
+    while (pos < JournalSectors) {
+        synchDisk->ReadSector(logSectors[pos], (char *) &record);
+        if (record.sequence != sequence)
+            break;			// end of the log
+        if (record.type == JournalDescriptor && record.count >= 0
+                && record.count <= JournalRecordSectors
+                && pos + 1 + record.count <= JournalSectors) {
+            for (int i = 0; i < record.count; i++) {
+                if (record.sectors[i] < 0 || record.sectors[i] >= NumSectors)
+                    break;
+                pendingSector[numPending] = record.sectors[i];
+                pendingLog[numPending++] = pos + 1 + i;
+            }
+            pos += 1 + record.count;
+        } else if (record.type == JournalCommit
+                   && record.count == numPending) {
+            DEBUG('f', "Recovering transaction %d, %d sectors\n", sequence,
+                  numPending);
+            for (int i = 0; i < numPending; i++) {
+                synchDisk->ReadSector(logSectors[pendingLog[i]], data);
+                synchDisk->WriteSector(pendingSector[i], data);
+            }
+            stats->numJournalRecovered += numPending;
+            numPending = 0;
+            sequence++;
+            pos++;
+        } else
+            break;			// an unfinished transaction
+    }
+
+    // skip the number an unfinished transaction may have used, so that
+    // none of its records are taken for part of the next one
+    sequence++;
+    WriteHeader();
+}
+
+//----------------------------------------------------------------------
+// Journal::Begin/End
+// 	Start or finish an operation that changes metadata.  Operations
+//	may be nested.  When no operation is under way, and the running
+//	transaction is big enough, it is committed, and any data writes
+//	waiting for that are woken up.
+//----------------------------------------------------------------------
+
+void
+Journal::Begin()
+{
+    lock->Acquire();
+    handles++;
+    lock->Release();
+}
+
+void
+Journal::End()
+{
+    lock->Acquire();
+    ASSERT(handles > 0);
+    handles--;
+    if (handles == 0) {
+        if (numRunning >= JournalBatch)
+            CommitLocked();
+        idle->Broadcast(lock);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::Commit
+// 	Commit the running transaction, unless an operation is part way
+//	through changing it.  Called when the buffer cache is flushed.
+//----------------------------------------------------------------------
+
+void
+Journal::Commit()
+{
+    lock->Acquire();
+    if (handles == 0)
+        CommitLocked();
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::CommitLocked
+// 	Write the running transaction to the log -- its descriptor
+//	records, each followed by the sectors it lists, and then a commit
+//	record -- checkpointing first if the log is too full.  All but
+//	the commit record are written together; it is written only once
+//	the rest is on disk, since each write waits for the disk.  The
+//	lock must be held.
+//----------------------------------------------------------------------
+
+void
+Journal::CommitLocked()
+{
+    JournalRecord record;
+    JournalRecord descriptors[divRoundUp(JournalSectors, JournalRecordSectors)];
+    char *data[JournalSectors];
+    JournalEntry *entry;
+    int i, count, n = 0, numDescriptors = 0;
+
+    if (numRunning == 0)
+        return;
+    if (logEnd + LogSpace(numRunning) > JournalSectors)
+        Checkpoint();
+    ASSERT(logEnd + LogSpace(numRunning) <= JournalSectors);
+    DEBUG('f', "Committing transaction %d, %d sectors\n", sequence,
+          numRunning);
+
+    for (i = 0; i < numRunning; i += count) {
+        JournalRecord *descriptor = &descriptors[numDescriptors++];
+
+        count = min(numRunning - i, JournalRecordSectors);
+        bzero((char *) descriptor, sizeof(JournalRecord));
+        descriptor->type = JournalDescriptor;
+        descriptor->sequence = sequence;
+        descriptor->count = count;
+        data[n++] = (char *) descriptor;
+        for (int j = 0; j < count; j++) {
+            descriptor->sectors[j] = running[i + j].sector;
+            data[n++] = running[i + j].data;
+        }
+    }
+    WriteLog(logEnd, n, data);
+    logEnd += n;
+    bzero((char *) &record, sizeof(JournalRecord));
+    record.type = JournalCommit;
+    record.sequence = sequence;
+    record.count = numRunning;
+    synchDisk->WriteSector(logSectors[logEnd++], (char *) &record);
+    sequence++;
+    stats->numJournalCommits++;
+    stats->numJournalSectors += numRunning;
+
+    for (i = 0; i < numRunning; i++) {
+        entry = Find(committed, numCommitted, running[i].sector);
+        if (entry == NULL)
+            entry = &committed[numCommitted++];
+        *entry = running[i];
+    }
+    numRunning = 0;
+    for (i = 0; i < NumSectors; i++)	// those frees are done with
+        if (freed->Test(i))
+            freed->Clear(i);
+}
+
+//----------------------------------------------------------------------
+// Journal::Checkpoint
+// 	Write each committed sector to its place, in order of sector
+//	number, with one disk request for each run of consecutive
+//	sectors, and then empty the log.  The lock must be held.
+//----------------------------------------------------------------------
+
+void
+Journal::Checkpoint()
+{
+    JournalEntry entry;
+    char *data[JournalSectors];
+    int i, j;
+
+    DEBUG('f', "Checkpointing %d sectors\n", numCommitted);
+    for (i = 1; i < numCommitted; i++) {
+        entry = committed[i];
+        for (j = i; j > 0 && committed[j - 1].sector > entry.sector; j--)
+            committed[j] = committed[j - 1];
+        committed[j] = entry;
+    }
+    for (i = 0; i < numCommitted; i = j) {
+        for (j = i; j < numCommitted
+                && committed[j].sector == committed[i].sector + j - i; j++)
+            data[j - i] = committed[j].data;
+        synchDisk->WriteSectors(committed[i].sector, j - i, data);
+    }
+    numCommitted = 0;
+    logEnd = 1;
+    WriteHeader();
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteHeader
+// 	Write the first sector of the log, saying that the next
+//	transaction is the first one in it.
+//----------------------------------------------------------------------
+
+void
+Journal::WriteHeader()
+{
+    JournalRecord record;
+
+    bzero((char *) &record, sizeof(JournalRecord));
+    record.sequence = sequence;
+    synchDisk->WriteSector(logSectors[0], (char *) &record);
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteLog
+// 	Write "count" sectors to the log, starting at sector "pos" of it,
+//	with one disk request for each run of them that is consecutive on
+//	disk.
+//
+//	"pos" -- where in the log to start
+//	"count" -- how many sectors to write
+//	"data" -- the contents of each
+//----------------------------------------------------------------------
+
+void
+Journal::WriteLog(int pos, int count, char **data)
+{
+    int i, j;
+
+    for (i = 0; i < count; i = j) {
+        for (j = i + 1; j < count
+                && logSectors[pos + j] == logSectors[pos + i] + j - i; j++)
+            ;
+        synchDisk->WriteSectors(logSectors[pos + i], j - i, &data[i]);
+    }
+}
+
+//----------------------------------------------------------------------
+// Journal::Write
+// 	Note that the buffer cache has changed metadata "sector" to
+//	"data".  If an operation is under way, the sector joins the
+//	running transaction (committing what's there already, if there
+//	would be no room in the log for it).  If not, and the journal has
+//	the sector, it is checkpointed, so that the sector can be written
+//	in place.
+//
+//	"sector" -- the sector changed
+//	"data" -- its new contents
+//----------------------------------------------------------------------
+
+void
+Journal::Write(int sector, char *data)
+{
+    JournalEntry *entry;
+
+    lock->Acquire();
+    if (handles > 0) {
+        entry = Find(running, numRunning, sector);
+        if (entry == NULL) {
+            if (1 + LogSpace(numRunning + 1) > JournalSectors) {
+                DEBUG('f', "Operation too big for the journal\n");
+                CommitLocked();
+            }
+            entry = &running[numRunning++];
+            entry->sector = sector;
+        }
+        bcopy(data, entry->data, SectorSize);
+    } else if (Find(running, numRunning, sector) != NULL
+               || Find(committed, numCommitted, sector) != NULL) {
+        CommitLocked();
+        Checkpoint();
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::Read
+// 	If the journal has "sector", copy its newest contents into
+//	"data", and return TRUE.
+//----------------------------------------------------------------------
+
+bool
+Journal::Read(int sector, char *data)
+{
+    JournalEntry *entry;
+
+    lock->Acquire();
+    entry = Find(running, numRunning, sector);
+    if (entry == NULL)
+        entry = Find(committed, numCommitted, sector);
+    if (entry != NULL)
+        bcopy(entry->data, data, SectorSize);
+    lock->Release();
+    return entry != NULL;
+}
+
+//----------------------------------------------------------------------
+// Journal::Holds
+// 	Return TRUE if "sector" is in the running transaction, or has been
+//	committed but not checkpointed.
+//----------------------------------------------------------------------
+
+bool
+Journal::Holds(int sector)
+{
+    bool found;
+
+    lock->Acquire();
+    found = (Find(running, numRunning, sector) != NULL
+             || Find(committed, numCommitted, sector) != NULL);
+    lock->Release();
+    return found;
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteData
+// 	Called before "sector" is written as file data.  If an operation
+//	in the running transaction freed it, or the journal has it, wait
+//	until no operation is under way, and commit the transaction, so
+//	that the sector is free on disk too; if the journal has it,
+//	checkpoint as well, so that it can't be recovered over the data.
+//
+//	"sector" -- the sector about to be written
+//----------------------------------------------------------------------
+
+void
+Journal::WriteData(int sector)
+{
+    lock->Acquire();
+    while (handles > 0 && (freed->Test(sector)
+                           || Find(running, numRunning, sector) != NULL))
+        idle->Wait(lock);
+    if (freed->Test(sector) || Find(running, numRunning, sector) != NULL)
+        CommitLocked();
+    if (Find(committed, numCommitted, sector) != NULL)
+        Checkpoint();
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::Freed
+// 	Note that an operation has freed the sectors marked in "sectors",
+//	so they can't be written as data until it has been committed.
+//
+//	"sectors" -- the sectors freed
+//----------------------------------------------------------------------
+
+void
+Journal::Freed(BitMap *sectors)
+{
+    lock->Acquire();
+    ASSERT(handles > 0);
+    for (int i = 0; i < NumSectors; i++)
+        if (sectors->Test(i))
+            freed->Mark(i);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::LogSpace
+// 	Return the number of log sectors a transaction of "numSectors"
+//	sectors takes: its descriptors, the sectors, and the commit record.
+//----------------------------------------------------------------------
+
+int
+Journal::LogSpace(int numSectors)
+{
+    return divRoundUp(numSectors, JournalRecordSectors) + numSectors + 1;
+}
+
+//----------------------------------------------------------------------
+// Journal::Find
+// 	Return the entry for "sector" in a table, or NULL.
+//----------------------------------------------------------------------
+
+JournalEntry *
+Journal::Find(JournalEntry *table, int size, int sector)
+{
+    for (int i = 0; i < size; i++)
+        if (table[i].sector == sector)
+            return &table[i];
+    return NULL;
+}
@@ -0,0 +1,136 @@
+// journal.h
+//	Data structures for a write-ahead journal of changes to the file
+//	system's metadata -- file headers, indirect blocks, directories
+//	and the bitmap of free sectors.
+//
+//	An operation that changes metadata (creating or removing a file,
+//	or giving a file more sectors) is bracketed by Begin and End.
+//	Every metadata sector written through the buffer cache in between
+//	(by any thread) is copied into the running transaction, and isn't
+//	written to its place on disk until the transaction is committed:
+//	written, with a record of where each sector goes, to the log,
+//	followed by a commit record.  After a crash, the sectors of every committed
+//	transaction in the log are copied to their places, so each
+//	operation is either done completely or not at all.
+//
+//	File data is never journaled.  But a sector that an operation in
+//	the running transaction freed mustn't be written as data until
+//	the transaction is committed -- if the system crashed first, the
+//	sector would still belong to its old file.  So a data write to
+//	one waits until no operation is under way, and commits.
+//
+//	Transactions are committed in groups: many operations join the
+//	running transaction, and it is committed only when it has
+//	JournalBatch sectors in it, or when the cache is flushed.  A
+//	sector changed by many operations -- the bitmap, or a directory
+//	-- is only logged once per commit.
+//
+//	Committed sectors are copied to their places when the log is
+//	full (a "checkpoint"), and the log is then emptied.  Until then,
+//	the journal keeps them in memory, and the buffer cache asks it for
+//	them, rather than reading the disk.
+//
+//	Operations under way at once share the running transaction.  If
+//	between them they change more sectors than the log can hold, it
+//	is committed in pieces, so they aren't atomic.  One operation
+//	alone only does that when making a very big directory bigger.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "disk.h"
+#include "synch.h"
+#include "bitmap.h"
+
+#define JournalSectors	64	// size of the log, including its header
+#define JournalBatch	16	// sectors in a transaction before it
+				// is committed
+
+// The first sector of the log says which transaction comes first in
+// it; the transactions follow.  Each is one or more descriptor records,
+// each followed by the sectors it lists, and then a commit record.
+// Records left in the log from before it was last emptied have older
+// sequence numbers, so they are ignored.
+#define JournalDescriptor	0x4a726e6c	// record types
+#define JournalCommit		0x436d6974
+#define JournalRecordSectors	((int)((SectorSize - 3 * sizeof(int)) \
+				       / sizeof(int)))
+
+class JournalRecord {
+public:
+    int type;				// JournalDescriptor or JournalCommit
+    int sequence;			// the transaction's number
+    int count;				// sectors listed in a descriptor;
+    // sectors in the transaction, in a commit
+    int sectors[JournalRecordSectors];	// where the sectors go
+};
+
+// A sector changed by a transaction, and its new contents.
+class JournalEntry {
+public:
+    int sector;
+    char data[SectorSize];
+};
+
+// The following class defines the journal.  The log is a file, whose
+// header is at a well-known sector; it is read and written directly
+// on the disk, not through the buffer cache.
+class Journal {
+public:
+    Journal(int hdrSector, bool format);
+    // Use the log whose file header is at
+    // "hdrSector": empty it if "format",
+    // or else recover from it
+    ~Journal();
+
+    void Begin();			// Start an operation
+    void End();				// Finish it
+    void Commit();			// Commit the running transaction,
+    // if no operation is under way
+
+    // Called by the buffer cache
+    void Write(int sector, char *data);	// "sector" has been changed
+    bool Read(int sector, char *data);	// Copy the newest contents of
+    // "sector", if the journal has them
+    bool Holds(int sector);		// Does the journal have "sector"?
+    // If so, the cache mustn't write it
+    void WriteData(int sector);		// "sector" is about to be written
+    // as file data
+
+    void Freed(BitMap *sectors);	// The running operation has freed
+    // the sectors marked in "sectors"
+
+private:
+    void Recover();			// Copy committed transactions
+    // from the log to their places
+    void CommitLocked();		// Commit, with the lock held
+    void Checkpoint();			// Copy the committed sectors to
+    // their places, and empty the log
+    void WriteHeader();			// Write the log's first sector
+    void WriteLog(int pos, int count, char **data);
+    // Write sectors to the log
+    int LogSpace(int numSectors);	// Log sectors used by a transaction
+    // of "numSectors" sectors
+    JournalEntry *Find(JournalEntry *table, int size, int sector);
+
+    int logSectors[JournalSectors];	// disk sector of each log sector
+    int logEnd;				// where the next transaction goes
+    int sequence;			// number of the next transaction
+    int handles;			// operations under way
+    Condition *idle;			// signalled when none are
+    BitMap *freed;			// sectors freed by the running
+    // transaction
+    JournalEntry *running;		// the running transaction
+    int numRunning;
+    JournalEntry *committed;		// committed, but not checkpointed
+    int numCommitted;
+    Lock *lock;
+};
+
+#endif // JOURNAL_H
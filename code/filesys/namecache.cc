@@ -0,0 +1,108 @@
+// namecache.cc
+//	Routines to cache directory lookups.  See namecache.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "namecache.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// NameCache::NameCache
+// 	Initialize an empty cache.
+//
+//	"n" -- how many slots to have
+//----------------------------------------------------------------------
+
+NameCache::NameCache(int n)
+{
+    numSlots = n;
+    table = new NameCacheEntry[numSlots];
+    for (int i = 0; i < numSlots; i++)
+        table[i].dirSector = -1;
+}
+
+//----------------------------------------------------------------------
+// NameCache::~NameCache
+// 	De-allocate the cache.
+//----------------------------------------------------------------------
+
+NameCache::~NameCache()
+{
+    delete [] table;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Slot
+// 	Return the slot that "name", in the directory whose header is at
+//	"dirSector", is cached in if it's cached at all.
+//----------------------------------------------------------------------
+
+NameCacheEntry *
+NameCache::Slot(int dirSector, char *name)
+{
+    unsigned int hash = dirSector;
+
+    for (int i = 0; i < FileNameMaxLen && name[i] != '\0'; i++)
+        hash = hash * 31 + (unsigned char) name[i];
+    return &table[hash % numSlots];
+}
+
+//----------------------------------------------------------------------
+// NameCache::Lookup
+// 	Return the sector of the header of the file "name", in the
+//	directory whose header is at "dirSector", or -1 if it isn't cached.
+//
+//	"isDirectory" -- where to store whether the file is a directory
+//----------------------------------------------------------------------
+
+int
+NameCache::Lookup(int dirSector, char *name, bool *isDirectory)
+{
+    NameCacheEntry *entry = Slot(dirSector, name);
+
+    if (entry->dirSector != dirSector
+            || strncmp(entry->name, name, FileNameMaxLen)) {
+        stats->numNameCacheMisses++;
+        return -1;
+    }
+    stats->numNameCacheHits++;
+    *isDirectory = entry->isDirectory;
+    return entry->sector;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Enter
+// 	Remember that the file "name", in the directory whose header is at
+//	"dirSector", has its header at "sector".
+//----------------------------------------------------------------------
+
+void
+NameCache::Enter(int dirSector, char *name, int sector, bool isDirectory)
+{
+    NameCacheEntry *entry = Slot(dirSector, name);
+
+    entry->dirSector = dirSector;
+    strncpy(entry->name, name, FileNameMaxLen);
+    entry->name[FileNameMaxLen] = '\0';
+    entry->sector = sector;
+    entry->isDirectory = isDirectory;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Remove
+// 	Forget the file "name" in the directory whose header is at
+//	"dirSector", because it's being removed.
+//----------------------------------------------------------------------
+
+void
+NameCache::Remove(int dirSector, char *name)
+{
+    NameCacheEntry *entry = Slot(dirSector, name);
+
+    if (entry->dirSector == dirSector
+            && !strncmp(entry->name, name, FileNameMaxLen))
+        entry->dirSector = -1;
+}
@@ -0,0 +1,58 @@
+// namecache.h
+//	Data structures for a cache of directory lookups -- which sector
+//	holds the file header for a name in a given directory -- so that
+//	opening a file that was opened recently doesn't read any
+//	directories.
+//
+//	The cache is a hash table with one entry per slot: a new name
+//	replaces whatever was in its slot.  Only names that were found
+//	are cached.  A name must be dropped from the cache when it is
+//	removed from its directory.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef NAMECACHE_H
+#define NAMECACHE_H
+
+#include "directory.h"
+
+#define NumNameCacheSlots	256	// names kept in the cache
+
+// One name: "name" in the directory whose header is at "dirSector" has
+// its header at "sector".  "dirSector" is -1 if the slot is empty.
+class NameCacheEntry {
+public:
+    int dirSector;
+    char name[FileNameMaxLen + 1];
+    int sector;
+    bool isDirectory;
+};
+
+// The following class defines the cache.
+class NameCache {
+public:
+    NameCache(int numSlots);		// Initialize an empty cache
+    ~NameCache();			// De-allocate the cache
+
+    int Lookup(int dirSector, char *name, bool *isDirectory);
+    // Return the header sector for "name"
+    // in a directory, or -1 if it isn't
+    // cached
+    void Enter(int dirSector, char *name, int sector, bool isDirectory);
+    // Remember where "name" is
+    void Remove(int dirSector, char *name);
+    // Forget "name", if it's cached
+
+private:
+    NameCacheEntry *Slot(int dirSector, char *name);
+    // Where "name" is, or would go
+
+    NameCacheEntry *table;		// the slots
+    int numSlots;
+};
+
+#endif // NAMECACHE_H
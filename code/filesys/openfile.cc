@@ -5,7 +5,21 @@
 //	the OpenFile data structure).
 //
 //	Also as in UNIX, for convenience, we keep the file header in
-//	memory while the file is open.
+//	memory while the file is open -- one copy, however many times the
+//	file is open, so opening a file that's already open reads nothing
+//	from disk.  A file removed while it's open keeps its disk space
+//	until it is closed for the last time.  Writing past the end of the file
+//	makes it longer; only the sectors actually written are given disk
+//	space, so any sectors skipped over are holes, and read as zeroes.
+//
+//	A read that starts where the last one ended is taken to be part
+//	of a sequential scan, and the next ReadAheadSectors sectors of
+//	the file are read ahead, so that they are (or will soon be) in
+//	the buffer cache when they're wanted.  Likewise, once a sequential
+//	writer has filled a sector, it is written behind, rather than
+//	waiting in the cache for the flusher.  Both are asked for a run
+//	of consecutive disk sectors at a time, so that the cache can
+//	transfer each run with one disk request.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation
@@ -19,29 +33,99 @@
 #include <strings.h>
 #endif
 
+// The headers of the open files.  There are rarely more than a few.
+static OpenHeader *openHeaders = NULL;
+
+//----------------------------------------------------------------------
+// FindOpenHeader
+// 	Return the header of the open file whose header is at "sector",
+//	or NULL if the file isn't open.
+//----------------------------------------------------------------------
+
+static OpenHeader *
+FindOpenHeader(int sector)
+{
+    OpenHeader *shared;
+
+    for (shared = openHeaders; shared != NULL; shared = shared->next)
+        if (shared->sector == sector)
+            return shared;
+    return NULL;
+}
+
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+//	into memory while the file is open, unless it's already there.
 //
 //	"sector" -- the location on disk of the file header for this file
+//	"metadata" -- TRUE if the file is the bitmap or a directory, so
+//		that what is written to it is journaled, like its header
 //----------------------------------------------------------------------
 
-OpenFile::OpenFile(int sector)
+OpenFile::OpenFile(int sector, bool metadata)
 {
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    shared = FindOpenHeader(sector);
+    if (shared == NULL) {
+        shared = new OpenHeader;
+        shared->sector = sector;
+        shared->refs = 0;
+        shared->removed = FALSE;
+        shared->metadata = FALSE;
+        shared->hdr = new FileHeader;
+        shared->hdr->FetchFrom(sector);
+        shared->next = openHeaders;
+        openHeaders = shared;
+    }
+    shared->refs++;
+    shared->metadata = shared->metadata || metadata;
+    hdr = shared->hdr;
+    hdrSector = sector;
     seekPosition = 0;
+    readEnd = readAheadEnd = writeEnd = 0;
 }
 
 //----------------------------------------------------------------------
 // OpenFile::~OpenFile
-// 	Close a Nachos file, de-allocating any in-memory data structures.
+// 	Close a Nachos file, de-allocating any in-memory data structures
+//	no other OpenFile is using.  Closing the last OpenFile on a file
+//	that has been removed frees its disk space.
 //----------------------------------------------------------------------
 
 OpenFile::~OpenFile()
 {
+    OpenHeader **link;
+
+    if (--shared->refs > 0)
+        return;
+    for (link = &openHeaders; *link != shared; link = &(*link)->next)
+        ASSERT(*link != NULL);
+    *link = shared->next;
+    if (shared->removed)
+        fileSystem->FreeFile(hdrSector);
     delete hdr;
+    delete shared;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::RemoveWhenClosed
+// 	Called when a file is removed from its directory.  If the file is
+//	open, note that its disk space is to be freed when the last
+//	OpenFile on it is closed, and return TRUE; if not, return FALSE,
+//	and the caller frees it now.
+//
+//	"sector" -- the location on disk of the file header for the file
+//----------------------------------------------------------------------
+
+bool
+OpenFile::RemoveWhenClosed(int sector)
+{
+    OpenHeader *shared = FindOpenHeader(sector);
+
+    if (shared == NULL)
+        return FALSE;
+    shared->removed = TRUE;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -94,17 +178,17 @@ OpenFile::Write(char *into, int numBytes)
 //	no side effects (except that Write modifies the file, of course).
 //
 //	There is no guarantee the request starts or ends on an even disk sector
-//	boundary; however the disk only knows how to read/write a whole disk
-//	sector at a time.  Thus:
+//	boundary.  Each sector the request touches is read or written
+//	through the buffer cache, which holds whole sectors: for the
+//	first and last sectors we transfer only the part in the request.
+//	A partial sector write changes the cached copy of the sector, so
+//	the rest of it is only read from disk if it isn't cached already.
+//	The bytes written are journaled only if the file is metadata.
 //
-//	For ReadAt:
-//	   We read in all of the full or partial sectors that are part of the
-//	   request, but we only copy the part we are interested in.
-//	For WriteAt:
-//	   We must first read in any sectors that will be partially written,
-//	   so that we don't overwrite the unmodified portion.  We then copy
-//	   in the data that will be modified, and write back all the full
-//	   or partial sectors that are part of the request.
+//	A read of a hole gives zeroes.  A write past the end of the file,
+//	or into a hole, first gets disk sectors for the part written, and
+//	then makes the file longer if need be; a new sector only partly
+//	written is zeroed first.
 //
 //	"into" -- the buffer to contain the data to be read from disk
 //	"from" -- the buffer containing the data to be written to disk
@@ -117,8 +201,7 @@ int
 OpenFile::ReadAt(char *into, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    char *buf;
+    int i, firstSector, lastSector, start, end, sector;
 
     if ((numBytes <= 0) || (position >= fileLength))
         return 0; 				// check request
@@ -129,17 +212,24 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
 
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
 
-    // read in all the full and partial sectors that we need
-    buf = new char[numSectors * SectorSize];
-    for (i = firstSector; i <= lastSector; i++)
-        synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize),
-                              &buf[(i - firstSector) * SectorSize]);
+    // copy the part of each sector that we want
+    for (i = firstSector; i <= lastSector; i++) {
+        start = max(position, i * SectorSize);
+        end = min(position + numBytes, (i + 1) * SectorSize);
+        sector = hdr->ByteToSector(i * SectorSize);
+        if (sector < 0)				// a hole
+            bzero(&into[start - position], end - start);
+        else
+            bufferCache->ReadBytes(sector, &into[start - position],
+                                   start - i * SectorSize, end - start);
+    }
 
-    // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
-    delete [] buf;
+    if (position == readEnd)		// sequential
+        ReadAhead(lastSector);
+    else
+        readAheadEnd = lastSector + 1;
+    readEnd = position + numBytes;
     return numBytes;
 }
 
@@ -147,44 +237,113 @@ int
 OpenFile::WriteAt(char *from, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
-    char *buf;
+    int i, firstSector, lastSector, start, end, sector;
+    bool firstIsHole, lastIsHole, changed = FALSE;
+    char zeroes[SectorSize];
 
-    if ((numBytes <= 0) || (position >= fileLength))
+    if ((numBytes <= 0) || (position >= MaxFileSize))
         return 0;				// check request
-    if ((position + numBytes) > fileLength)
-        numBytes = fileLength - position;
+    if ((position + numBytes) > MaxFileSize)
+        numBytes = MaxFileSize - position;
     DEBUG('f', "Writing %d bytes at %d, from file of length %d.\n",
           numBytes, position, fileLength);
 
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
 
-    buf = new char[numSectors * SectorSize];
-
-    firstAligned = (position == (firstSector * SectorSize));
-    lastAligned = ((position + numBytes) == ((lastSector + 1) * SectorSize));
+    // give the sectors we're writing disk space, if they have none, and
+    // the file its new length, as one journal operation
+    firstIsHole = (hdr->ByteToSector(firstSector * SectorSize) < 0);
+    lastIsHole = (hdr->ByteToSector(lastSector * SectorSize) < 0);
+    journal->Begin();
+    for (i = firstSector; i <= lastSector; i++)
+        if (hdr->ByteToSector(i * SectorSize) < 0) {
+            if (!fileSystem->AllocateSectors(hdr, hdrSector, firstSector,
+                                             lastSector)) {
+                journal->End();
+                return 0;			// disk full
+            }
+            changed = TRUE;
+            break;
+        }
+    if ((position + numBytes) > fileLength) {
+        hdr->SetLength(position + numBytes);
+        changed = TRUE;
+    }
+    if (changed)
+        hdr->WriteBack(hdrSector);
+    journal->End();
 
-// read in first and last sector, if they are to be partially modified
-    if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);
-    if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize],
-               SectorSize, lastSector * SectorSize);
+    // copy in the bytes we want to change, a sector at a time
+    bzero(zeroes, SectorSize);
+    for (i = firstSector; i <= lastSector; i++) {
+        start = max(position, i * SectorSize);
+        end = min(position + numBytes, (i + 1) * SectorSize);
+        sector = hdr->ByteToSector(i * SectorSize);
+        if (end - start < SectorSize && ((i == firstSector && firstIsHole)
+                                         || (i == lastSector && lastIsHole)))
+            bufferCache->WriteSector(sector, zeroes, shared->metadata);
+        bufferCache->WriteBytes(sector, &from[start - position],
+                                start - i * SectorSize, end - start,
+                                shared->metadata);
+    }
 
-// copy in the bytes we want to change
-    bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
+    // a sequential writer is done with every sector it has filled
+    if (position == writeEnd) {
+        int run = 0, runStart = 0;
 
-// write modified sectors back
-    for (i = firstSector; i <= lastSector; i++)
-        synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize),
-                               &buf[(i - firstSector) * SectorSize]);
-    delete [] buf;
+        for (i = firstSector; (i + 1) * SectorSize <= position + numBytes; i++) {
+            sector = hdr->ByteToSector(i * SectorSize);
+            if (run > 0 && sector != runStart + run) {
+                bufferCache->WriteBehind(runStart, run);
+                run = 0;
+            }
+            if (run++ == 0)
+                runStart = sector;
+        }
+        if (run > 0)
+            bufferCache->WriteBehind(runStart, run);
+    }
+    writeEnd = position + numBytes;
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// OpenFile::ReadAhead
+// 	Ask the buffer cache to read ahead the file sectors after
+//	"lastSector", up to ReadAheadSectors of them, skipping any already
+//	asked for, and any holes.  Nothing is asked for until fewer than
+//	half that many are left ahead of the reader, so that they are
+//	asked for a few at a time, and sectors next to each other on disk
+//	are asked for together.
+//
+//	"lastSector" -- the last file sector a sequential read used
+//----------------------------------------------------------------------
+
+void
+OpenFile::ReadAhead(int lastSector)
+{
+    int numSectors = divRoundUp(hdr->FileLength(), SectorSize);
+    int i = max(readAheadEnd, lastSector + 1);
+    int end = min(lastSector + 1 + ReadAheadSectors, numSectors);
+    int sector, run = 0, runStart = 0;
+
+    if (readAheadEnd - (lastSector + 1) >= ReadAheadSectors / 2)
+        return;
+    for (; i < end; i++) {
+        sector = hdr->ByteToSector(i * SectorSize);
+        if (run > 0 && sector != runStart + run) {
+            bufferCache->ReadAhead(runStart, run);
+            run = 0;
+        }
+        if (sector >= 0 && run++ == 0)
+            runStart = sector;
+    }
+    if (run > 0)
+        bufferCache->ReadAhead(runStart, run);
+    readAheadEnd = max(readAheadEnd, end);
+}
+
 //----------------------------------------------------------------------
 // OpenFile::Length
 // 	Return the number of bytes in the file.
@@ -69,10 +69,30 @@ private:
 #else // FILESYS
 class FileHeader;
 
+#define ReadAheadSectors	8	// how far ahead of a sequential
+					// reader to read; asked for once
+					// half of it has been used
+
+// The in-memory copy of the header of an open file.  There is one per
+// file, however many times it is open, so that every OpenFile on the
+// file sees the same length and sectors.
+class OpenHeader {
+public:
+    int sector;				// where the header is on disk
+    int refs;				// how many OpenFiles are using it
+    bool removed;			// TRUE once the file is removed
+    bool metadata;			// TRUE for the bitmap and directories,
+    // whose writes are journaled
+    FileHeader *hdr;
+    OpenHeader *next;			// next open file's header
+};
+
 class OpenFile {
 public:
-    OpenFile(int sector);		// Open a file whose header is located
-    // at "sector" on the disk
+    OpenFile(int sector, bool metadata = FALSE);
+    // Open a file whose header is located
+    // at "sector" on the disk; "metadata"
+    // if it is the bitmap or a directory
     ~OpenFile();			// Close the file
 
     void Seek(int position); 		// Set the position from which to
@@ -94,9 +114,23 @@ public:
     // than the UNIX idiom -- lseek to
     // end of file, tell, lseek back
 
+    static bool RemoveWhenClosed(int sector);
+    // If the file with its header at
+    // "sector" is open, put off freeing
+    // it until it's closed
+
 private:
-    FileHeader *hdr;			// Header for this file
+    void ReadAhead(int lastSector);	// Read ahead of a sequential read
+    // that ended in "lastSector"
+
+    OpenHeader *shared;			// Header for this file, shared
+    FileHeader *hdr;			// ... and shared->hdr
+    int hdrSector;			// Where the header is on disk
     int seekPosition;			// Current position within the file
+    int readEnd;			// Where the last read ended
+    int readAheadEnd;			// The file sector after the last one
+    // read ahead
+    int writeEnd;			// Where the last write ended
 };
 
 #endif // FILESYS
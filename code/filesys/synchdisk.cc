@@ -5,10 +5,12 @@
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	Each request has a semaphore, to synchronize the interrupt
+//	handler with the thread waiting for it.  Because the physical
+//	disk can only handle one operation at a time, requests made while
+//	it is busy are queued, and the interrupt handler starts the next
+//	one as each finishes.  The queue is shared with the interrupt
+//	handler, so it is only touched with interrupts off.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation
@@ -16,6 +18,7 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "system.h"
 
 //----------------------------------------------------------------------
 // DiskRequestDone
@@ -38,12 +41,20 @@ DiskRequestDone (int arg)
 //
 //	"name" -- UNIX file name to be used as storage for the disk data
 //	   (usually, "DISK")
+//	"diskPolicy" -- the order to serve queued requests in
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk(char* name)
+SynchDisk::SynchDisk(char* name, DiskPolicy diskPolicy)
 {
-    semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
+    policy = diskPolicy;
+    active = NULL;
+    queue = NULL;
+    headTrack = 0;
+    sweepingUp = TRUE;
+    writesLeft = -1;
+    lost = NULL;
+    isLost = NULL;
+    numLost = 0;
     disk = new Disk(name, DiskRequestDone, (int) this);
 }
 
@@ -56,8 +67,8 @@ SynchDisk::SynchDisk(char* name)
 SynchDisk::~SynchDisk()
 {
     delete disk;
-    delete lock;
-    delete semaphore;
+    delete [] lost;
+    delete [] isLost;
 }
 
 //----------------------------------------------------------------------
@@ -72,10 +83,7 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    ReadSectors(sectorNumber, 1, &data);
 }
 
 //----------------------------------------------------------------------
@@ -90,20 +98,252 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    WriteSectors(sectorNumber, 1, &data);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadSectors
+// 	Read a run of consecutive disk sectors, each into its own buffer,
+//	with one disk request.  Return only after they have all been read.
+//	After a crash, sectors written since then are read from memory.
+//
+//	"firstSector" -- the first disk sector to read
+//	"numSectors" -- how many to read
+//	"data" -- a buffer for each sector
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadSectors(int firstSector, int numSectors, char** data)
+{
+    Request(firstSector, numSectors, data, FALSE);
+    if (writesLeft == 0)
+        for (int i = 0; i < numSectors; i++)
+            if (isLost[firstSector + i])
+                bcopy(&lost[(firstSector + i) * SectorSize], data[i],
+                      SectorSize);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteSectors
+// 	Write a run of consecutive disk sectors, each from its own buffer,
+//	with one disk request.  Return only after they have all been
+//	written.  If the simulated crash comes part way through the run,
+//	only the sectors before it reach the disk.
+//
+//	"firstSector" -- the first disk sector to write
+//	"numSectors" -- how many to write
+//	"data" -- the new contents of each sector
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteSectors(int firstSector, int numSectors, char** data)
+{
+    int numWritten = numSectors;
+
+    if (writesLeft >= 0) {
+        numWritten = min(numSectors, writesLeft);
+        writesLeft -= numWritten;
+    }
+    for (int i = numWritten; i < numSectors; i++) {
+        // crashed: keep it until Restart
+        bcopy(data[i], &lost[(firstSector + i) * SectorSize], SectorSize);
+        isLost[firstSector + i] = TRUE;
+        numLost++;
+    }
+    if (numWritten > 0)
+        Request(firstSector, numWritten, data, TRUE);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::CrashAfter
+// 	Simulate the power failing, as far as the disk is concerned,
+//	after "numWrites" more writes.  Later writes never reach the disk;
+//	they are kept in memory, so that reads still see them, until
+//	Restart, when they are lost.  The system keeps running, so it
+//	needn't be stopped at the moment of the crash.
+//
+//	"numWrites" -- the number of writes to let through
+//----------------------------------------------------------------------
+
+void
+SynchDisk::CrashAfter(int numWrites)
+{
+    if (lost == NULL) {
+        lost = new char[NumSectors * SectorSize];
+        isLost = new bool[NumSectors];
+    }
+    for (int i = 0; i < NumSectors; i++)
+        isLost[i] = FALSE;
+    numLost = 0;
+    writesLeft = numWrites;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Restart
+// 	The power is back: forget the writes since the crash, leaving the
+//	disk as it was when the power failed, and let writes through
+//	again.  Return TRUE if any writes were lost.
+//----------------------------------------------------------------------
+
+bool
+SynchDisk::Restart()
+{
+    bool crashed = (numLost > 0);
+
+    writesLeft = -1;
+    numLost = 0;
+    return crashed;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Request
+// 	Start a request if the disk is free, or else put it at the end of
+//	the queue, and wait until it has been done.
+//
+//	"firstSector" -- the first disk sector to read or write
+//	"numSectors" -- how many consecutive sectors
+//	"data" -- the buffers to read into, or write from
+//	"writing" -- TRUE for a write
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Request(int firstSector, int numSectors, char** data,
+                   bool writing)
+{
+    DiskRequest request;
+    DiskRequest **link;
+    IntStatus oldLevel;
+
+    request.sector = firstSector;
+    request.count = numSectors;
+    request.data = data;
+    request.writing = writing;
+    request.arrival = stats->totalTicks;
+    request.done = new Semaphore("disk request", 0);
+    request.next = NULL;
+
+    oldLevel = interrupt->SetLevel(IntOff);
+    if (active == NULL)
+        Start(&request);
+    else {
+        for (link = &queue; *link != NULL; link = &(*link)->next)
+            ;
+        *link = &request;
+    }
+    (void) interrupt->SetLevel(oldLevel);
+
+    request.done->P();			// wait for interrupt
+    delete request.done;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Start
+// 	Send a request to the disk.  Interrupts must be off.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Start(DiskRequest *request)
+{
+    int track = request->sector / SectorsPerTrack;
+
+    if (policy == DiskSCAN && track != headTrack
+            && (track > headTrack) != sweepingUp)
+        sweepingUp = !sweepingUp;	// nothing further this way
+    headTrack = track;
+    active = request;
+    if (request->writing)
+        disk->WriteRequest(request->sector, request->count, request->data);
+    else
+        disk->ReadRequest(request->sector, request->count, request->data);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ChooseNext
+// 	Take the request that should go next off the queue and return
+//	it, or NULL if there are none.  Interrupts must be off.
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::ChooseNext()
+{
+    DiskRequest **link, **best = NULL;
+    DiskRequest *request;
+
+    for (link = &queue; *link != NULL; link = &(*link)->next)
+        if (best == NULL || Better(*link, *best))
+            best = link;
+    if (best == NULL)
+        return NULL;
+    request = *best;
+    *best = request->next;
+    return request;
+}
+
+//----------------------------------------------------------------------
+// SweepDistance
+// 	How far the head has to travel from "from" to "to", in tracks,
+//	if it keeps going the way it is going.  Tracks behind it, which
+//	it can only reach by turning round (SCAN) or starting again at
+//	the lowest track (C-LOOK), count as further than any ahead.
+//----------------------------------------------------------------------
+
+static int
+SweepDistance(DiskPolicy policy, bool up, int from, int to)
+{
+    int ahead = up ? (to - from) : (from - to);
+
+    if (ahead >= 0)
+        return ahead;
+    if (policy == DiskCLOOK)
+        return NumTracks + to;
+    return NumTracks - ahead;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Better
+// 	Return TRUE if request "a" should be started before request "b",
+//	according to the policy.  Ties go to "b", which was made first.
+//----------------------------------------------------------------------
+
+bool
+SynchDisk::Better(DiskRequest *a, DiskRequest *b)
+{
+    int aDistance, bDistance;
+
+    switch (policy) {
+    case DiskSSTF:
+        return disk->ComputeLatency(a->sector, a->writing, a->count)
+               < disk->ComputeLatency(b->sector, b->writing, b->count);
+    case DiskSCAN:
+    case DiskCLOOK:
+        aDistance = SweepDistance(policy, sweepingUp, headTrack,
+                                  a->sector / SectorsPerTrack);
+        bDistance = SweepDistance(policy, sweepingUp, headTrack,
+                                  b->sector / SectorsPerTrack);
+        if (aDistance != bDistance)
+            return aDistance < bDistance;
+        return disk->ComputeLatency(a->sector, a->writing, a->count)
+               < disk->ComputeLatency(b->sector, b->writing, b->count);
+    default:
+        return FALSE;
+    }
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::RequestDone
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// 	Disk interrupt handler.  Wake up the thread waiting for the disk
+//	request that just finished, and start the next one.
 //----------------------------------------------------------------------
 
 void
 SynchDisk::RequestDone()
 {
-    semaphore->V();
+    DiskRequest *request = active;
+
+    stats->diskRequestTicks += stats->totalTicks - request->arrival;
+    active = NULL;
+    request->done->V();
+    request = ChooseNext();
+    if (request != NULL)
+        Start(request);
 }
@@ -14,6 +14,30 @@
 #include "disk.h"
 #include "synch.h"
 
+// The order in which SynchDisk sends queued requests to the disk.
+//	DiskFCFS -- in the order they were made
+//	DiskSSTF -- whichever the disk can get to soonest: the shortest
+//		seek, and then the shortest rotational delay
+//	DiskSCAN -- the elevator algorithm: the nearest in the direction
+//		the head is moving, turning round when there are none
+//	DiskCLOOK -- the same, but only moving towards higher tracks;
+//		when there are none, jump back to the lowest
+// Among requests on the same track, SCAN and C-LOOK also take the one
+// that will rotate under the head first.
+enum DiskPolicy { DiskFCFS, DiskSSTF, DiskSCAN, DiskCLOOK };
+
+// A read or write waiting for, or being done by, the disk.
+class DiskRequest {
+public:
+    int sector;				// the first sector to read or write
+    int count;				// how many consecutive sectors
+    char **data;			// where to read each to, or write it from
+    bool writing;			// TRUE for a write
+    int arrival;			// when the request was made
+    Semaphore *done;			// V'd when the request is done
+    DiskRequest *next;			// the next request in the queue
+};
+
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
 // requests to read or write portions of the disk return immediately,
@@ -23,31 +47,64 @@
 //
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
-// returning.
+// returning.  Any number of threads can have a request outstanding;
+// while the disk is busy, requests wait in a queue, and each time the
+// disk finishes one, the next is chosen according to the DiskPolicy.
+//
+// A request may be for a run of consecutive sectors, each with its own
+// buffer; the disk does the run for about the cost of one sector, plus
+// the time for the rest to pass under the head.
 class SynchDisk {
 public:
-    SynchDisk(char* name);    		// Initialize a synchronous disk,
+    SynchDisk(char* name, DiskPolicy diskPolicy = DiskFCFS);
+    // Initialize a synchronous disk,
     // by initializing the raw Disk.
     ~SynchDisk();			// De-allocate the synch disk data
 
     void ReadSector(int sectorNumber, char* data);
     // Read/write a disk sector, returning
     // only once the data is actually read
-    // or written.  These call
-    // Disk::ReadRequest/WriteRequest and
-    // then wait until the request is done.
+    // or written.  These queue a request,
+    // and then wait until it is done.
     void WriteSector(int sectorNumber, char* data);
 
+    void ReadSectors(int firstSector, int numSectors, char** data);
+    // Read/write a run of sectors, each
+    // to or from its own buffer, as one
+    // disk request
+    void WriteSectors(int firstSector, int numSectors, char** data);
+
     void RequestDone();			// Called by the disk device interrupt
     // handler, to signal that the
     // current disk operation is complete.
 
+    // For testing recovery from crashes
+    void CrashAfter(int numWrites);	// Let "numWrites" more writes
+    // reach the disk, and then keep the
+    // rest in memory
+    bool Restart();			// Forget the writes kept in memory;
+    // return TRUE if there were any
+
 private:
+    void Request(int firstSector, int numSectors, char** data,
+                 bool writing);
+    // Queue a request, and wait for it
+    void Start(DiskRequest *request);	// Send a request to the disk
+    DiskRequest *ChooseNext();		// Take the next request to start
+    // off the queue
+    bool Better(DiskRequest *a, DiskRequest *b);
+    // Should "a" go before "b"?
+
     Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread
-    // with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-    // can be sent to the disk at a time
+    DiskPolicy policy;			// how to order queued requests
+    DiskRequest *active;		// the request the disk is doing, or NULL
+    DiskRequest *queue;			// requests waiting, oldest first
+    int headTrack;			// track of the last request started
+    bool sweepingUp;			// for SCAN, which way the head moves
+    int writesLeft;			// writes before the crash, or -1
+    char *lost;				// sectors written since the crash
+    bool *isLost;
+    int numLost;
 };
 
 #endif // SYNCHDISK_H
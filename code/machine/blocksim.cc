@@ -0,0 +1,1020 @@
+// blocksim.cc -- run user programs a basic block at a time
+//
+//   An alternative to the one-instruction-at-a-time loop in
+//   Machine::Run, turned on with "-be".  Straight-line runs of
+//   instructions are translated once into arrays of pointers to
+//   handler routines, one per instruction, and from then on are run
+//   by calling the handlers in turn.  A "lui" followed by an "ori",
+//   and a set-on-less-than followed by a "beq" or "bne", are fused
+//   into a single handler.
+//
+//   The results are exactly those of mipssim.cc:
+//
+//	- every handler does what the corresponding case in
+//	  Machine::ExecuteInstruction does, and instructions without a
+//	  handler of their own are simply passed to ExecuteInstruction;
+//
+//	- the delayed load and program counter updates are done after
+//	  each instruction, except in a run of simple register-to-register
+//	  instructions, where the program counters are only set once the
+//	  run ends (see RunBlocks).  Nothing can look at them in between;
+//
+//	- simulated time advances by UserTick per instruction, as
+//	  before, but Interrupt::OneTick is only called after the
+//	  instruction that makes the next pending interrupt due, or one
+//	  that raised an exception.  Until then OneTick would have done
+//	  nothing but advance the clock;
+//
+//	- a block is translated from physical memory and never crosses
+//	  a page, so translating its first instruction's address checks
+//	  (and marks used) the page for all of them.  Writes to a page
+//	  that has been decoded from bump its frameGeneration, which
+//	  makes the translations in it stale.
+//
+//   The engine is only used when nothing would notice the difference
+//   in the order things are done: not when single stepping, and not
+//   with the 'm', 'a' or 'i' debug flags on.
+//
+//   Once a block has run HotThreshold times, it remembers which block
+//   ran after it, if that one starts in the same virtual page.  The
+//   next time the program leaves the block for the same address, the
+//   remembered block is run without translating the address or looking
+//   it up.  This is only done if no kernel code has run in between, so
+//   the page is still mapped and already marked used.
+//
+//   With "-bc", every block run is replayed on a second Machine using
+//   the ordinary interpreter, starting from a copy of the registers,
+//   memory and translations, and Nachos stops with a dump of the
+//   differences if the two disagree.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#include "machine.h"
+#include "mipssim.h"
+#include "system.h"
+
+#define MaxBlockLength	32	// most instructions translated as a block
+#define HotThreshold	16	// runs before a block links to its successor
+
+struct BlockOp;
+
+// A handler runs the instruction(s) at "op" and returns how many it
+// completed, or 0 if the first one raised an exception.
+typedef int (*OpHandler)(Machine *m, BlockOp *op);
+
+// One instruction of a translated block.
+struct BlockOp {
+    OpHandler handler;		// runs this instruction, or this one and
+    // the next if the two have been fused
+    OpHandler single;		// runs just this instruction
+    OpHandler result;		// computes just the result of this
+    // instruction, or NULL; see RunBlocks
+    OpHandler quick;		// "result", or the same for this
+    // instruction and the next if the two have been fused
+    Instruction instr;		// the instruction, decoded
+};
+
+// A translated basic block: the instructions from some address up to
+// and including the delay slot of the first branch or jump, but no
+// further than the end of the page.
+struct Block {
+    int frame;			// physical page the instructions are in
+    unsigned int generation;	// frameGeneration[frame] when translated
+    int length;			// number of instructions
+    int executions;		// times run since translated
+    Block *next;		// the block that ran after this one, once
+    // hot, if it starts in the same page
+    int nextOffset;		// where "next" starts, within the page
+    BlockOp ops[MaxBlockLength];
+};
+
+//----------------------------------------------------------------------
+// Retire
+// 	Finish an instruction that completed: do any delayed load (just
+//	as Machine::DelayedLoad does) and advance the program counters.
+//
+//	"pcAfter" -- the new value of NextPCReg
+//	"loadReg", "loadValue" -- the delayed load this instruction started
+//----------------------------------------------------------------------
+
+static inline void
+Retire(Machine *m, int pcAfter, int loadReg, int loadValue)
+{
+    int *r = m->registers;
+
+    if ((r[LoadReg] | r[LoadValueReg] | loadReg | loadValue) != 0) {
+        r[r[LoadReg]] = r[LoadValueReg];
+        r[LoadReg] = loadReg;
+        r[LoadValueReg] = loadValue;
+    }
+    r[0] = 0;
+    r[PrevPCReg] = r[PCReg];
+    r[PCReg] = r[NextPCReg];
+    r[NextPCReg] = pcAfter;
+}
+
+//----------------------------------------------------------------------
+// Machine::CatchUp
+// 	Set the program counters as the interpreter would have them
+//	after running, one at a time, the instructions up to "pc".  Only
+//	for after a quick handler: the last instruction was the one just
+//	before "pc", not a jump, and left no delayed load.
+//
+//	"pc" -- address of the next instruction to run
+//----------------------------------------------------------------------
+
+inline void
+Machine::CatchUp(int pc)
+{
+    registers[PrevPCReg] = pc - 4;
+    registers[PCReg] = pc;
+    registers[NextPCReg] = pc + 4;
+}
+
+//----------------------------------------------------------------------
+// Instruction handlers
+// 	Each does what the case for its opcode in
+//	Machine::ExecuteInstruction does.
+//
+//	The "Quick" handlers are for instructions that can't raise an
+//	exception, branch or touch memory.  They only compute the result;
+//	RunBlocks advances the program counters for a run of them at
+//	once (see the comment there), and DoQuick does it for one.
+//----------------------------------------------------------------------
+
+static int
+DoGeneric(Machine *m, BlockOp *op)
+{
+    return m->ExecuteInstruction(&op->instr) ? 1 : 0;
+}
+
+static int
+DoQuick(Machine *m, BlockOp *op)
+{
+    (void) (*op->result)(m, op);
+    Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+    return 1;
+}
+
+static int
+QuickNothing(Machine *m, BlockOp *op)
+{
+    return 1;			// the result goes to R0, which stays zero
+}
+
+static inline int
+QuickAddiu(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+
+    r[op->instr.rt] = r[op->instr.rs] + op->instr.extra;
+    return 1;
+}
+
+static inline int
+QuickAddu(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+
+    r[op->instr.rd] = r[op->instr.rs] + r[op->instr.rt];
+    return 1;
+}
+
+static inline int
+QuickSubu(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+
+    r[op->instr.rd] = r[op->instr.rs] - r[op->instr.rt];
+    return 1;
+}
+
+static inline int
+QuickAnd(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+
+    r[op->instr.rd] = r[op->instr.rs] & r[op->instr.rt];
+    return 1;
+}
+
+static inline int
+QuickAndi(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+
+    r[op->instr.rt] = r[op->instr.rs] & (op->instr.extra & 0xffff);
+    return 1;
+}
+
+static inline int
+QuickOr(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+
+    // sic: mipssim.cc ORs "rs" with itself, and we must match it
+    r[op->instr.rd] = r[op->instr.rs] | r[op->instr.rs];
+    return 1;
+}
+
+static inline int
+QuickOri(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+
+    r[op->instr.rt] = r[op->instr.rs] | (op->instr.extra & 0xffff);
+    return 1;
+}
+
+static inline int
+QuickXor(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+
+    r[op->instr.rd] = r[op->instr.rs] ^ r[op->instr.rt];
+    return 1;
+}
+
+static inline int
+QuickXori(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+
+    r[op->instr.rt] = r[op->instr.rs] ^ (op->instr.extra & 0xffff);
+    return 1;
+}
+
+static inline int
+QuickNor(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+
+    r[op->instr.rd] = ~(r[op->instr.rs] | r[op->instr.rt]);
+    return 1;
+}
+
+static inline int
+QuickSll(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+
+    r[op->instr.rd] = r[op->instr.rt] << op->instr.extra;
+    return 1;
+}
+
+static inline int
+QuickSrl(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+    int tmp;
+
+    // sic: shifts a signed int, like mipssim.cc
+    tmp = r[op->instr.rt];
+    tmp >>= op->instr.extra;
+    r[op->instr.rd] = tmp;
+    return 1;
+}
+
+static inline int
+QuickSra(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+
+    r[op->instr.rd] = r[op->instr.rt] >> op->instr.extra;
+    return 1;
+}
+
+static inline int
+QuickSlt(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+
+    r[op->instr.rd] = (r[op->instr.rs] < r[op->instr.rt]) ? 1 : 0;
+    return 1;
+}
+
+static inline int
+QuickSlti(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+
+    r[op->instr.rt] = (r[op->instr.rs] < op->instr.extra) ? 1 : 0;
+    return 1;
+}
+
+static inline int
+QuickSltu(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+    unsigned int rs = r[op->instr.rs];
+    unsigned int rt = r[op->instr.rt];
+
+    r[op->instr.rd] = (rs < rt) ? 1 : 0;
+    return 1;
+}
+
+static inline int
+QuickSltiu(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+    unsigned int rs = r[op->instr.rs];
+    unsigned int imm = op->instr.extra;
+
+    r[op->instr.rt] = (rs < imm) ? 1 : 0;
+    return 1;
+}
+
+static inline int
+QuickLui(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+
+    r[op->instr.rt] = op->instr.extra << 16;
+    return 1;
+}
+
+static inline int
+QuickMfhi(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+
+    r[op->instr.rd] = r[HiReg];
+    return 1;
+}
+
+static inline int
+QuickMflo(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+
+    r[op->instr.rd] = r[LoReg];
+    return 1;
+}
+
+static inline int
+DoBeq(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+    int pcAfter = r[NextPCReg] + 4;
+
+    if (r[op->instr.rs] == r[op->instr.rt])
+        pcAfter = r[NextPCReg] + IndexToAddr(op->instr.extra);
+    Retire(m, pcAfter, 0, 0);
+    return 1;
+}
+
+static inline int
+DoBne(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+    int pcAfter = r[NextPCReg] + 4;
+
+    if (r[op->instr.rs] != r[op->instr.rt])
+        pcAfter = r[NextPCReg] + IndexToAddr(op->instr.extra);
+    Retire(m, pcAfter, 0, 0);
+    return 1;
+}
+
+static inline int
+DoBlez(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+    int pcAfter = r[NextPCReg] + 4;
+
+    if (r[op->instr.rs] <= 0)
+        pcAfter = r[NextPCReg] + IndexToAddr(op->instr.extra);
+    Retire(m, pcAfter, 0, 0);
+    return 1;
+}
+
+static inline int
+DoBgtz(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+    int pcAfter = r[NextPCReg] + 4;
+
+    if (r[op->instr.rs] > 0)
+        pcAfter = r[NextPCReg] + IndexToAddr(op->instr.extra);
+    Retire(m, pcAfter, 0, 0);
+    return 1;
+}
+
+static inline int
+DoBltz(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+    int pcAfter = r[NextPCReg] + 4;
+
+    if (r[op->instr.rs] & SIGN_BIT)
+        pcAfter = r[NextPCReg] + IndexToAddr(op->instr.extra);
+    Retire(m, pcAfter, 0, 0);
+    return 1;
+}
+
+static inline int
+DoBgez(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+    int pcAfter = r[NextPCReg] + 4;
+
+    if (!(r[op->instr.rs] & SIGN_BIT))
+        pcAfter = r[NextPCReg] + IndexToAddr(op->instr.extra);
+    Retire(m, pcAfter, 0, 0);
+    return 1;
+}
+
+static int
+DoJ(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+    int pcAfter = r[NextPCReg] + 4;
+
+    pcAfter = (pcAfter & 0xf0000000) | IndexToAddr(op->instr.extra);
+    Retire(m, pcAfter, 0, 0);
+    return 1;
+}
+
+static int
+DoJal(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+    int pcAfter = r[NextPCReg] + 4;
+
+    r[R31] = r[NextPCReg] + 4;
+    pcAfter = (pcAfter & 0xf0000000) | IndexToAddr(op->instr.extra);
+    Retire(m, pcAfter, 0, 0);
+    return 1;
+}
+
+static int
+DoJr(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+
+    Retire(m, r[op->instr.rs], 0, 0);
+    return 1;
+}
+
+static int
+DoLw(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+    int pcAfter = r[NextPCReg] + 4;
+    int tmp = r[op->instr.rs] + op->instr.extra;
+    int value;
+
+    if (tmp & 0x3) {
+        m->RaiseException(AddressErrorException, tmp);
+        return 0;
+    }
+    if (!m->ReadMem(tmp, 4, &value))
+        return 0;
+    Retire(m, pcAfter, op->instr.rt, value);
+    return 1;
+}
+
+static int
+DoLb(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+    int pcAfter = r[NextPCReg] + 4;
+    int tmp = r[op->instr.rs] + op->instr.extra;
+    int value;
+
+    if (!m->ReadMem(tmp, 1, &value))
+        return 0;
+    if ((value & 0x80) && (op->instr.opCode == OP_LB))
+        value |= 0xffffff00;
+    else
+        value &= 0xff;
+    Retire(m, pcAfter, op->instr.rt, value);
+    return 1;
+}
+
+static int
+DoSw(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+    int pcAfter = r[NextPCReg] + 4;
+
+    if (!m->WriteMem((unsigned) (r[op->instr.rs] + op->instr.extra), 4,
+                     r[op->instr.rt]))
+        return 0;
+    Retire(m, pcAfter, 0, 0);
+    return 1;
+}
+
+static int
+DoSb(Machine *m, BlockOp *op)
+{
+    int *r = m->registers;
+    int pcAfter = r[NextPCReg] + 4;
+
+    if (!m->WriteMem((unsigned) (r[op->instr.rs] + op->instr.extra), 1,
+                     r[op->instr.rt]))
+        return 0;
+    Retire(m, pcAfter, 0, 0);
+    return 1;
+}
+
+//----------------------------------------------------------------------
+// Fused handlers
+// 	Run a pair of instructions that commonly appear together, one
+//	after the other, with a single dispatch.  Neither instruction of
+//	any of these pairs can raise an exception.  A "lui" and "ori" pair
+//	also has a quick handler.
+//----------------------------------------------------------------------
+
+static int
+DoLuiOri(Machine *m, BlockOp *op)
+{
+    QuickLui(m, op);
+    Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+    QuickOri(m, op + 1);
+    Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+    return 2;
+}
+
+static int
+QuickLuiOri(Machine *m, BlockOp *op)
+{
+    QuickLui(m, op);
+    QuickOri(m, op + 1);
+    return 2;
+}
+
+static int
+DoSltBeq(Machine *m, BlockOp *op)
+{
+    QuickSlt(m, op);
+    Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+    return 1 + DoBeq(m, op + 1);
+}
+
+static int
+DoSltBne(Machine *m, BlockOp *op)
+{
+    QuickSlt(m, op);
+    Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+    return 1 + DoBne(m, op + 1);
+}
+
+static int
+DoSltiBeq(Machine *m, BlockOp *op)
+{
+    QuickSlti(m, op);
+    Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+    return 1 + DoBeq(m, op + 1);
+}
+
+static int
+DoSltiBne(Machine *m, BlockOp *op)
+{
+    QuickSlti(m, op);
+    Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+    return 1 + DoBne(m, op + 1);
+}
+
+static int
+DoSltuBeq(Machine *m, BlockOp *op)
+{
+    QuickSltu(m, op);
+    Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+    return 1 + DoBeq(m, op + 1);
+}
+
+static int
+DoSltuBne(Machine *m, BlockOp *op)
+{
+    QuickSltu(m, op);
+    Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+    return 1 + DoBne(m, op + 1);
+}
+
+static int
+DoSltiuBeq(Machine *m, BlockOp *op)
+{
+    QuickSltiu(m, op);
+    Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+    return 1 + DoBeq(m, op + 1);
+}
+
+static int
+DoSltiuBne(Machine *m, BlockOp *op)
+{
+    QuickSltiu(m, op);
+    Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+    return 1 + DoBne(m, op + 1);
+}
+
+//----------------------------------------------------------------------
+// QuickHandlerFor
+// 	Return the quick handler for "instr", or NULL if it doesn't have
+//	one.
+//----------------------------------------------------------------------
+
+static OpHandler
+QuickHandlerFor(Instruction *instr)
+{
+    OpHandler quick;
+    int dest = instr->rd;
+
+    switch (instr->opCode) {
+    case OP_ADDIU:	quick = QuickAddiu; dest = instr->rt; break;
+    case OP_ADDU:	quick = QuickAddu; break;
+    case OP_SUBU:	quick = QuickSubu; break;
+    case OP_AND:	quick = QuickAnd; break;
+    case OP_ANDI:	quick = QuickAndi; dest = instr->rt; break;
+    case OP_OR:		quick = QuickOr; break;
+    case OP_ORI:	quick = QuickOri; dest = instr->rt; break;
+    case OP_XOR:	quick = QuickXor; break;
+    case OP_XORI:	quick = QuickXori; dest = instr->rt; break;
+    case OP_NOR:	quick = QuickNor; break;
+    case OP_SLL:	quick = QuickSll; break;
+    case OP_SRL:	quick = QuickSrl; break;
+    case OP_SRA:	quick = QuickSra; break;
+    case OP_SLT:	quick = QuickSlt; break;
+    case OP_SLTI:	quick = QuickSlti; dest = instr->rt; break;
+    case OP_SLTU:	quick = QuickSltu; break;
+    case OP_SLTIU:	quick = QuickSltiu; dest = instr->rt; break;
+    case OP_LUI:	quick = QuickLui; dest = instr->rt; break;
+    case OP_MFHI:	quick = QuickMfhi; break;
+    case OP_MFLO:	quick = QuickMflo; break;
+    default:		return NULL;
+    }
+    return (dest == 0) ? QuickNothing : quick;
+}
+
+//----------------------------------------------------------------------
+// HandlerFor
+// 	Return the handler that runs a single instruction with opcode
+//	"opCode".
+//----------------------------------------------------------------------
+
+static OpHandler
+HandlerFor(int opCode)
+{
+    switch (opCode) {
+    case OP_BEQ:	return DoBeq;
+    case OP_BNE:	return DoBne;
+    case OP_BLEZ:	return DoBlez;
+    case OP_BGTZ:	return DoBgtz;
+    case OP_BLTZ:	return DoBltz;
+    case OP_BGEZ:	return DoBgez;
+    case OP_J:		return DoJ;
+    case OP_JAL:	return DoJal;
+    case OP_JR:		return DoJr;
+    case OP_LW:		return DoLw;
+    case OP_LB:
+    case OP_LBU:	return DoLb;
+    case OP_SW:		return DoSw;
+    case OP_SB:		return DoSb;
+    default:		return DoGeneric;
+    }
+}
+
+//----------------------------------------------------------------------
+// FusedHandlerFor
+// 	Return the handler that runs "first" and "second" together, or
+//	NULL if that pair isn't one we fuse.
+//----------------------------------------------------------------------
+
+static OpHandler
+FusedHandlerFor(Instruction *first, Instruction *second)
+{
+    bool beq = (second->opCode == OP_BEQ);
+    bool bne = (second->opCode == OP_BNE);
+
+    switch (first->opCode) {
+    case OP_LUI:
+        return (second->opCode == OP_ORI) ? DoLuiOri : NULL;
+    case OP_SLT:
+        return beq ? DoSltBeq : (bne ? DoSltBne : NULL);
+    case OP_SLTI:
+        return beq ? DoSltiBeq : (bne ? DoSltiBne : NULL);
+    case OP_SLTU:
+        return beq ? DoSltuBeq : (bne ? DoSltuBne : NULL);
+    case OP_SLTIU:
+        return beq ? DoSltiuBeq : (bne ? DoSltiuBne : NULL);
+    default:
+        return NULL;
+    }
+}
+
+//----------------------------------------------------------------------
+// IsControlTransfer
+// 	Return TRUE if the instruction may change the flow of control
+//	after its delay slot.
+//----------------------------------------------------------------------
+
+static bool
+IsControlTransfer(int opCode)
+{
+    switch (opCode) {
+    case OP_BEQ: case OP_BNE: case OP_BLEZ: case OP_BGTZ:
+    case OP_BLTZ: case OP_BGEZ: case OP_BLTZAL: case OP_BGEZAL:
+    case OP_J: case OP_JAL: case OP_JR: case OP_JALR:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::BuildBlock
+// 	Translate the instructions starting at "physicalAddress" into a
+//	block, reusing the old translation's storage if there is one.
+//
+//	"physicalAddress" -- word-aligned offset into mainMemory
+//----------------------------------------------------------------------
+
+Block *
+Machine::BuildBlock(int physicalAddress)
+{
+    Block *block = blocks[physicalAddress / 4];
+    int frame = physicalAddress / PageSize;
+    int end = (frame + 1) * PageSize;
+    bool inDelaySlot = FALSE;
+    BlockOp *op;
+    OpHandler fused;
+
+    if (block == NULL)
+        block = blocks[physicalAddress / 4] = new Block;
+    block->frame = frame;
+    block->generation = frameGeneration[frame];
+    block->length = 0;
+    block->executions = 0;
+    block->next = NULL;
+    stats->numBlocksBuilt++;
+
+    for (int addr = physicalAddress; addr < end; addr += 4) {
+        op = &block->ops[block->length++];
+        op->instr = *DecodeWord(addr);
+        op->result = op->quick = QuickHandlerFor(&op->instr);
+        if (op->result != NULL)
+            op->single = DoQuick;
+        else
+            op->single = HandlerFor(op->instr.opCode);
+        op->handler = op->single;
+
+        if (inDelaySlot || block->length == MaxBlockLength
+                || op->instr.opCode == OP_SYSCALL)
+            break;
+        inDelaySlot = IsControlTransfer(op->instr.opCode);
+    }
+
+    for (int i = 0; i + 1 < block->length; i++) {
+        op = &block->ops[i];
+        fused = FusedHandlerFor(&op->instr, &(op + 1)->instr);
+        if (fused != NULL)
+            op->handler = fused;
+        if (fused == DoLuiOri && op->result == QuickLui
+                && (op + 1)->result == QuickOri)
+            op->quick = QuickLuiOri;
+    }
+    return block;
+}
+
+//----------------------------------------------------------------------
+// Machine::FreeBlocks
+// 	De-allocate every translated block.
+//----------------------------------------------------------------------
+
+void
+Machine::FreeBlocks()
+{
+    for (int i = 0; i < memorySize / 4; i++) {
+        delete blocks[i];
+        blocks[i] = NULL;
+    }
+    delete [] blocks;
+}
+
+//----------------------------------------------------------------------
+// Machine::ShadowState
+// 	Make the shadow machine's registers, memory and address
+//	translation the same as ours, before running a block, so that
+//	CheckBlock can replay it.
+//----------------------------------------------------------------------
+
+void
+Machine::ShadowState()
+{
+    int i;
+
+    if (shadow == NULL) {
+        shadow = new Machine(FALSE, numPhysPages, tlbSize);
+        shadow->useDecodeCache = FALSE;
+        shadow->trapToKernel = FALSE;
+    }
+    for (i = 0; i < NumTotalRegs; i++)
+        shadow->registers[i] = registers[i];
+    bcopy(mainMemory, shadow->mainMemory, memorySize);
+    if (tlb != NULL) {
+        for (i = 0; i < tlbSize; i++)
+            shadow->tlb[i] = tlb[i];
+    } else {
+        if (shadow->pageTable == NULL || shadow->pageTableSize != pageTableSize) {
+            delete [] shadow->pageTable;
+            shadow->pageTable = new TranslationEntry[pageTableSize];
+            shadow->pageTableSize = pageTableSize;
+        }
+        for (i = 0; i < (int) pageTableSize; i++)
+            shadow->pageTable[i] = pageTable[i];
+    }
+    shadow->FlushTranslations();
+    shadow->lastException = NoException;
+}
+
+//----------------------------------------------------------------------
+// Machine::CheckBlock
+// 	Run "count" instructions on the shadow machine, one at a time,
+//	and compare the result with what the block engine did.  Print
+//	every difference and stop if there are any.
+//
+//	"count" -- number of instructions the block engine just completed
+//----------------------------------------------------------------------
+
+void
+Machine::CheckBlock(int count)
+{
+    Instruction instr;
+    TranslationEntry *ours, *theirs;
+    int i, entries, differences = 0;
+
+    for (i = 0; i < count && shadow->lastException == NoException; i++)
+        shadow->OneInstruction(&instr);
+    stats->numBlocksChecked++;
+
+    if (shadow->lastException != NoException) {
+        printf("interpreter raised exception %d\n", shadow->lastException);
+        differences++;
+    }
+    for (i = 0; i < NumTotalRegs; i++)
+        if (registers[i] != shadow->registers[i]) {
+            printf("register %d: 0x%x, interpreter 0x%x\n", i, registers[i],
+                   shadow->registers[i]);
+            differences++;
+        }
+    for (i = 0; i < memorySize; i++)
+        if (mainMemory[i] != shadow->mainMemory[i]) {
+            printf("memory 0x%x: 0x%x, interpreter 0x%x\n", i,
+                   mainMemory[i] & 0xff, shadow->mainMemory[i] & 0xff);
+            differences++;
+        }
+    ours = (tlb != NULL) ? tlb : pageTable;
+    theirs = (tlb != NULL) ? shadow->tlb : shadow->pageTable;
+    entries = (tlb != NULL) ? tlbSize : pageTableSize;
+    for (i = 0; i < entries; i++)
+        if (ours[i].use != theirs[i].use || ours[i].dirty != theirs[i].dirty) {
+            printf("translation %d: use %d dirty %d, interpreter use %d dirty %d\n",
+                   i, ours[i].use, ours[i].dirty, theirs[i].use, theirs[i].dirty);
+            differences++;
+        }
+
+    if (differences > 0) {
+        printf("Block engine and interpreter differ after %d instructions\n",
+               count);
+        fflush(stdout);
+        ASSERT(FALSE);
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::RunBlocks
+// 	Simulate the execution of a user-level program, a block at a
+//	time.  Called by Run() in place of its own loop; never returns.
+//
+//	Anything that might run kernel code -- an exception, or calling
+//	OneTick -- may switch to another thread, which may re-translate
+//	the block we were running, or change the page table.  So after
+//	either we go back to the top of the loop and look everything up
+//	again, without going through the block we were running.
+//
+//	Most instructions in a block need nothing from the registers but
+//	their operands: not in a delay slot, no delayed load waiting to
+//	finish after them.  We keep track of that here ("behind"), and
+//	run such instructions with their quick handlers, which don't
+//	touch the program counters or the delayed load registers.  Those
+//	are brought up to date ("Catch up") only before an instruction
+//	that needs them, or might raise an exception, and before we
+//	leave the block, so the kernel and the shadow machine always see
+//	exactly the registers the interpreter would have left.
+//----------------------------------------------------------------------
+
+void
+Machine::RunBlocks()
+{
+    int pc, physicalAddress, left, done, i;
+    int lastPC = 0;
+    bool behind;		// TRUE if the program counters haven't
+				// been advanced past the quick handlers
+				// run since the last ordinary one
+    ExceptionType exception;
+    Block *block, *last = NULL;
+    BlockOp *op;
+
+    for (;;) {
+        // how many instructions can run before one of them makes the
+        // next interrupt due, and has to be followed by OneTick
+        left = (interrupt->TicksUntilDue() - 1) / UserTick;
+        if (left < 0)
+            left = 0;
+
+        pc = registers[PCReg];
+        if (last != NULL && (pc & 3) == 0
+                && (unsigned) pc / PageSize == (unsigned) lastPC / PageSize) {
+            // still in the page "last" was in, and no kernel code has
+            // run since we translated its address
+            physicalAddress = last->frame * PageSize + pc % PageSize;
+            if (last->next != NULL && last->nextOffset == pc % PageSize) {
+                block = last->next;
+                stats->numBlocksChained++;
+            } else
+                block = blocks[physicalAddress / 4];
+        } else {
+            exception = Translate(pc, &physicalAddress, 4, FALSE);
+            if (exception != NoException) {
+                RaiseException(exception, pc);
+                interrupt->OneTick();
+                last = NULL;
+                continue;
+            }
+            block = blocks[physicalAddress / 4];
+        }
+        if (block == NULL || block->generation != frameGeneration[block->frame])
+            block = BuildBlock(physicalAddress);
+
+        if (last != NULL && last->executions >= HotThreshold) {
+            last->next = block;
+            last->nextOffset = pc % PageSize;
+        }
+        last = block;
+        lastPC = pc;
+        block->executions++;
+        stats->numBlocksRun++;
+        if (checkBlocks)
+            ShadowState();
+
+        behind = FALSE;
+        for (i = 0; i < block->length; i += done) {
+            op = &block->ops[i];
+            // a quick handler needs no delayed load to be waiting, and
+            // not to be in the delay slot of a jump; both hold once
+            // we're behind.  Allowing for a fused pair, it also needs
+            // time for two instructions before the next interrupt.
+            if (op->quick != NULL && left >= 2
+                    && (behind || (registers[LoadReg] == 0
+                                   && registers[LoadValueReg] == 0
+                                   && registers[NextPCReg]
+                                      == registers[PCReg] + 4))) {
+                done = (*op->quick)(this, op);
+                behind = TRUE;
+                stats->totalTicks += done * UserTick;
+                stats->userTicks += done * UserTick;
+                left -= done;
+                continue;
+            }
+            if (behind) {
+                CatchUp(pc + 4 * i);
+                behind = FALSE;
+            }
+            if (left == 0) {		// an interrupt is due after this one
+                (void) (*op->single)(this, op);
+                interrupt->OneTick();
+                last = NULL;
+                break;
+            }
+            // a fused pair can only run if there is time for both, and
+            // the first isn't in the delay slot of a jump from elsewhere
+            if (left < 2 || registers[NextPCReg] != registers[PCReg] + 4)
+                done = (*op->single)(this, op);
+            else
+                done = (*op->handler)(this, op);
+            if (done == 0) {		// exception, as handled by the kernel
+                interrupt->OneTick();
+                last = NULL;
+                break;
+            }
+
+            stats->totalTicks += done * UserTick;
+            stats->userTicks += done * UserTick;
+            left -= done;
+
+            // stop if we branched away, or the block was written over
+            if (registers[PCReg] != pc + 4 * (i + done)
+                    || block->generation != frameGeneration[block->frame]) {
+                i += done;
+                break;
+            }
+        }
+        if (behind)
+            CatchUp(pc + 4 * i);
+        if (checkBlocks && last != NULL)
+            CheckBlock(i);
+    }
+}
@@ -117,40 +117,72 @@ PrintSector (bool writing, int sector, char *data)
 void
 Disk::ReadRequest(int sectorNumber, char* data)
 {
-    int ticks = ComputeLatency(sectorNumber, FALSE);
+    ReadRequest(sectorNumber, 1, &data);
+}
+
+void
+Disk::WriteRequest(int sectorNumber, char* data)
+{
+    WriteRequest(sectorNumber, 1, &data);
+}
+
+//----------------------------------------------------------------------
+// Disk::ReadRequest/WriteRequest
+// 	Simulate a request to read/write a run of consecutive disk
+//	sectors, scattering them into (or gathering them from) a buffer
+//	for each.  The UNIX file is read or written with one system call,
+//	and there is one interrupt, when the whole run is done.
+//
+//	"firstSector" -- the first disk sector to read/write
+//	"numSectors" -- how many sectors to read/write
+//	"data" -- a buffer for each sector
+//----------------------------------------------------------------------
+
+void
+Disk::ReadRequest(int firstSector, int numSectors, char** data)
+{
+    int ticks = ComputeLatency(firstSector, FALSE, numSectors);
 
     ASSERT(!active);				// only one request at a time
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((firstSector >= 0) && (numSectors > 0)
+           && (firstSector + numSectors <= NumSectors));
 
-    DEBUG('d', "Reading from sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    Read(fileno, data, SectorSize);
+    DEBUG('d', "Reading %d sectors from sector %d\n", numSectors,
+          firstSector);
+    ReadVector(fileno, data, numSectors, SectorSize,
+               SectorSize * firstSector + MagicSize);
     if (DebugIsEnabled('d'))
-        PrintSector(FALSE, sectorNumber, data);
+        for (int i = 0; i < numSectors; i++)
+            PrintSector(FALSE, firstSector + i, data[i]);
 
     active = TRUE;
-    UpdateLast(sectorNumber);
+    UpdateLast(firstSector + numSectors - 1);
     stats->numDiskReads++;
+    stats->numDiskSectorsRead += numSectors;
     interrupt->Schedule(DiskDone, (int) this, ticks, DiskInt);
 }
 
 void
-Disk::WriteRequest(int sectorNumber, char* data)
+Disk::WriteRequest(int firstSector, int numSectors, char** data)
 {
-    int ticks = ComputeLatency(sectorNumber, TRUE);
+    int ticks = ComputeLatency(firstSector, TRUE, numSectors);
 
     ASSERT(!active);
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((firstSector >= 0) && (numSectors > 0)
+           && (firstSector + numSectors <= NumSectors));
 
-    DEBUG('d', "Writing to sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    WriteFile(fileno, data, SectorSize);
+    DEBUG('d', "Writing %d sectors to sector %d\n", numSectors,
+          firstSector);
+    WriteVector(fileno, data, numSectors, SectorSize,
+                SectorSize * firstSector + MagicSize);
     if (DebugIsEnabled('d'))
-        PrintSector(TRUE, sectorNumber, data);
+        for (int i = 0; i < numSectors; i++)
+            PrintSector(TRUE, firstSector + i, data[i]);
 
     active = TRUE;
-    UpdateLast(sectorNumber);
+    UpdateLast(firstSector + numSectors - 1);
     stats->numDiskWrites++;
+    stats->numDiskSectorsWritten += numSectors;
     interrupt->Schedule(DiskDone, (int) this, ticks, DiskInt);
 }
 
@@ -212,8 +244,8 @@ Disk::ModuloDiff(int to, int from)
 
 //----------------------------------------------------------------------
 // Disk::ComputeLatency()
-// 	Return how long will it take to read/write a disk sector, from
-//	the current position of the disk head.
+// 	Return how long will it take to read/write a run of disk sectors,
+//	from the current position of the disk head.
 //
 //   	Latency = seek time + rotational latency + transfer time
 //   	Disk seeks at one track per SeekTime ticks (cf. stats.h)
@@ -222,36 +254,47 @@ Disk::ModuloDiff(int to, int from)
 //   	To find the rotational latency, we first must figure out where the
 //   	disk head will be after the seek (if any).  We then figure out
 //   	how long it will take to rotate completely past newSector after
-//	that point.
+//	that point.  Each further sector in the run takes another
+//	RotationTime, and each track boundary it crosses another SeekTime.
 //
 //   	The disk also has a "track buffer"; the disk continuously reads
 //   	the contents of the current disk track into the buffer.  This allows
 //   	read requests to the current track to be satisfied more quickly.
 //   	The contents of the track buffer are discarded after every seek to
 //   	a new track.
+//
+//	"newSector" -- the first sector of the request
+//	"writing" -- TRUE for a write
+//	"numSectors" -- the length of the run
 //----------------------------------------------------------------------
 
 int
-Disk::ComputeLatency(int newSector, bool writing)
+Disk::ComputeLatency(int newSector, bool writing, int numSectors)
 {
     int rotation;
     int seek = TimeToSeek(newSector, &rotation);
     int timeAfter = stats->totalTicks + seek + rotation;
+    int endSector = newSector + numSectors - 1;
+    int tracks = endSector / SectorsPerTrack - newSector / SectorsPerTrack;
+    int transfer = numSectors * RotationTime + tracks * SeekTime;
 
 #ifndef NOTRACKBUF	// turn this on if you don't want the track buffer stuff
-    // check if track buffer applies
-    if ((writing == FALSE) && (seek == 0)
+    // check if track buffer applies, to every sector of the run
+    int bufferStart = bufferInit / RotationTime;
+    if ((writing == FALSE) && (seek == 0) && (tracks == 0)
+            && (ModuloDiff(newSector, bufferStart)
+                <= ModuloDiff(endSector, bufferStart))
             && (((timeAfter - bufferInit) / RotationTime)
-                > ModuloDiff(newSector, bufferInit / RotationTime))) {
-        DEBUG('d', "Request latency = %d\n", RotationTime);
-        return RotationTime; // time to transfer sector from the track buffer
+                > ModuloDiff(endSector, bufferStart))) {
+        DEBUG('d', "Request latency = %d\n", transfer);
+        return transfer; // time to transfer sectors from the track buffer
     }
 #endif
 
     rotation += ModuloDiff(newSector, timeAfter / RotationTime) * RotationTime;
 
-    DEBUG('d', "Request latency = %d\n", seek + rotation + RotationTime);
-    return(seek + rotation + RotationTime);
+    DEBUG('d', "Request latency = %d\n", seek + rotation + transfer);
+    return(seek + rotation + transfer);
 }
 
 //----------------------------------------------------------------------
@@ -45,6 +45,12 @@
 // disks these days now come with a track buffer.
 //
 // The track buffer simulation can be disabled by compiling with -DNOTRACKBUF
+//
+// A request may also read or write a run of consecutive sectors.  It
+// pays for one seek and rotational delay, and then for each sector
+// passing under the head; a run onto the next track also pays for the
+// seek to it.  (The sectors are assumed to be skewed from one track to
+// the next by just enough that the head arrives in time for the first.)
 
 #define SectorSize 		128	// number of bytes per disk sector
 #define SectorsPerTrack 	32	// number of sectors per disk track 
@@ -67,10 +73,16 @@ public:
     // Only one request allowed at a time!
     void WriteRequest(int sectorNumber, char* data);
 
+    void ReadRequest(int firstSector, int numSectors, char** data);
+    // Read/write "numSectors" consecutive
+    // sectors, each to or from its own
+    // buffer, as one request
+    void WriteRequest(int firstSector, int numSectors, char** data);
+
     void HandleInterrupt();		// Interrupt handler, invoked when
     // disk request finishes.
 
-    int ComputeLatency(int newSector, bool writing);
+    int ComputeLatency(int newSector, bool writing, int numSectors = 1);
     // Return how long a request to
     // newSector will take:
     // (seek + rotational delay + transfer)
@@ -28,7 +28,8 @@
 
 static char *intLevelNames[] = { "off", "on"};
 static char *intTypeNames[] = { "timer", "disk", "console write",
-                                "console read", "network send", "network recv"
+                                "console read", "network send", "network recv",
+                                "checkpoint", "cache flush"
                               };
 
 //----------------------------------------------------------------------
@@ -65,6 +66,7 @@ Interrupt::Interrupt()
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
+    interrupted = SystemMode;
 }
 
 //----------------------------------------------------------------------
@@ -179,6 +181,87 @@ Interrupt::OneTick()
     }
 }
 
+//----------------------------------------------------------------------
+// Interrupt::TicksUntilDue
+// 	Return how far in the future (in simulated time) the next pending
+//	interrupt is due.  Until then, OneTick does nothing but advance the
+//	clock, so a caller that advances the clock itself can skip it.
+//	Only interrupt handlers and kernel code can schedule an earlier
+//	interrupt, so the answer holds until one of those runs.
+//
+//	If there are no pending interrupts, returns a very large number.
+//----------------------------------------------------------------------
+
+int
+Interrupt::TicksUntilDue()
+{
+    int when;
+
+    if (pending->SortedPeek(&when) == NULL)
+        return 0x7fffffff;
+    return when - stats->totalTicks;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Pending
+// 	Return how many interrupts are scheduled, and put the type and
+//	due time of each, soonest first, in "types" and "whens" (up to
+//	"max" of them).  The handlers aren't returned: they are host
+//	addresses, only meaningful to this run of Nachos.
+//----------------------------------------------------------------------
+
+int
+Interrupt::Pending(IntType *types, int *whens, int max)
+{
+    List *kept = new List();
+    PendingInterrupt *toOccur;
+    int when, count = 0;
+
+    while ((toOccur = (PendingInterrupt *) pending->SortedRemove(&when))
+            != NULL) {
+        if (count < max) {
+            types[count] = toOccur->type;
+            whens[count] = when;
+        }
+        count++;
+        kept->SortedInsert(toOccur, when);
+    }
+    delete pending;
+    pending = kept;
+    return count;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Reschedule
+// 	Move the soonest pending interrupt of type "type" to time "when",
+//	so that a device started afresh interrupts when it did in the run
+//	a checkpoint was taken from.  The simulated devices only keep one
+//	interrupt pending at a time while no thread is waiting on them.
+//
+//	Returns FALSE if no interrupt of that type is pending.
+//----------------------------------------------------------------------
+
+bool
+Interrupt::Reschedule(IntType type, int when)
+{
+    List *kept = new List();
+    PendingInterrupt *toOccur;
+    int due;
+    bool found = FALSE;
+
+    while ((toOccur = (PendingInterrupt *) pending->SortedRemove(&due))
+            != NULL) {
+        if (!found && toOccur->type == type) {
+            toOccur->when = due = when;
+            found = TRUE;
+        }
+        kept->SortedInsert(toOccur, due);
+    }
+    delete pending;
+    pending = kept;
+    return found;
+}
+
 //----------------------------------------------------------------------
 // Interrupt::YieldOnReturn
 // 	Called from within an interrupt handler, to cause a context switch
@@ -313,7 +396,8 @@ Interrupt::CheckIfDue(bool advanceClock)
     }
 
 // Check if there is nothing more to do, and if so, quit
-    if ((status == IdleMode) && (toOccur->type == TimerInt)
+    if ((status == IdleMode) && (toOccur->type == TimerInt
+                                 || toOccur->type == CheckpointInt)
             && pending->IsEmpty()) {
         pending->SortedInsert(toOccur, when);
         return FALSE;
@@ -326,6 +410,7 @@ Interrupt::CheckIfDue(bool advanceClock)
         machine->DelayedLoad(0, 0);
 #endif
     inHandler = TRUE;
+    interrupted = old;
     status = SystemMode;			// whatever we were doing,
     // we are now going to be
     // running in the kernel
@@ -48,9 +48,12 @@ enum MachineStatus {IdleMode, SystemMode, UserMode};
 
 // IntType records which hardware device generated an interrupt.
 // In Nachos, we support a hardware timer device, a disk, a console
-// display and keyboard, and a network.
+// display and keyboard, and a network.  CheckpointInt isn't a device;
+// it is when "-ck" snapshots the machine (see userprog/checkpoint.cc).
+// Nor is CacheFlushInt: it is when the buffer cache's dirty sectors are
+// due to be written back (see filesys/bufcache.cc).
 enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt,
-               NetworkSendInt, NetworkRecvInt
+               NetworkSendInt, NetworkRecvInt, CheckpointInt, CacheFlushInt
              };
 
 // The following class defines an interrupt that is scheduled
@@ -107,6 +110,10 @@ public:
 
     void DumpState();			// Print interrupt state
 
+    MachineStatus getInterruptedStatus() {
+        return interrupted;	// what the CPU was doing when
+    }				// the running handler was called
+
 
     // NOTE: the following are internal to the hardware simulation code.
     // DO NOT call these directly.  I should make them "private",
@@ -119,6 +126,18 @@ public:
 
     void OneTick();       		// Advance simulated time
 
+    int TicksUntilDue();		// Simulated time until the next
+    // pending interrupt is due, so that the
+    // CPU simulation knows how long it can
+    // run without calling OneTick
+
+    int Pending(IntType *types, int *whens, int max);
+    // List the interrupts scheduled, for
+    // a checkpoint of the machine
+    bool Reschedule(IntType type, int when);
+    // Move the pending interrupt of "type"
+    // to time "when", on restoring one
+
 private:
     IntStatus level;		// are interrupts enabled or disabled?
     List *pending;		// the list of interrupts scheduled
@@ -127,6 +146,7 @@ private:
     bool yieldOnReturn; 	// TRUE if we are to context switch
     // on return from the interrupt handler
     MachineStatus status;	// idle, kernel mode, user mode
+    MachineStatus interrupted;	// status before the current handler ran
 
     // these functions are internal to the interrupt simulation code
 
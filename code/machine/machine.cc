@@ -9,6 +9,7 @@
 
 #include "copyright.h"
 #include "machine.h"
+#include "memtrace.h"
 #include "system.h"
 
 // Textual names of the exceptions that can be generated by user program
@@ -51,20 +52,48 @@ void CheckEndian()
 //
 //	"debug" -- if TRUE, drop into the debugger after each user instruction
 //		is executed.
+//	"physPages" -- how many page frames of main memory to simulate
+//	"tlbEntries" -- how big a TLB, if there is one
 //----------------------------------------------------------------------
 
-Machine::Machine(bool debug)
+Machine::Machine(bool debug, int physPages, int tlbEntries)
 {
     int i;
 
+    ASSERT(physPages > 0 && tlbEntries > 0);
+    numPhysPages = physPages;
+    memorySize = physPages * PageSize;
+    tlbSize = tlbEntries;
+
     for (i = 0; i < NumTotalRegs; i++)
         registers[i] = 0;
-    mainMemory = new char[MemorySize];
-    for (i = 0; i < MemorySize; i++)
+    mainMemory = new char[memorySize];
+    for (i = 0; i < memorySize; i++)
         mainMemory[i] = 0;
+    decodeCache = new Instruction[memorySize / 4];
+    decodeValid = new bool[memorySize / 4];
+    blocks = new Block *[memorySize / 4];
+    for (i = 0; i < memorySize / 4; i++) {
+        decodeValid[i] = FALSE;
+        blocks[i] = NULL;
+    }
+    frameGeneration = new unsigned int[numPhysPages];
+    for (i = 0; i < numPhysPages; i++)
+        frameGeneration[i] = 0;
+    useDecodeCache = TRUE;
+    useSoftTLB = !DebugIsEnabled('a');	// so every lookup is traced
+    FlushTranslations();
+    useBlockEngine = FALSE;
+    checkBlocks = FALSE;
+    profile = NULL;
+    trace = NULL;
+    traceProcess = 0;
+    shadow = NULL;
+    trapToKernel = TRUE;
+    lastException = NoException;
 #ifdef USE_TLB
-    tlb = new TranslationEntry[TLBSize];
-    for (i = 0; i < TLBSize; i++)
+    tlb = new TranslationEntry[tlbSize];
+    for (i = 0; i < tlbSize; i++)
         tlb[i].valid = FALSE;
     pageTable = NULL;
 #else	// use linear page table
@@ -84,6 +113,15 @@ Machine::Machine(bool debug)
 Machine::~Machine()
 {
     delete [] mainMemory;
+    delete [] decodeCache;
+    delete [] decodeValid;
+    delete [] frameGeneration;
+    FreeBlocks();
+    delete trace;			// writes out the rest of it
+    if (shadow != NULL) {
+        delete [] shadow->pageTable;	// the only page table we own
+        delete shadow;
+    }
     if (tlb != NULL)
         delete [] tlb;
 }
@@ -106,11 +144,33 @@ Machine::RaiseException(ExceptionType which, int badVAddr)
 //  ASSERT(interrupt->getStatus() == UserMode);
     registers[BadVAddrReg] = badVAddr;
     DelayedLoad(0, 0);			// finish anything in progress
+    if (!trapToKernel) {		// a shadow, checking the block engine
+        lastException = which;
+        return;
+    }
     interrupt->setStatus(SystemMode);
     ExceptionHandler(which);		// interrupts are enabled at this point
     interrupt->setStatus(UserMode);
 }
 
+//----------------------------------------------------------------------
+// Machine::InvalidateFrame
+// 	Forget any decoded instructions from physical page "frame",
+//	because the kernel is about to change, or has just changed, its
+//	contents without going through WriteMem.
+//
+//	"frame" -- the physical page number
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateFrame(int frame)
+{
+    ASSERT(frame >= 0 && frame < numPhysPages);
+    for (int i = 0; i < PageSize / 4; i++)
+        decodeValid[frame * (PageSize / 4) + i] = FALSE;
+    frameGeneration[frame]++;		// block engine translations are stale
+}
+
 //----------------------------------------------------------------------
 // Machine::Debugger
 // 	Primitive debugger for user programs.  Note that we can't use
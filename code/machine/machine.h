@@ -32,9 +32,13 @@
 // the disk sector size, for
 // simplicity
 
-#define NumPhysPages   32
-#define MemorySize 	(NumPhysPages * PageSize)
-#define TLBSize		4		// if there is a TLB, make it small
+// The number of page frames, and of TLB entries, are set when the
+// Machine is created ("-np" and "-nt"), so that one binary can be run
+// with any size of memory.  PageSize can't be: it is also the size of
+// a disk sector, and of the records on the disk.
+
+#define DefaultPhysPages 32		// frames of main memory
+#define DefaultTLBSize	4		// if there is a TLB, make it small
 
 enum ExceptionType { NoException,           // Everything ok!
                      SyscallException,      // A program executed a system call.
@@ -91,6 +95,25 @@ public:
     // Immediates are sign-extended.
 };
 
+struct Block;			// a translated basic block, see blocksim.cc
+class ProfileImage;		// a user program's profile, see profile.h
+class MemoryTrace;		// a trace of memory references, see memtrace.h
+
+// The simulator keeps a small direct-mapped cache of the translations
+// it has used, indexed by virtual page number, in front of the page
+// table or TLB.  An entry is only trusted while the TranslationEntry it
+// came from is still valid and maps the same frame; the kernel must
+// call FlushTranslations whenever it switches to a different page table.
+
+#define SoftTLBSize	16	// slots in the translation cache
+
+struct SoftTLBEntry {
+    unsigned int vpn;		// virtual page number cached in this slot
+    TranslationEntry *entry;	// where the translation came from, or NULL
+    int frame;			// entry->physicalPage, when cached
+    char *page;			// the frame in mainMemory
+};
+
 // The following class defines the simulated host workstation hardware, as
 // seen by user programs -- the CPU registers, main memory, etc.
 // User programs shouldn't be able to tell that they are running on our
@@ -101,13 +124,16 @@ public:
 // If we were to implement more of the UNIX system calls, we ought to be
 // able to run Nachos on top of Nachos!
 //
-// The procedures in this class are defined in machine.cc, mipssim.cc, and
-// translate.cc.
+// The procedures in this class are defined in machine.cc, mipssim.cc,
+// blocksim.cc and translate.cc.
 
 class Machine {
 public:
-    Machine(bool debug);	// Initialize the simulation of the hardware
-    // for running user programs
+    Machine(bool debug, int physPages = DefaultPhysPages,
+            int tlbEntries = DefaultTLBSize);
+    // Initialize the simulation of the hardware
+    // for running user programs, with
+    // "physPages" frames of memory
     ~Machine();			// De-allocate the data structures
 
 // Routines callable by the Nachos kernel
@@ -121,8 +147,16 @@ public:
 
 // Routines internal to the machine simulation -- DO NOT call these
 
-    void OneInstruction(Instruction *instr);
-    // Run one instruction of a user program.
+    bool OneInstruction(Instruction *instr);
+    // Run one instruction of a user program;
+    // FALSE if it raised an exception
+    Instruction *FetchInstruction(int pc, Instruction *storage);
+    // Fetch and decode the instruction at "pc",
+    // using the decode cache if it is on.
+    bool ExecuteInstruction(Instruction *instr);
+    // Execute a decoded instruction; FALSE if
+    // it raised an exception.
+    void RunBlocks();		// Run() using the block engine
     void DelayedLoad(int nextReg, int nextVal);
     // Do a pending delayed load (modifying a reg)
 
@@ -155,8 +189,37 @@ public:
 
     char *mainMemory;		// physical memory to store user program,
     // code and data, while executing
+    int numPhysPages;		// page frames in mainMemory
+    int memorySize;		// bytes of mainMemory (numPhysPages *
+    // PageSize)
+    int tlbSize;		// entries in the TLB, if there is one
     int registers[NumTotalRegs]; // CPU registers, for executing user programs
 
+// To avoid decoding the same instructions over and over, each word of
+// physical memory has a slot in a cache of decoded instructions.  A
+// slot is filled the first time its word is fetched as an instruction,
+// and emptied whenever that word is written.  Simulated stores do this
+// themselves, but the kernel must call InvalidateFrame whenever it
+// changes the contents of a page frame directly through "mainMemory"
+// (loading a page from a file or the backing store, zeroing it, ...).
+
+    void InvalidateFrame(int frame);	// forget decoded instructions in
+					// physical page "frame"
+    bool useDecodeCache;		// FALSE to decode every fetch
+    void FlushTranslations();		// empty the translation cache
+    bool useSoftTLB;			// FALSE to look up every translation
+    ProfileImage *profile;		// where to record samples and calls
+					// of the running program, or NULL
+    MemoryTrace *trace;			// where to record every memory
+					// reference, or NULL
+    int traceProcess;			// the running address space, for
+					// the trace
+    bool useBlockEngine;		// TRUE to run user programs a basic
+					// block at a time (blocksim.cc)
+    bool checkBlocks;			// TRUE to replay every block the
+					// engine runs on an interpreter, and
+					// stop if the results differ
+
 
 // NOTE: the hardware translation of virtual addresses in the user program
 // to physical addresses (relative to the beginning of "mainMemory")
@@ -187,6 +250,37 @@ private:
     // simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
     // time reaches this value
+
+    Instruction *decodeCache;	// decoded instruction for each word of
+    // mainMemory
+    bool *decodeValid;		// whether each decodeCache slot is filled
+    unsigned int *frameGeneration; // bumped whenever decoded instructions
+    // in a page frame are invalidated
+    Block **blocks;		// block engine translation starting at
+    // each word of mainMemory, or NULL
+    SoftTLBEntry softTLB[SoftTLBSize];	// recently used translations
+
+    char *CachedTranslate(int virtAddr, int size, bool writing);
+    // Translate through the translation
+    // cache only; NULL if it misses
+
+    Instruction *DecodeWord(int physicalAddress);
+    // Decode the word at "physicalAddress",
+    // through the decode cache
+    Block *BuildBlock(int physicalAddress);
+    // Translate the block starting at
+    // "physicalAddress" for the block engine
+    void FreeBlocks();		// delete all block engine translations
+    void CatchUp(int pc);	// set the program counters after a run
+    // of quick handlers, see RunBlocks
+
+    Machine *shadow;		// interpreter used to check the block
+    // engine, or NULL
+    bool trapToKernel;		// FALSE if this is a shadow: exceptions
+    // are only noted in lastException
+    ExceptionType lastException;
+    void CheckBlock(int count);	// replay "count" instructions on the shadow
+    void ShadowState();		// copy our state to the shadow
 };
 
 extern void ExceptionHandler(ExceptionType which);
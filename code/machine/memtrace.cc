@@ -0,0 +1,93 @@
+// memtrace.cc
+//	Routines to record the memory references made by user programs
+//	in a compressed trace file.  See memtrace.h for the format, and
+//	bin/tracesim.c for the program that replays it.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "memtrace.h"
+#include "machine.h"
+#include "sysdep.h"
+
+//----------------------------------------------------------------------
+// MemoryTrace::MemoryTrace
+// 	Create the trace file, and write its header.
+//
+//	"fileName" -- UNIX file to write the trace to
+//----------------------------------------------------------------------
+
+MemoryTrace::MemoryTrace(char *fileName)
+{
+    file = OpenForWrite(fileName);
+    buffer = new char[TraceBufferSize];
+    used = 0;
+    numRecords = 0;
+    lastProcess = -1;
+    for (int i = 0; i < 3; i++)
+        lastAddr[i] = 0;
+
+    *(unsigned int *) &buffer[0] = WordToMachine(TraceMagic);
+    *(unsigned int *) &buffer[4] = WordToMachine(PageSize);
+    used = 8;
+}
+
+MemoryTrace::~MemoryTrace()
+{
+    Flush();
+    Close(file);
+    delete [] buffer;
+}
+
+//----------------------------------------------------------------------
+// MemoryTrace::Record
+// 	Append one reference to the trace.
+//
+//	"process" -- which address space made the reference
+//	"addr" -- the virtual address referenced
+//	"kind" -- instruction fetch, load or store
+//----------------------------------------------------------------------
+
+void
+MemoryTrace::Record(int process, int addr, TraceKind kind)
+{
+    int distance = addr - lastAddr[kind];
+    unsigned int zigzag = (distance << 1) ^ (distance >> 31);
+    bool newProcess = (process != lastProcess);
+
+    if (used > TraceBufferSize - 10)	// room for the longest record
+        Flush();
+    PutNumber((zigzag << 3) | (newProcess << 2) | kind);
+    if (newProcess)
+        PutNumber(process);
+    lastAddr[kind] = addr;
+    lastProcess = process;
+    numRecords++;
+}
+
+//----------------------------------------------------------------------
+// MemoryTrace::PutNumber
+// 	Append "n" to the buffer, 7 bits at a time.  Distances are
+//	shifted left 3 bits above, so their top 3 bits are lost; the
+//	simulated machine's addresses are far smaller than that.
+//----------------------------------------------------------------------
+
+void
+MemoryTrace::PutNumber(unsigned int n)
+{
+    while (n >= 0x80) {
+        buffer[used++] = (n & 0x7f) | 0x80;
+        n >>= 7;
+    }
+    buffer[used++] = n;
+}
+
+void
+MemoryTrace::Flush()
+{
+    if (used > 0)
+        WriteFile(file, buffer, used);
+    used = 0;
+}
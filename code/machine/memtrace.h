@@ -0,0 +1,56 @@
+// memtrace.h
+//	Data structures for recording the memory references made by user
+//	programs, for replay by bin/tracesim.
+//
+//	With "-mt <file>", every instruction fetch, load and store a user
+//	program makes is written to <file> as a (process, virtual address,
+//	kind) record.  Records are compressed: each is a variable-length
+//	number holding the kind, whether the process changed, and the
+//	distance from the previous address of the same kind, so a run of
+//	sequential fetches costs a byte each.  The format:
+//
+//	    header:  TraceMagic, then PageSize, as 4 byte little-endian words
+//	    record:  varint((zigzag(addr - last[kind]) << 3) | (newProcess << 2)
+//			    | kind)
+//		     then varint(process), if newProcess is set
+//
+//	A varint is 7 bits per byte, low bits first, with the top bit set
+//	on every byte but the last; zigzag(n) is (n << 1) ^ (n >> 31), so
+//	small negative distances are small too.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef MEMTRACE_H
+#define MEMTRACE_H
+
+#include "copyright.h"
+
+#define TraceMagic	0x4e545243	// "NTRC"
+#define TraceBufferSize	65536		// bytes buffered before writing
+
+enum TraceKind { TraceFetch = 0, TraceRead = 1, TraceWrite = 2 };
+
+class MemoryTrace {
+public:
+    MemoryTrace(char *fileName);	// start a trace in "fileName"
+    ~MemoryTrace();			// write out the rest, and close it
+
+    void Record(int process, int addr, TraceKind kind);
+    // "process" referenced "addr"
+
+    int numRecords;			// references recorded
+
+private:
+    int file;				// UNIX file descriptor
+    char *buffer;			// records not yet written
+    int used;				// bytes of "buffer" filled
+    int lastProcess;			// process of the previous record
+    int lastAddr[3];			// previous address of each kind
+
+    void PutNumber(unsigned int n);	// append a varint
+    void Flush();			// write out the buffer
+};
+
+#endif // MEMTRACE_H
@@ -14,6 +14,7 @@
 
 #include "machine.h"
 #include "mipssim.h"
+#include "memtrace.h"
 #include "system.h"
 
 static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
@@ -25,22 +26,48 @@ static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 //
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
+//
+//	Interrupt::OneTick is only called when it has something to do:
+//	after an instruction that makes the next pending interrupt due,
+//	or one that raised an exception (and so ran kernel code, which
+//	may have scheduled an earlier one).  Until then, the clock is
+//	advanced here.  Interrupts therefore happen at exactly the same
+//	simulated times as if OneTick were called after every instruction.
+//	When single stepping, or tracing with the 'i' debug flag, it is.
 //----------------------------------------------------------------------
 
 void
 Machine::Run()
 {
     Instruction *instr = new Instruction;  // storage for decoded instruction
+    bool batchTicks = !singleStep && !DebugIsEnabled('i');
+    int left = 0;		// instructions that can run before the
+				// next pending interrupt is due
 
     if(DebugIsEnabled('m'))
         printf("Starting thread \"%s\" at time %d\n",
                currentThread->getName(), stats->totalTicks);
     interrupt->setStatus(UserMode);
+    if (useBlockEngine && !singleStep && profile == NULL && trace == NULL
+            && !DebugIsEnabled('m')
+            && !DebugIsEnabled('a') && !DebugIsEnabled('i'))
+        RunBlocks();			// never returns
     for (;;) {
-        OneInstruction(instr);
+        if (profile != NULL)
+            profile->Tick(registers[PCReg]);
+        if (OneInstruction(instr) && left > 0) {
+            stats->totalTicks += UserTick;	// nothing else for OneTick to do
+            stats->userTicks += UserTick;
+            left--;
+            continue;
+        }
         interrupt->OneTick();
         if (singleStep && (runUntilTime <= stats->totalTicks))
             Debugger();
+        if (batchTicks)
+            left = (interrupt->TicksUntilDue() - 1) / UserTick;
+        if (left < 0)
+            left = 0;
     }
 }
 
@@ -67,6 +94,72 @@ TypeToReg(RegType reg, Instruction *instr)
     }
 }
 
+//----------------------------------------------------------------------
+// Machine::FetchInstruction
+// 	Fetch the instruction at "pc" and decode it.  With the decode
+//	cache on, the fetch is still translated (so the use bit is set and
+//	faults happen exactly as before), but a word that has been decoded
+//	since it was last written is not read or decoded again.
+//
+//	The fetch is recorded in the memory trace, if there is one.
+//
+//	Returns the decoded instruction, either in the decode cache or in
+//	"storage", or NULL if the fetch raised an exception.
+//
+//	"pc" -- the virtual address of the instruction
+//	"storage" -- where to decode it, if the decode cache is off
+//----------------------------------------------------------------------
+
+Instruction *
+Machine::FetchInstruction(int pc, Instruction *storage)
+{
+    int physicalAddress;
+    ExceptionType exception;
+
+    if (!useDecodeCache)		// traced just as ReadMem would
+        DEBUG('a', "Reading VA 0x%x, size 4\n", pc);
+    exception = Translate(pc, &physicalAddress, 4, FALSE);
+    if (exception != NoException) {
+        RaiseException(exception, pc);
+        return NULL;
+    }
+    if (trace != NULL)
+        trace->Record(traceProcess, pc, TraceFetch);
+
+    if (!useDecodeCache) {
+        storage->value = WordToHost(*(unsigned int *) &mainMemory[physicalAddress]);
+        DEBUG('a', "\tvalue read = %8.8x\n", storage->value);
+        storage->Decode();
+        return storage;
+    }
+    return DecodeWord(physicalAddress);
+}
+
+//----------------------------------------------------------------------
+// Machine::DecodeWord
+// 	Return the decoded form of the (already translated) word at
+//	"physicalAddress", decoding it only if it has been written since
+//	it was last decoded.
+//
+//	"physicalAddress" -- word-aligned offset into mainMemory
+//----------------------------------------------------------------------
+
+Instruction *
+Machine::DecodeWord(int physicalAddress)
+{
+    Instruction *instr = &decodeCache[physicalAddress / 4];
+
+    if (decodeValid[physicalAddress / 4]) {
+        stats->numDecodeHits++;
+        return instr;
+    }
+    stats->numDecodeMisses++;
+    instr->value = WordToHost(*(unsigned int *) &mainMemory[physicalAddress]);
+    instr->Decode();
+    decodeValid[physicalAddress / 4] = TRUE;
+    return instr;
+}
+
 //----------------------------------------------------------------------
 // Machine::OneInstruction
 // 	Execute one instruction from a user-level program
@@ -88,21 +181,17 @@ TypeToReg(RegType reg, Instruction *instr)
 //	leaving.  This allows the Nachos kernel to control our behavior
 //	by controlling the contents of memory, the translation table,
 //	and the register set.
+//
+//	Returns FALSE if the instruction raised an exception.
 //----------------------------------------------------------------------
 
-void
+bool
 Machine::OneInstruction(Instruction *instr)
 {
-    int raw;
-    int nextLoadReg = 0;
-    int nextLoadValue = 0; 	// record delayed load operation, to apply
-    // in the future
-
     // Fetch instruction
-    if (!machine->ReadMem(registers[PCReg], 4, &raw))
-        return;			// exception occurred
-    instr->value = raw;
-    instr->Decode();
+    instr = FetchInstruction(registers[PCReg], instr);
+    if (instr == NULL)
+        return FALSE;		// exception occurred
 
     if (DebugIsEnabled('m')) {
         struct OpString *str = &opStrings[instr->opCode];
@@ -114,6 +203,30 @@ Machine::OneInstruction(Instruction *instr)
         printf("\n");
     }
 
+    return ExecuteInstruction(instr);
+}
+
+//----------------------------------------------------------------------
+// Machine::ExecuteInstruction
+// 	Execute one already decoded instruction, at the current PC, and
+//	advance the program counters past it.  This is the part of
+//	OneInstruction after the fetch, shared with the block engine
+//	(blocksim.cc), which handles the instructions it has no special
+//	handler for by calling us.
+//
+//	Returns FALSE if the instruction raised an exception, in which
+//	case the program counters are left alone.
+//
+//	"instr" -- the decoded instruction
+//----------------------------------------------------------------------
+
+bool
+Machine::ExecuteInstruction(Instruction *instr)
+{
+    int nextLoadReg = 0;
+    int nextLoadValue = 0; 	// record delayed load operation, to apply
+    // in the future
+
     // Compute next pc, but don't install in case there's an error or branch.
     int pcAfter = registers[NextPCReg] + 4;
     int sum, diff, tmp, value;
@@ -127,7 +240,7 @@ Machine::OneInstruction(Instruction *instr)
         if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
                 ((registers[instr->rs] ^ sum) & SIGN_BIT)) {
             RaiseException(OverflowException, 0);
-            return;
+            return FALSE;
         }
         registers[instr->rd] = sum;
         break;
@@ -137,7 +250,7 @@ Machine::OneInstruction(Instruction *instr)
         if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
                 ((instr->extra ^ sum) & SIGN_BIT)) {
             RaiseException(OverflowException, 0);
-            return;
+            return FALSE;
         }
         registers[instr->rt] = sum;
         break;
@@ -218,21 +331,33 @@ Machine::OneInstruction(Instruction *instr)
 
     case OP_JAL:
         registers[R31] = registers[NextPCReg] + 4;
+        pcAfter = (pcAfter & 0xf0000000) | IndexToAddr(instr->extra);
+        if (profile != NULL)
+            profile->Call(registers[PCReg], pcAfter);
+        break;
+
     case OP_J:
         pcAfter = (pcAfter & 0xf0000000) | IndexToAddr(instr->extra);
         break;
 
     case OP_JALR:
         registers[instr->rd] = registers[NextPCReg] + 4;
+        pcAfter = registers[instr->rs];
+        if (profile != NULL)
+            profile->Call(registers[PCReg], pcAfter);
+        break;
+
     case OP_JR:
         pcAfter = registers[instr->rs];
+        if (profile != NULL && instr->rs == R31)
+            profile->Return();
         break;
 
     case OP_LB:
     case OP_LBU:
         tmp = registers[instr->rs] + instr->extra;
-        if (!machine->ReadMem(tmp, 1, &value))
-            return;
+        if (!ReadMem(tmp, 1, &value))
+            return FALSE;
 
         if ((value & 0x80) && (instr->opCode == OP_LB))
             value |= 0xffffff00;
@@ -247,10 +372,10 @@ Machine::OneInstruction(Instruction *instr)
         tmp = registers[instr->rs] + instr->extra;
         if (tmp & 0x1) {
             RaiseException(AddressErrorException, tmp);
-            return;
+            return FALSE;
         }
-        if (!machine->ReadMem(tmp, 2, &value))
-            return;
+        if (!ReadMem(tmp, 2, &value))
+            return FALSE;
 
         if ((value & 0x8000) && (instr->opCode == OP_LH))
             value |= 0xffff0000;
@@ -269,10 +394,10 @@ Machine::OneInstruction(Instruction *instr)
         tmp = registers[instr->rs] + instr->extra;
         if (tmp & 0x3) {
             RaiseException(AddressErrorException, tmp);
-            return;
+            return FALSE;
         }
-        if (!machine->ReadMem(tmp, 4, &value))
-            return;
+        if (!ReadMem(tmp, 4, &value))
+            return FALSE;
         nextLoadReg = instr->rt;
         nextLoadValue = value;
         break;
@@ -285,8 +410,8 @@ Machine::OneInstruction(Instruction *instr)
         // fail (I think) if the other cases are ever exercised.
         ASSERT((tmp & 0x3) == 0);
 
-        if (!machine->ReadMem(tmp, 4, &value))
-            return;
+        if (!ReadMem(tmp, 4, &value))
+            return FALSE;
         if (registers[LoadReg] == instr->rt)
             nextLoadValue = registers[LoadValueReg];
         else
@@ -316,8 +441,8 @@ Machine::OneInstruction(Instruction *instr)
         // fail (I think) if the other cases are ever exercised.
         ASSERT((tmp & 0x3) == 0);
 
-        if (!machine->ReadMem(tmp, 4, &value))
-            return;
+        if (!ReadMem(tmp, 4, &value))
+            return FALSE;
         if (registers[LoadReg] == instr->rt)
             nextLoadValue = registers[LoadValueReg];
         else
@@ -381,15 +506,15 @@ Machine::OneInstruction(Instruction *instr)
         break;
 
     case OP_SB:
-        if (!machine->WriteMem((unsigned)
+        if (!WriteMem((unsigned)
                                (registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
-            return;
+            return FALSE;
         break;
 
     case OP_SH:
-        if (!machine->WriteMem((unsigned)
+        if (!WriteMem((unsigned)
                                (registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
-            return;
+            return FALSE;
         break;
 
     case OP_SLL:
@@ -459,7 +584,7 @@ Machine::OneInstruction(Instruction *instr)
         if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
                 ((registers[instr->rs] ^ diff) & SIGN_BIT)) {
             RaiseException(OverflowException, 0);
-            return;
+            return FALSE;
         }
         registers[instr->rd] = diff;
         break;
@@ -469,9 +594,9 @@ Machine::OneInstruction(Instruction *instr)
         break;
 
     case OP_SW:
-        if (!machine->WriteMem((unsigned)
+        if (!WriteMem((unsigned)
                                (registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
-            return;
+            return FALSE;
         break;
 
     case OP_SWL:
@@ -481,8 +606,8 @@ Machine::OneInstruction(Instruction *instr)
         // fail (I think) if the other cases are ever exercised.
         ASSERT((tmp & 0x3) == 0);
 
-        if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-            return;
+        if (!ReadMem((tmp & ~0x3), 4, &value))
+            return FALSE;
         switch (tmp & 0x3) {
         case 0:
             value = registers[instr->rt];
@@ -500,8 +625,8 @@ Machine::OneInstruction(Instruction *instr)
                                             0xff);
             break;
         }
-        if (!machine->WriteMem((tmp & ~0x3), 4, value))
-            return;
+        if (!WriteMem((tmp & ~0x3), 4, value))
+            return FALSE;
         break;
 
     case OP_SWR:
@@ -511,8 +636,8 @@ Machine::OneInstruction(Instruction *instr)
         // fail (I think) if the other cases are ever exercised.
         ASSERT((tmp & 0x3) == 0);
 
-        if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-            return;
+        if (!ReadMem((tmp & ~0x3), 4, &value))
+            return FALSE;
         switch (tmp & 0x3) {
         case 0:
             value = (value & 0xffffff) | (registers[instr->rt] << 24);
@@ -527,13 +652,13 @@ Machine::OneInstruction(Instruction *instr)
             value = registers[instr->rt];
             break;
         }
-        if (!machine->WriteMem((tmp & ~0x3), 4, value))
-            return;
+        if (!WriteMem((tmp & ~0x3), 4, value))
+            return FALSE;
         break;
 
     case OP_SYSCALL:
         RaiseException(SyscallException, 0);
-        return;
+        return FALSE;
 
     case OP_XOR:
         registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
@@ -546,7 +671,7 @@ Machine::OneInstruction(Instruction *instr)
     case OP_RES:
     case OP_UNIMP:
         RaiseException(IllegalInstrException, 0);
-        return;
+        return FALSE;
 
     default:
         ASSERT(FALSE);
@@ -554,14 +679,20 @@ Machine::OneInstruction(Instruction *instr)
 
     // Now we have successfully executed the instruction.
 
-    // Do any delayed load operation
-    DelayedLoad(nextLoadReg, nextLoadValue);
+    // Do any delayed load operation.  Usually there is none, neither
+    // finishing nor starting, and all DelayedLoad would do is keep R0 zero.
+    if ((registers[LoadReg] | registers[LoadValueReg]
+            | nextLoadReg | nextLoadValue) != 0)
+        DelayedLoad(nextLoadReg, nextLoadValue);
+    else
+        registers[0] = 0;
 
     // Advance program counters.
     registers[PrevPCReg] = registers[PCReg];	// for debugging, in case we
     // are jumping into lala-land
     registers[PCReg] = registers[NextPCReg];
     registers[NextPCReg] = pcAfter;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -0,0 +1,361 @@
+// profile.cc
+//	Routines to profile user programs: sample the program counter,
+//	count procedure calls, and print the results, naming procedures
+//	from the program's ".sym" file (see bin/coff2noff.c).
+//
+//	Machine::Run calls Tick before every user instruction it runs,
+//	and Machine::ExecuteInstruction calls Call and Return, whenever
+//	the running address space has a profile.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "profile.h"
+#include "utility.h"
+
+#include <stdio.h>
+#include <string.h>
+
+//----------------------------------------------------------------------
+// ProfileImage::ProfileImage
+// 	Start an empty profile of a program, and read the names of its
+//	procedures.
+//
+//	"programName" -- the file the program was loaded from
+//	"size" -- size of its address space, in bytes
+//	"sampleInterval" -- sample every "sampleInterval" instructions
+//----------------------------------------------------------------------
+
+ProfileImage::ProfileImage(char *programName, int size, int sampleInterval)
+{
+    name = new char[strlen(programName) + 1];
+    strcpy(name, programName);
+    next = NULL;
+
+    interval = countdown = sampleInterval;
+    numSamples = 0;
+    numWords = size / 4;
+    pcCounts = new int[numWords];
+    for (int i = 0; i < numWords; i++)
+        pcCounts[i] = 0;
+
+    symbols = NULL;
+    numSymbols = 0;
+    LoadSymbols();
+
+    arcs = NULL;
+    numArcs = maxArcs = 0;
+    depth = 0;
+}
+
+ProfileImage::~ProfileImage()
+{
+    delete [] name;
+    delete [] pcCounts;
+    delete [] symbols;
+    delete [] arcs;
+}
+
+//----------------------------------------------------------------------
+// ProfileImage::LoadSymbols
+// 	Read "<name>.sym", which has one procedure per line, as a hex
+//	address and a name, sorted by address.  If there is no such
+//	file, procedures are shown by address instead.
+//----------------------------------------------------------------------
+
+void
+ProfileImage::LoadSymbols()
+{
+    char *fileName = new char[strlen(name) + 5];
+    char symbolName[MaxSymbolName];
+    unsigned int addr;
+    FILE *file;
+
+    sprintf(fileName, "%s.sym", name);
+    file = fopen(fileName, "r");
+    delete [] fileName;
+    if (file == NULL)
+        return;
+
+    while (fscanf(file, "%x %63s", &addr, symbolName) == 2)
+        numSymbols++;
+    symbols = new ProfileSymbol[numSymbols];
+
+    rewind(file);
+    for (int i = 0; i < numSymbols; i++) {
+        if (fscanf(file, "%x %63s", &addr, symbols[i].name) != 2) {
+            numSymbols = i;		// changed under us
+            break;
+        }
+        symbols[i].addr = addr;
+        symbols[i].self = symbols[i].cumulative = 0;
+        symbols[i].lastSample = 0;
+    }
+    fclose(file);
+}
+
+//----------------------------------------------------------------------
+// ProfileImage::SymbolFor
+// 	Return the index of the procedure containing "addr": the last
+//	one starting at or before it.  -1 if there is none.
+//----------------------------------------------------------------------
+
+int
+ProfileImage::SymbolFor(int addr)
+{
+    int low = 0, high = numSymbols - 1, mid;
+
+    if (numSymbols == 0 || (unsigned) addr < (unsigned) symbols[0].addr)
+        return -1;
+    while (low < high) {	// symbols[low].addr <= addr always
+        mid = (low + high + 1) / 2;
+        if ((unsigned) symbols[mid].addr <= (unsigned) addr)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+    return low;
+}
+
+//----------------------------------------------------------------------
+// ProfileImage::Sample
+// 	Charge a sample to the instruction at "pc", the procedure it is
+//	in, and (cumulatively) to each procedure still being called.
+//----------------------------------------------------------------------
+
+void
+ProfileImage::Sample(int pc)
+{
+    int symbol = SymbolFor(pc);
+
+    numSamples++;
+    if ((unsigned) pc / 4 < (unsigned) numWords)
+        pcCounts[pc / 4]++;
+    if (symbol >= 0)
+        symbols[symbol].self++;
+    CountCumulative(symbol);
+    for (int i = 0; i < depth && i < MaxCallDepth; i++)
+        CountCumulative(stack[i]);
+}
+
+void
+ProfileImage::CountCumulative(int symbol)
+{
+    if (symbol >= 0 && symbols[symbol].lastSample != numSamples) {
+        symbols[symbol].lastSample = numSamples;
+        symbols[symbol].cumulative++;
+    }
+}
+
+//----------------------------------------------------------------------
+// ProfileImage::Call
+// 	Count a call, and remember the procedure called until it returns.
+//
+//	"pc" -- address of the "jal" or "jalr"
+//	"target" -- address called
+//----------------------------------------------------------------------
+
+void
+ProfileImage::Call(int pc, int target)
+{
+    int caller = SymbolFor(pc);
+    int from = (caller >= 0) ? symbols[caller].addr : pc;
+    int i;
+    ProfileArc *bigger;
+
+    for (i = 0; i < numArcs; i++)
+        if (arcs[i].from == from && arcs[i].to == target)
+            break;
+    if (i == numArcs) {			// first call of its kind
+        if (numArcs == maxArcs) {
+            maxArcs = maxArcs ? 2 * maxArcs : 32;
+            bigger = new ProfileArc[maxArcs];
+            for (int j = 0; j < numArcs; j++)
+                bigger[j] = arcs[j];
+            delete [] arcs;
+            arcs = bigger;
+        }
+        arcs[numArcs].from = from;
+        arcs[numArcs].to = target;
+        arcs[numArcs].count = 0;
+        numArcs++;
+    }
+    arcs[i].count++;
+
+    if (depth < MaxCallDepth)
+        stack[depth] = SymbolFor(target);
+    depth++;
+}
+
+//----------------------------------------------------------------------
+// ProfileImage::Return
+// 	The procedure most recently called has returned.
+//----------------------------------------------------------------------
+
+void
+ProfileImage::Return()
+{
+    if (depth > 0)
+        depth--;
+}
+
+//----------------------------------------------------------------------
+// ProfileImage::Describe
+// 	Put a printable name for "addr" in "buffer": "procedure", or
+//	"procedure+offset", or just the address if we don't know which
+//	procedure it is in.
+//----------------------------------------------------------------------
+
+void
+ProfileImage::Describe(int addr, char *buffer)
+{
+    int symbol = SymbolFor(addr);
+
+    if (symbol < 0)
+        sprintf(buffer, "0x%x", addr);
+    else if (symbols[symbol].addr == addr)
+        sprintf(buffer, "%s", symbols[symbol].name);
+    else
+        sprintf(buffer, "%s+0x%x", symbols[symbol].name,
+                addr - symbols[symbol].addr);
+}
+
+//----------------------------------------------------------------------
+// ProfileImage::Print
+// 	Print the flat profile (procedures by samples taken in them),
+//	the instructions with the most samples, and the calls made.
+//----------------------------------------------------------------------
+
+void
+ProfileImage::Print()
+{
+    char from[MaxSymbolName + 12], to[MaxSymbolName + 12];
+    int i, j, best;
+    ProfileSymbol symbol;
+    ProfileArc arc;
+
+    printf("\nProfile of %s: %d samples, one every %d instructions\n",
+           name, numSamples, interval);
+    if (numSamples == 0)
+        return;
+
+    if (numSymbols > 0) {
+        // selection sort by samples in the procedure itself; this
+        // is only done once, at shutdown
+        for (i = 0; i < numSymbols; i++) {
+            for (best = i, j = i + 1; j < numSymbols; j++)
+                if (symbols[j].self > symbols[best].self
+                        || (symbols[j].self == symbols[best].self
+                            && symbols[j].cumulative > symbols[best].cumulative))
+                    best = j;
+            symbol = symbols[i];
+            symbols[i] = symbols[best];
+            symbols[best] = symbol;
+        }
+        printf("  self%%      self    cumulative  procedure\n");
+        for (i = 0; i < numSymbols && symbols[i].cumulative > 0; i++)
+            printf("%6.2f%% %9d %9d     %s\n",
+                   100.0 * symbols[i].self / numSamples, symbols[i].self,
+                   symbols[i].cumulative, symbols[i].name);
+
+        // put them back in address order, for SymbolFor
+        for (i = 1; i < numSymbols; i++) {
+            symbol = symbols[i];
+            for (j = i; j > 0 && (unsigned) symbols[j - 1].addr
+                    > (unsigned) symbol.addr; j--)
+                symbols[j] = symbols[j - 1];
+            symbols[j] = symbol;
+        }
+    }
+
+    printf("Hottest instructions:\n");
+    for (i = 0; i < HotInstructions; i++) {
+        for (best = 0, j = 1; j < numWords; j++)
+            if (pcCounts[j] > pcCounts[best])
+                best = j;
+        if (pcCounts[best] == 0)
+            break;
+        Describe(best * 4, from);
+        printf("%9d  0x%x  %s\n", pcCounts[best], best * 4, from);
+        pcCounts[best] = -pcCounts[best];	// so it isn't picked again
+    }
+    for (j = 0; j < numWords; j++)
+        if (pcCounts[j] < 0)
+            pcCounts[j] = -pcCounts[j];
+
+    if (numArcs > 0) {
+        for (i = 1; i < numArcs; i++) {		// most frequent first
+            arc = arcs[i];
+            for (j = i; j > 0 && arcs[j - 1].count < arc.count; j--)
+                arcs[j] = arcs[j - 1];
+            arcs[j] = arc;
+        }
+        printf("Calls:\n");
+        for (i = 0; i < numArcs; i++) {
+            Describe(arcs[i].from, from);
+            Describe(arcs[i].to, to);
+            printf("%9d  %s -> %s\n", arcs[i].count, from, to);
+        }
+    }
+}
+
+//----------------------------------------------------------------------
+// Profiler::Profiler
+// 	Start profiling user programs.
+//
+//	"sampleInterval" -- sample every "sampleInterval" instructions
+//----------------------------------------------------------------------
+
+Profiler::Profiler(int sampleInterval)
+{
+    ASSERT(sampleInterval > 0);
+    interval = sampleInterval;
+    images = NULL;
+}
+
+Profiler::~Profiler()
+{
+    ProfileImage *image;
+
+    while (images != NULL) {
+        image = images;
+        images = image->next;
+        delete image;
+    }
+}
+
+//----------------------------------------------------------------------
+// Profiler::ImageFor
+// 	Return the profile of the program in "programName", starting one
+//	if this is the first time it has been run.
+//
+//	"size" -- size of the program's address space, in bytes
+//----------------------------------------------------------------------
+
+ProfileImage *
+Profiler::ImageFor(char *programName, int size)
+{
+    ProfileImage *image;
+
+    for (image = images; image != NULL; image = image->next)
+        if (!strcmp(image->name, programName))
+            return image;
+    image = new ProfileImage(programName, size, interval);
+    image->next = images;
+    images = image;
+    return image;
+}
+
+//----------------------------------------------------------------------
+// Profiler::Print
+// 	Print the profile of every program run.
+//----------------------------------------------------------------------
+
+void
+Profiler::Print()
+{
+    for (ProfileImage *image = images; image != NULL; image = image->next)
+        image->Print();
+}
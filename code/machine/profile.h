@@ -0,0 +1,113 @@
+// profile.h
+//	Data structures for profiling user programs.
+//
+//	With "-up N", the simulator records the program counter of every
+//	N-th user instruction (every one, if N is 1), and every procedure
+//	call ("jal" or "jalr") and return ("jr $31"), against the program
+//	that is running.  When Nachos halts, a flat profile, the hottest
+//	instructions and a call graph are printed for each program, with
+//	procedure names from the ".sym" file coff2noff writes next to the
+//	executable, if there is one.
+//
+//	The calls in progress are kept per program, not per thread, so
+//	the "cumulative" counts (samples taken anywhere inside a
+//	procedure or the ones it called) are only approximate for
+//	programs that Fork.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "copyright.h"
+
+#define MaxSymbolName	64	// longest procedure name kept
+#define MaxCallDepth	64	// deepest calls followed for cumulative counts
+#define HotInstructions	10	// how many of the hottest PCs to print
+
+// A procedure named in a program's symbol file, and the samples
+// taken in it.
+struct ProfileSymbol {
+    int addr;			// where the procedure starts
+    char name[MaxSymbolName];
+    int self;			// samples taken in the procedure itself
+    int cumulative;		// ... in it or anything it called
+    int lastSample;		// sample that last counted as cumulative,
+    // so recursive calls only count once
+};
+
+// A count of calls from one procedure to another.
+struct ProfileArc {
+    int from;			// the calling procedure's address (or the
+    // call's, if it isn't in a known procedure)
+    int to;			// the called procedure's address
+    int count;
+};
+
+// The profile of one program, shared by every process running it.
+class ProfileImage {
+public:
+    ProfileImage(char *programName, int size, int sampleInterval);
+    // Profile the program in file
+    // "programName", whose address space
+    // is "size" bytes, sampling every
+    // "sampleInterval" instructions
+    ~ProfileImage();
+
+    void Tick(int pc) {		// called before every instruction
+        if (--countdown == 0) {
+            countdown = interval;
+            Sample(pc);
+        }
+    }
+    void Call(int pc, int target);	// the call at "pc" went to "target"
+    void Return();			// the current procedure returned
+    void Print();			// print the profile
+
+    char *name;			// the program's file name
+    ProfileImage *next;		// the next program profiled
+
+private:
+    int interval;		// instructions between samples
+    int countdown;		// instructions until the next sample
+    int numSamples;
+    int *pcCounts;		// samples at each word of the program
+    int numWords;
+
+    ProfileSymbol *symbols;	// the program's procedures, by address
+    int numSymbols;
+
+    ProfileArc *arcs;		// calls seen so far
+    int numArcs, maxArcs;
+
+    int stack[MaxCallDepth];	// procedures called and not returned from
+    int depth;			// how many; may be more than MaxCallDepth
+
+    void Sample(int pc);	// the program is at "pc"
+    void LoadSymbols();		// read "name".sym
+    int SymbolFor(int addr);	// the procedure "addr" is in, or -1
+    void Describe(int addr, char *buffer);
+    // "procedure+offset", or just the address
+    void CountCumulative(int symbol);
+};
+
+// The profiles of all the programs run.
+class Profiler {
+public:
+    Profiler(int sampleInterval);	// sample every "sampleInterval"
+    // instructions
+    ~Profiler();
+
+    ProfileImage *ImageFor(char *programName, int size);
+    // The profile to record "programName"
+    // in, created the first time it is run
+    void Print();		// print every program's profile
+
+private:
+    int interval;
+    ProfileImage *images;	// the programs profiled so far
+};
+
+#endif // PROFILE_H
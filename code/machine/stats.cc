@@ -19,11 +19,18 @@
 Statistics::Statistics()
 {
     totalTicks = idleTicks = systemTicks = userTicks = 0;
-    numDiskReads = numDiskWrites = 0;
+    numDiskReads = numDiskWrites = diskRequestTicks = 0;
+    numDiskSectorsRead = numDiskSectorsWritten = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
     numPageOuts = 0;
     numPageIns = 0;
+    numDecodeHits = numDecodeMisses = 0;
+    numBlocksBuilt = numBlocksRun = numBlocksChained = numBlocksChecked = 0;
+    numCacheHits = numCacheMisses = numCacheReadAheads = 0;
+    numNameCacheHits = numNameCacheMisses = 0;
+    numJournalCommits = numJournalSectors = numJournalRecovered = 0;
+    hostStartTime = HostSeconds();
 }
 
 //----------------------------------------------------------------------
@@ -38,6 +45,13 @@ Statistics::Print()
     printf("Ticks: total %d, idle %d, system %d, user %d\n", totalTicks,
            idleTicks, systemTicks, userTicks);
     printf("Disk I/O: reads %d, writes %d\n", numDiskReads, numDiskWrites);
+    if (numDiskSectorsRead + numDiskSectorsWritten
+            > numDiskReads + numDiskWrites)
+        printf("Disk sectors: read %d, written %d\n", numDiskSectorsRead,
+               numDiskSectorsWritten);
+    if (diskRequestTicks > 0)
+        printf("Disk requests: average latency %d ticks\n",
+               diskRequestTicks / (numDiskReads + numDiskWrites));
     printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead,
            numConsoleCharsWritten);
     printf("Paging: faults %d\tPageOuts: %d\tPageIns: %d\n", numPageFaults, numPageOuts, numPageIns);
@@ -46,4 +60,27 @@ Statistics::Print()
 
     printf("Number of pages written to backing store: %d\n", numPageOuts);
     printf("Number of pages read from backing store: %d\n", numPageIns);
+
+    if (numDecodeHits + numDecodeMisses > 0)
+        printf("Decode cache: hits %d, misses %d\n", numDecodeHits,
+               numDecodeMisses);
+    if (numBlocksRun > 0)
+        printf("Blocks: built %d, run %d, chained %d, checked %d\n",
+               numBlocksBuilt, numBlocksRun, numBlocksChained,
+               numBlocksChecked);
+    if (numCacheHits + numCacheMisses > 0)
+        printf("Buffer cache: hits %d, misses %d, read ahead %d\n",
+               numCacheHits, numCacheMisses, numCacheReadAheads);
+    if (numNameCacheHits + numNameCacheMisses > 0)
+        printf("Name cache: hits %d, misses %d\n", numNameCacheHits,
+               numNameCacheMisses);
+    if (numJournalCommits + numJournalRecovered > 0)
+        printf("Journal: commits %d, sectors logged %d, recovered %d\n",
+               numJournalCommits, numJournalSectors, numJournalRecovered);
+    if (userTicks > 0) {
+        double hostTime = HostSeconds() - hostStartTime;
+
+        printf("Host time %.2f seconds, %.2f simulated MIPS\n", hostTime,
+               hostTime > 0 ? (userTicks / UserTick) / (hostTime * 1e6) : 0.0);
+    }
 }
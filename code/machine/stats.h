@@ -30,6 +30,10 @@ public:
 
     int numDiskReads;		// number of disk read requests
     int numDiskWrites;		// number of disk write requests
+    int numDiskSectorsRead;	// sectors moved by those requests, which
+    int numDiskSectorsWritten;	// may each be a run of several
+    int diskRequestTicks;	// total time from making a disk request
+				// until it was done, queueing included
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
@@ -39,6 +43,25 @@ public:
     int numPageOuts;  // number of pages written to backing store
     int numPageIns;   // number of pages read from backing store
 
+    int numDecodeHits;	  // instruction fetches found already decoded
+    int numDecodeMisses;  // instruction fetches that had to be decoded
+
+    int numBlocksBuilt;	  // basic blocks translated by the block engine
+    int numBlocksRun;	  // translated blocks run
+    int numBlocksChained; // ... found through the previous block's link
+    int numBlocksChecked; // ... replayed against the interpreter ("-bc")
+
+    int numCacheHits;	  // sectors found in the buffer cache
+    int numCacheMisses;	  // sectors that had to be read (or replaced)
+    int numCacheReadAheads; // of those, the ones read ahead
+    int numNameCacheHits; // file names found in the name cache
+    int numNameCacheMisses; // ... and not found
+    int numJournalCommits; // transactions written to the journal
+    int numJournalSectors; // sectors written in them
+    int numJournalRecovered; // sectors copied from the journal at boot
+
+    double hostStartTime; // host time (in seconds) when Nachos started
+
     Statistics(); 		// initialize everything to zero
 
     void Print();		// print collected statistics
@@ -35,6 +35,7 @@ extern "C" {
 #include <sys/file.h>
 #include <sys/un.h>
 #include <sys/mman.h>
+#include <sys/uio.h>
 #ifdef HOST_i386
 #include <unistd.h>
 #include <sys/time.h>
@@ -226,6 +227,44 @@ Lseek(int fd, int offset, int whence)
     ASSERT(retVal >= 0);
 }
 
+//----------------------------------------------------------------------
+// ReadVector/WriteVector
+// 	Read or write "numBuffers" buffers of "bufSize" bytes each, from
+//	or to consecutive bytes of an open file starting at "offset", with
+//	one system call.  The file's position isn't used or changed.
+//	Abort on error.
+//----------------------------------------------------------------------
+
+void
+ReadVector(int fd, char **buffers, int numBuffers, int bufSize, int offset)
+{
+    struct iovec *iov = new struct iovec[numBuffers];
+    int retVal;
+
+    for (int i = 0; i < numBuffers; i++) {
+        iov[i].iov_base = buffers[i];
+        iov[i].iov_len = bufSize;
+    }
+    retVal = preadv(fd, iov, numBuffers, offset);
+    ASSERT(retVal == numBuffers * bufSize);
+    delete [] iov;
+}
+
+void
+WriteVector(int fd, char **buffers, int numBuffers, int bufSize, int offset)
+{
+    struct iovec *iov = new struct iovec[numBuffers];
+    int retVal;
+
+    for (int i = 0; i < numBuffers; i++) {
+        iov[i].iov_base = buffers[i];
+        iov[i].iov_len = bufSize;
+    }
+    retVal = pwritev(fd, iov, numBuffers, offset);
+    ASSERT(retVal == numBuffers * bufSize);
+    delete [] iov;
+}
+
 //----------------------------------------------------------------------
 // Tell
 // 	Report the current location within an open file.
@@ -416,6 +455,21 @@ Delay(int seconds)
     (void) sleep((unsigned) seconds);
 }
 
+//----------------------------------------------------------------------
+// HostSeconds
+// 	Return the host's wall-clock time, in seconds, to microsecond
+//	resolution.  Only differences between two calls are meaningful.
+//----------------------------------------------------------------------
+
+double
+HostSeconds()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
 //----------------------------------------------------------------------
 // Abort
 // 	Quit and drop core.
@@ -25,6 +25,10 @@ extern void Read(int fd, char *buffer, int nBytes);
 extern int ReadPartial(int fd, char *buffer, int nBytes);
 extern void WriteFile(int fd, char *buffer, int nBytes);
 extern void Lseek(int fd, int offset, int whence);
+extern void ReadVector(int fd, char **buffers, int numBuffers, int bufSize,
+                       int offset);
+extern void WriteVector(int fd, char **buffers, int numBuffers, int bufSize,
+                        int offset);
 extern int Tell(int fd);
 extern void Close(int fd);
 extern bool Unlink(char *name);
@@ -43,6 +47,9 @@ extern void Abort();
 extern void Exit(int exitCode);
 extern void Delay(int seconds);
 
+// Host wall-clock time, for measuring how fast the simulation runs
+extern double HostSeconds();
+
 // Initialize system so that cleanUp routine is called when user hits ctl-C
 extern void CallOnUserAbort(VoidNoArgFunctionPtr cleanUp);
 
@@ -31,6 +31,7 @@
 
 #include "copyright.h"
 #include "machine.h"
+#include "memtrace.h"
 #include "addrspace.h"
 #include "system.h"
 
@@ -74,6 +75,51 @@ ShortToMachine(unsigned short shortword) {
     return ShortToHost(shortword);
 }
 
+//----------------------------------------------------------------------
+// Machine::FlushTranslations
+// 	Empty the translation cache.  Must be called whenever "pageTable"
+//	is pointed at a different table, or the table it points at is
+//	deleted.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushTranslations()
+{
+    for (int i = 0; i < SoftTLBSize; i++)
+        softTLB[i].entry = NULL;
+}
+
+//----------------------------------------------------------------------
+// Machine::CachedTranslate
+// 	Translate a virtual address using only the translation cache.
+//	A hit does everything Translate would have done -- the alignment
+//	and read-only checks, setting the use and dirty bits -- and
+//	returns where the data is in mainMemory.  Anything else (including
+//	every exception) is a miss, and is left to Translate.
+//
+//	"virtAddr" -- the virtual address to translate
+//	"size" -- the amount of memory being read or written
+// 	"writing" -- if TRUE, check the "read-only" bit in the TLB
+//----------------------------------------------------------------------
+
+inline char *
+Machine::CachedTranslate(int virtAddr, int size, bool writing)
+{
+    unsigned int vpn = (unsigned) virtAddr / PageSize;
+    SoftTLBEntry *slot = &softTLB[vpn % SoftTLBSize];
+    TranslationEntry *entry = slot->entry;
+
+    if (entry == NULL || slot->vpn != vpn || (virtAddr & (size - 1))
+            || !entry->valid || entry->physicalPage != slot->frame
+            || (writing && entry->readOnly)
+            || (tlb != NULL && (unsigned) entry->virtualPage != vpn))
+        return NULL;
+    entry->use = TRUE;
+    if (writing)
+        entry->dirty = TRUE;
+    return slot->page + (unsigned) virtAddr % PageSize;
+}
+
 
 //----------------------------------------------------------------------
 // Machine::ReadMem
@@ -94,27 +140,34 @@ Machine::ReadMem(int addr, int size, int *value)
     int data;
     ExceptionType exception;
     int physicalAddress;
+    char *host;
 
     DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
 
-    exception = Translate(addr, &physicalAddress, size, FALSE);
-    if (exception != NoException) {
-        machine->RaiseException(exception, addr);
-        return FALSE;
+    host = useSoftTLB ? CachedTranslate(addr, size, FALSE) : NULL;
+    if (host == NULL) {
+        exception = Translate(addr, &physicalAddress, size, FALSE);
+        if (exception != NoException) {
+            RaiseException(exception, addr);
+            return FALSE;
+        }
+        host = &mainMemory[physicalAddress];
     }
+    if (trace != NULL)
+        trace->Record(traceProcess, addr, TraceRead);
     switch (size) {
     case 1:
-        data = machine->mainMemory[physicalAddress];
+        data = *host;
         *value = data;
         break;
 
     case 2:
-        data = *(unsigned short *) &machine->mainMemory[physicalAddress];
+        data = *(unsigned short *) host;
         *value = ShortToHost(data);
         break;
 
     case 4:
-        data = *(unsigned int *) &machine->mainMemory[physicalAddress];
+        data = *(unsigned int *) host;
         *value = WordToHost(data);
         break;
 
@@ -144,32 +197,43 @@ Machine::WriteMem(int addr, int size, int value)
 {
     ExceptionType exception;
     int physicalAddress;
+    char *host;
 
     DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
 
-    exception = Translate(addr, &physicalAddress, size, TRUE);
-    if (exception != NoException) {
-        machine->RaiseException(exception, addr);
-        return FALSE;
-    }
+    host = useSoftTLB ? CachedTranslate(addr, size, TRUE) : NULL;
+    if (host == NULL) {
+        exception = Translate(addr, &physicalAddress, size, TRUE);
+        if (exception != NoException) {
+            RaiseException(exception, addr);
+            return FALSE;
+        }
+        host = &mainMemory[physicalAddress];
+    } else
+        physicalAddress = host - mainMemory;
+    if (trace != NULL)
+        trace->Record(traceProcess, addr, TraceWrite);
     switch (size) {
     case 1:
-        machine->mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
+        *host = (unsigned char) (value & 0xff);
         break;
 
     case 2:
-        *(unsigned short *) &machine->mainMemory[physicalAddress]
+        *(unsigned short *) host
             = ShortToMachine((unsigned short) (value & 0xffff));
         break;
 
     case 4:
-        *(unsigned int *) &machine->mainMemory[physicalAddress]
-            = WordToMachine((unsigned int) value);
+        *(unsigned int *) host = WordToMachine((unsigned int) value);
         break;
 
     default:
         ASSERT(FALSE);
     }
+    if (decodeValid[physicalAddress / 4]) {	// overwriting code
+        decodeValid[physicalAddress / 4] = FALSE;
+        frameGeneration[physicalAddress / PageSize]++;
+    }
 
     return TRUE;
 }
@@ -196,6 +260,13 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     unsigned int vpn, offset;
     TranslationEntry *entry;
     unsigned int pageFrame;
+    SoftTLBEntry *slot;
+    char *host;
+
+    if (useSoftTLB && (host = CachedTranslate(virtAddr, size, writing)) != NULL) {
+        *physAddr = host - mainMemory;
+        return NoException;
+    }
 
     DEBUG('a', "\tTranslate 0x%x, %s: ", virtAddr, writing ? "write" : "read");
 
@@ -226,7 +297,7 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
         }
         entry = &pageTable[vpn];
     } else {
-        for (entry = NULL, i = 0; i < TLBSize; i++)
+        for (entry = NULL, i = 0; i < tlbSize; i++)
             if (tlb[i].valid && ((unsigned int) tlb[i].virtualPage == vpn)) {
                 entry = &tlb[i];			// FOUND!
                 break;
@@ -247,15 +318,22 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 
     // if the pageFrame is too big, there is something really wrong!
     // An invalid translation was loaded into the page table or TLB.
-    if (pageFrame >= NumPhysPages) {
-        DEBUG('a', "*** frame %d > %d!\n", pageFrame, NumPhysPages);
+    if (pageFrame >= (unsigned) numPhysPages) {
+        DEBUG('a', "*** frame %d > %d!\n", pageFrame, numPhysPages);
         return BusErrorException;
     }
     entry->use = TRUE;		// set the use, dirty bits
     if (writing)
         entry->dirty = TRUE;
     *physAddr = pageFrame * PageSize + offset;
-    ASSERT((*physAddr >= 0) && ((*physAddr + size) <= MemorySize));
+    ASSERT((*physAddr >= 0) && ((*physAddr + size) <= memorySize));
+    if (useSoftTLB) {		// remember it for next time
+        slot = &softTLB[vpn % SoftTLBSize];
+        slot->vpn = vpn;
+        slot->entry = entry;
+        slot->frame = pageFrame;
+        slot->page = &mainMemory[pageFrame * PageSize];
+    }
     DEBUG('a', "phys addr = 0x%x\n", *physAddr);
     return NoException;
 }
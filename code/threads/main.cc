@@ -8,31 +8,56 @@
 //
 // 	Most of this file is not needed until later assignments.
 //
-// Usage: nachos -d <debugflags> -rs <random seed #>
-//		-s -x <nachos file> -c <consoleIn> <consoleOut>
-//		-f -cp <unix file> <nachos file>
-//		-p <nachos file> -r <nachos file> -l -D -t
+// Usage: nachos -d <debugflags> -rs <random seed #> -sp -lp
+//		-s -ndc -be -bc -up <n> -mt <trace file>
+//		-np <frames> -nt <TLB entries>
+//		-ck <checkpoint file> <time>
+//		-x <nachos file> -xk <checkpoint file> -c <consoleIn> <consoleOut>
+//		-f -ds <disk policy> -cp <unix file> <nachos file>
+//		-p <nachos file> -r <nachos file> -md <nachos directory>
+//		-l -D -t -jt
 //              -n <network reliability> -m <machine id>
 //              -o <other machine id>
 //              -z
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
+//    -sp paints thread stacks and reports their deepest usage on exit
+//    -lp reports lock, condition and semaphore contention on exit
 //    -z prints the copyright message
 //
 //  USER_PROGRAM
 //    -s causes user programs to be executed in single-step mode
+//    -ndc decodes every user instruction fetched, without caching
+//    -be runs user programs with the basic block engine (blocksim.cc)
+//    -bc is -be, but also replays every block on the interpreter, and
+//	stops if the results differ
+//    -up profiles user programs, sampling the PC every <n> instructions
+//	(every one, if <n> is 1), and prints the profiles at shutdown
+//    -np sets the number of page frames of main memory (default 32)
+//    -nt sets the number of TLB entries, if there is a TLB (default 4)
+//    -mt writes every user memory reference to a trace file, for
+//	bin/tracesim
+//    -ck writes a checkpoint of the machine at simulated time <time>, or
+//	as soon after as the running program is the only thread
 //    -x runs a user program
+//    -xk runs the user program saved in a checkpoint, from where it was
 //    -c tests the console
 //
 //  FILESYS
 //    -f causes the physical disk to be formatted
+//    -ds sets the order queued disk requests are served in: fcfs (the
+//	default), sstf, scan or clook (see synchdisk.h)
 //    -cp copies a file from UNIX to Nachos
 //    -p prints a Nachos file to stdout
-//    -r removes a Nachos file from the file system
-//    -l lists the contents of the Nachos directory
+//    -r removes a Nachos file (or empty directory) from the file system
+//    -md makes a Nachos directory; Nachos file names are paths, such
+//	as "usr/bin/sort"
+//    -l lists the contents of the Nachos directories
 //    -D prints the contents of the entire file system
 //    -t tests the performance of the Nachos file system
+//    -jt tests that the file system is consistent after crashes, by
+//	formatting the disk again and again (see fstest.cc)
 //
 //  NETWORK
 //    -n sets the network reliability
@@ -62,8 +87,9 @@ int LRU = 0;
 // External functions used by this file
 
 extern void ThreadTest(void), Copy(char *unixFile, char *nachosFile);
-extern void Print(char *file), PerformanceTest(void);
+extern void Print(char *file), PerformanceTest(void), CrashTest(void);
 extern void StartProcess(char *file), ConsoleTest(char *in, char *out);
+extern void RestoreProcess(char *checkpointFile);
 extern void MailTest(int networkID);
 
 //----------------------------------------------------------------------
@@ -118,6 +144,10 @@ main(int argc, char **argv)
             ASSERT(argc > 1);
             StartProcess(*(argv + 1));
             argCount = 2;
+        } else if (!strcmp(*argv, "-xk")) {	// resume from a checkpoint
+            ASSERT(argc > 1);
+            RestoreProcess(*(argv + 1));
+            argCount = 2;
         } else if (!strcmp(*argv, "-c")) {      // test the console
             if (argc == 1)
                 ConsoleTest(NULL, NULL);
@@ -144,12 +174,18 @@ main(int argc, char **argv)
             ASSERT(argc > 1);
             fileSystem->Remove(*(argv + 1));
             argCount = 2;
+        } else if (!strcmp(*argv, "-md")) {	// make a Nachos directory
+            ASSERT(argc > 1);
+            fileSystem->CreateDirectory(*(argv + 1));
+            argCount = 2;
         } else if (!strcmp(*argv, "-l")) {	// list Nachos directory
             fileSystem->List();
         } else if (!strcmp(*argv, "-D")) {	// print entire filesystem
             fileSystem->Print();
         } else if (!strcmp(*argv, "-t")) {	// performance test
             PerformanceTest();
+        } else if (!strcmp(*argv, "-jt")) {	// crash test
+            CrashTest();
         }
 #endif // FILESYS
 #ifdef NETWORK
@@ -68,6 +68,18 @@ Scheduler::ReadyToRun (Thread *thread)
     readyList->SortedInsert(thread,priority);
 }
 
+//----------------------------------------------------------------------
+// Scheduler::IsEmpty
+// 	Return TRUE if no thread is ready to run, other than the one
+//	running now.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::IsEmpty()
+{
+    return readyList->IsEmpty();
+}
+
 //----------------------------------------------------------------------
 // Scheduler::FindNextToRun
 // 	Return the next thread to be scheduled onto the CPU.
@@ -26,6 +26,7 @@ public:
     Thread* FindNextToRun();		// Dequeue first thread on the ready
     // list, if any, and return thread.
     void Run(Thread* nextThread);	// Cause nextThread to start running
+    bool IsEmpty();			// Are no threads waiting to run?
     void Print();			// Print contents of ready list
 
 private:
@@ -25,6 +25,121 @@
 #include "synch.h"
 #include "system.h"
 
+#define MaxSynchProfiles 128		// distinct names we keep statistics on
+
+// Contention statistics for all the semaphores, locks or condition
+// variables of one kind that share a debug name.  Only kept when "-lp"
+// is given, and printed, worst first, by SynchProfileReport.  All times
+// are in simulated ticks.
+struct SynchProfile {
+  char *kind;		// "lock", "condition" or "semaphore"
+  char *name;		// debug name, as passed to the constructor
+  int acquires;		// Acquire()s, Wait()s or P()s
+  int contended;	// how many of those had to go to sleep
+  int totalWait;	// time spent asleep in them
+  int maxWait;		// longest single sleep
+  int totalHold;	// time locks were held, locks only
+  int maxHold;		// longest a lock was held, locks only
+};
+
+static SynchProfile synchProfiles[MaxSynchProfiles];
+static int numSynchProfiles = 0;
+
+
+//----------------------------------------------------------------------
+// GetSynchProfile
+// 	Return the statistics kept for a synchronization object, looking
+//	them up by name the first time.  Objects may be created before the
+//	command line is parsed, so this is done lazily rather than in the
+//	constructors.  Returns NULL if profiling is off, or if there is no
+//	room left for another name.
+//
+//	"cache" is the object's own pointer to its statistics
+//	"kind" and "name" identify the statistics to use
+//----------------------------------------------------------------------
+static SynchProfile *GetSynchProfile(SynchProfile **cache, char *kind,
+                                     char *name) {
+  SynchProfile *prof;
+
+  if (!profileSynch)
+    return NULL;
+  if (*cache != NULL)
+    return *cache;
+  if (name == NULL)
+    name = "(unnamed)";
+
+  for (int i = 0; i < numSynchProfiles; i++) {
+    prof = &synchProfiles[i];
+    if (prof->kind == kind && !strcmp(prof->name, name))
+      return (*cache = prof);
+  }
+
+  if (numSynchProfiles == MaxSynchProfiles)
+    return NULL;
+  prof = &synchProfiles[numSynchProfiles++];
+  prof->kind = kind;
+  prof->name = name;
+  prof->acquires = prof->contended = 0;
+  prof->totalWait = prof->maxWait = 0;
+  prof->totalHold = prof->maxHold = 0;
+  return (*cache = prof);
+}
+
+
+//----------------------------------------------------------------------
+// RecordSynchWait
+// 	Count one Acquire(), Wait() or P() against its statistics.
+//
+//	"prof" is the statistics to update, or NULL if profiling is off
+//	"contended" is whether the caller had to go to sleep
+//	"waited" is how long it slept for
+//----------------------------------------------------------------------
+static void RecordSynchWait(SynchProfile *prof, bool contended, int waited) {
+  if (prof == NULL)
+    return;
+
+  prof->acquires++;
+  if (contended) {
+    prof->contended++;
+    prof->totalWait += waited;
+    prof->maxWait = max(prof->maxWait, waited);
+  }
+}
+
+
+//----------------------------------------------------------------------
+// SynchProfileReport
+// 	Print the contention statistics gathered with "-lp", the names
+//	that threads spent the longest waiting on first.
+//----------------------------------------------------------------------
+void SynchProfileReport() {
+  SynchProfile *sorted[MaxSynchProfiles];
+  SynchProfile *prof;
+  int i, j;
+
+  if (!profileSynch)
+    return;
+
+  for (i = 0; i < numSynchProfiles; i++) {	// insertion sort by wait
+    prof = &synchProfiles[i];
+    for (j = i; j > 0 && sorted[j - 1]->totalWait < prof->totalWait; j--)
+      sorted[j] = sorted[j - 1];
+    sorted[j] = prof;
+  }
+
+  printf("Synchronization contention (ticks), worst first:\n");
+  for (i = 0; i < numSynchProfiles; i++) {
+    prof = sorted[i];
+    printf("  %-9s %-24s acquires %7d, contended %7d, "
+           "wait %9d (max %7d)",
+           prof->kind, prof->name, prof->acquires, prof->contended,
+           prof->totalWait, prof->maxWait);
+    if (prof->totalHold > 0)
+      printf(", held %9d (max %7d)", prof->totalHold, prof->maxHold);
+    printf("\n");
+  }
+}
+
 //----------------------------------------------------------------------
 // Semaphore::Semaphore
 // 	Initialize a semaphore, so that it can be used for synchronization.
@@ -36,6 +151,7 @@ Semaphore::Semaphore(char* debugName, int initialValue) {
   name = debugName;
   value = initialValue;
   queue = new List;
+  profile = NULL;
 }
 
 
@@ -60,6 +176,8 @@ Semaphore::~Semaphore() {
 //----------------------------------------------------------------------
 void Semaphore::P() {
   IntStatus oldLevel = interrupt->SetLevel(IntOff);	// disable interrupts
+  bool contended = (value == 0);
+  int start = stats->totalTicks;
 
   while (value == 0) { 			// semaphore not available
     queue->SortedInsert((void *)currentThread,
@@ -69,6 +187,9 @@ void Semaphore::P() {
   value--; 					// semaphore available,
   // consume its value
 
+  RecordSynchWait(GetSynchProfile(&profile, "semaphore", name), contended,
+                  stats->totalTicks - start);
+
   (void) interrupt->SetLevel(oldLevel);	// re-enable interrupts
 }
 
@@ -92,6 +213,30 @@ void Semaphore::V() {
 }
 
 
+//----------------------------------------------------------------------
+// Semaphore::V
+// 	Do "n" V() operations at once, waking up to "n" waiting threads
+//	with interrupts disabled only once.
+//
+//	"n" is the amount to increment the semaphore value by
+//----------------------------------------------------------------------
+void Semaphore::V(int n) {
+  Thread *thread;
+  IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+  ASSERT(n >= 0);
+
+  for (int i = 0; i < n; i++) {
+    thread = (Thread *)queue->Remove();
+    if (thread == NULL)		// no one else is waiting
+      break;
+    scheduler->ReadyToRun(thread);
+  }
+  value += n;
+  (void) interrupt->SetLevel(oldLevel);
+}
+
+
 //----------------------------------------------------------------------
 //                            P1 Code
 //----------------------------------------------------------------------
@@ -107,6 +252,8 @@ Lock::Lock(char* debugName) {
   locked = 0; // lock is free
   queue = new List;
   threadHeld = 0;
+  profile = NULL;
+  acquiredAt = 0;
 }
 
 
@@ -135,6 +282,9 @@ void Lock::Acquire() {
 
   ASSERT(locked == 0 || !isHeldByCurrentThread()); // deadlock on itself
 
+  bool contended = (locked == 1);
+  int start = stats->totalTicks;
+
   while (locked == 1) { 			// lock is held
     queue->SortedInsert((void *)currentThread,
                       currentThread->getPriority()*-1);	// so go to sleep
@@ -142,6 +292,10 @@ void Lock::Acquire() {
   }
   locked = 1; 					// acquire lock
   threadHeld = currentThread;  // keep track of which thread is locked
+  acquiredAt = stats->totalTicks;
+
+  RecordSynchWait(GetSynchProfile(&profile, "lock", name), contended,
+                  acquiredAt - start);
 
   (void) interrupt->SetLevel(oldLevel);	// re-enable interrupts
 }
@@ -176,6 +330,12 @@ void Lock::Release() {
   ASSERT(locked == 1); // lock must be acquired
   ASSERT(isHeldByCurrentThread()); // only owner of lock can release
 
+  if (profile != NULL) {	// only set while profiling
+    int held = stats->totalTicks - acquiredAt;
+    profile->totalHold += held;
+    profile->maxHold = max(profile->maxHold, held);
+  }
+
   thread = (Thread *)queue->Remove();
 
   if (thread != NULL)	  // make thread ready, consuming the thread immediately
@@ -188,6 +348,146 @@ void Lock::Release() {
 }
 
 
+//----------------------------------------------------------------------
+// ReaderWriterLock::ReaderWriterLock
+// 	Initialize a reader-writer lock, with no holders and no waiters.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+ReaderWriterLock::ReaderWriterLock(char* debugName) {
+  name = debugName;
+  readers = 0;
+  writer = NULL;
+  waitingReaders = 0;
+  waitingWriters = 0;
+  readQueue = new List;
+  writeQueue = new List;
+}
+
+
+//----------------------------------------------------------------------
+// ReaderWriterLock::~ReaderWriterLock
+// 	De-allocate the lock. Panic if it is held or anyone is waiting.
+//----------------------------------------------------------------------
+ReaderWriterLock::~ReaderWriterLock() {
+  ASSERT(readers == 0 && writer == NULL); // cannot delete a held lock
+  ASSERT(readQueue->IsEmpty() && writeQueue->IsEmpty());
+  delete readQueue;
+  delete writeQueue;
+}
+
+
+//----------------------------------------------------------------------
+// ReaderWriterLock::AcquireRead
+//  Disable interrupts for atomicity. If a writer holds the lock, or is
+//  waiting for it, go to sleep until a writer hands the lock over;
+//  otherwise join the readers holding the lock.
+//----------------------------------------------------------------------
+void ReaderWriterLock::AcquireRead() {
+  IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+  ASSERT(writer != currentThread); // deadlock on itself
+
+  if (writer != NULL || waitingWriters > 0) {
+    waitingReaders++;
+    readQueue->SortedInsert((void *)currentThread,
+                            currentThread->getPriority()*-1);
+    currentThread->Sleep();	// "readers" was incremented for us
+  } else {
+    readers++;
+  }
+
+  (void) interrupt->SetLevel(oldLevel);
+}
+
+
+//----------------------------------------------------------------------
+// ReaderWriterLock::ReleaseRead
+//  Leave shared mode. The last reader out hands the lock to the first
+//  waiting writer, if any.
+//
+// Panic if no reader holds the lock.
+//----------------------------------------------------------------------
+void ReaderWriterLock::ReleaseRead() {
+  IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+  ASSERT(readers > 0);
+
+  readers--;
+  if (readers == 0 && waitingWriters > 0) {
+    waitingWriters--;
+    writer = (Thread *)writeQueue->Remove();
+    scheduler->ReadyToRun(writer);
+  }
+
+  (void) interrupt->SetLevel(oldLevel);
+}
+
+
+//----------------------------------------------------------------------
+// ReaderWriterLock::AcquireWrite
+//  Disable interrupts for atomicity. If anyone holds the lock, go to
+//  sleep until the lock is handed over; otherwise take it.
+//
+// Panic if the thread already holds the lock in exclusive mode.
+//----------------------------------------------------------------------
+void ReaderWriterLock::AcquireWrite() {
+  IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+  ASSERT(writer != currentThread); // deadlock on itself
+
+  if (writer != NULL || readers > 0) {
+    waitingWriters++;
+    writeQueue->SortedInsert((void *)currentThread,
+                             currentThread->getPriority()*-1);
+    currentThread->Sleep();	// "writer" was set to us
+  } else {
+    writer = currentThread;
+  }
+
+  ASSERT(writer == currentThread);
+  (void) interrupt->SetLevel(oldLevel);
+}
+
+
+//----------------------------------------------------------------------
+// ReaderWriterLock::ReleaseWrite
+//  Leave exclusive mode. Hand the lock to the next waiting writer; if
+//  there are none, wake up every waiting reader in one batch.
+//
+// Panic if the caller is not the writer holding the lock.
+//----------------------------------------------------------------------
+void ReaderWriterLock::ReleaseWrite() {
+  Thread *thread;
+  IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+  ASSERT(isWriteHeldByCurrentThread()); // only owner of lock can release
+
+  writer = NULL;
+  if (waitingWriters > 0) {		// writers are preferred
+    waitingWriters--;
+    writer = (Thread *)writeQueue->Remove();
+    scheduler->ReadyToRun(writer);
+  } else if (waitingReaders > 0) {	// let all the readers in at once
+    readers += waitingReaders;
+    waitingReaders = 0;
+    while ((thread = (Thread *)readQueue->Remove()) != NULL)
+      scheduler->ReadyToRun(thread);
+  }
+
+  (void) interrupt->SetLevel(oldLevel);
+}
+
+
+//----------------------------------------------------------------------
+// bool ReaderWriterLock::isWriteHeldByCurrentThread
+// Return true if the caller holds the lock in exclusive mode.
+//----------------------------------------------------------------------
+bool ReaderWriterLock::isWriteHeldByCurrentThread() {
+  return currentThread == writer;
+}
+
+
 //----------------------------------------------------------------------
 // Condition::Condition
 // Initialize condition with no waiting threads.
@@ -197,6 +497,7 @@ void Lock::Release() {
 Condition::Condition(char* debugName) {
   name = debugName;
   waitQ = new List;
+  profile = NULL;
 }
 
 
@@ -230,12 +531,16 @@ void Condition::Wait(Lock* conditionLock) {
 
   conditionLock->Release(); // release the lock
 
+  int start = stats->totalTicks;
 
   waitQ->SortedInsert((void *)currentThread,
                       currentThread->getPriority()*-1);	// so go to sleep
 
   currentThread->Sleep(); // suspend execution of thread
 
+  RecordSynchWait(GetSynchProfile(&profile, "condition", name), TRUE,
+                  stats->totalTicks - start);
+
   (void) interrupt->SetLevel(oldLevel); // re-enable interrupts
 
   conditionLock->Acquire(); // acquire the lock again
@@ -465,8 +770,13 @@ void Whale::Matchmaker() {
 //
 // "debugName" some name to be associated with mailbox instance
 //  useful for debugging
+// "maxQueued" the number of messages that can be queued, or 0 for a
+//  mailbox where every Send waits for a matching Receive
 //----------------------------------------------------------------------
-Mailbox::Mailbox(char * debugName) {
+Mailbox::Mailbox(char * debugName, int maxQueued) {
+  ASSERT(maxQueued >= 0);
+
+  name = debugName;
   lock = new Lock("MailBox Lock");//Lock associated with class
   sendWait = new Condition("Send CV");//Condition associated with send
   receiveWait = new Condition("receive Wait");//Condition associated with rec
@@ -474,6 +784,12 @@ Mailbox::Mailbox(char * debugName) {
   receivePres=0;//Number of receive calls that have been made
   bufferRead = 0;//Indicate that buffer is not being used
   buffer = 0;//Actual buffer to be used
+  sendPres = 0;//Number of send calls waiting
+
+  capacity = maxQueued;
+  ring = (capacity > 0) ? new int[capacity] : NULL;
+  head = 0;
+  count = 0;
 }
 
 
@@ -488,24 +804,29 @@ Mailbox::~Mailbox() {
   delete lock;
   delete sendWait;
   delete receiveWait;
+  delete [] ring;
 }
 
 
 //----------------------------------------------------------------------
-// Mailbox::Send
-// Acquire lock, wait if buffer is currently in use or no recieve calls
-// have been made.Else place message in the buffer,indicate that buffer
-// is being used and then alert recieve calls via signal.Release lock.
+// Mailbox::RendezvousSend
+// Wait if buffer is currently in use or no recieve calls have been
+// made.Else place message in the buffer,indicate that buffer is being
+// used and then alert recieve calls via signal.
+//
+// Panic if the caller does not hold the lock.
 //
 // "message" the message to be passed.
 //----------------------------------------------------------------------
-void Mailbox::Send(int message) {
-  lock->Acquire();
+void Mailbox::RendezvousSend(int message) {
+  ASSERT(lock->isHeldByCurrentThread());
 
   //wait while buffer is being used or if no receive calls have been made
+  sendPres++;
   while(bufferRead==1 ||receivePres<=0) {
     sendWait->Wait(lock); 
   }
+  sendPres--;
 
   //Place message into the buffer
   buffer = message;
@@ -514,25 +835,24 @@ void Mailbox::Send(int message) {
 
   //Alert receive calls to possible match
   receiveWait->Signal(lock);
-
-  lock->Release();
 }
 
 
 //----------------------------------------------------------------------
-// Mailbox::Receive 
-// Acquire lock.Increment variable associated with number of receive 
-// calls that have been made.Alert send calls of the arrival of a 
-// receive call. Wait while no message is in the buffer.Once message
-// is in the internal buffer,place the message into the buffer passed
-// in as parameter.Indicate that message has been passed on and decrment
-// the number of receive calls that can be paired with.Release lock.
+// Mailbox::RendezvousReceive
+// Increment variable associated with number of receive calls that have
+// been made.Alert send calls of the arrival of a receive call. Wait
+// while no message is in the buffer.Once message is in the internal
+// buffer,place the message into the buffer passed in as parameter.
+// Indicate that message has been passed on and decrment the number of
+// receive calls that can be paired with.
 //
+// Panic if the caller does not hold the lock.
 //
 // "message" pointer to external method that message will be passed into.
 //----------------------------------------------------------------------
-void Mailbox::Receive(int * message) {
-  lock->Acquire();
+void Mailbox::RendezvousReceive(int * message) {
+  ASSERT(lock->isHeldByCurrentThread());
 
   receivePres++;//Number of receive calls to match with increases
   sendWait->Signal(lock);//Alert senders to arrival of new receives
@@ -547,6 +867,191 @@ void Mailbox::Receive(int * message) {
   buffer = 0;
   bufferRead = 0;
   receivePres--;///decrment number of availible receive calls
+}
+
+
+//----------------------------------------------------------------------
+// Mailbox::Send
+// Acquire lock. On a rendezvous mailbox wait for a receive call and
+// hand it the message. Otherwise wait while the ring is full, queue
+// the message and alert a receive call. Release lock.
+//
+// "message" the message to be passed.
+//----------------------------------------------------------------------
+void Mailbox::Send(int message) {
+  lock->Acquire();
+
+  if(capacity == 0) {
+    RendezvousSend(message);
+  } else {
+    while(count == capacity) {
+      sendWait->Wait(lock);
+    }
+    ring[(head + count) % capacity] = message;
+    count++;
+    receiveWait->Signal(lock);
+  }
+
+  lock->Release();
+}
+
+
+//----------------------------------------------------------------------
+// Mailbox::Receive 
+// Acquire lock. On a rendezvous mailbox wait for a send call to hand
+// over its message. Otherwise wait while the ring is empty, take the
+// oldest message and alert a send call. Release lock.
+//
+// "message" pointer to external method that message will be passed into.
+//----------------------------------------------------------------------
+void Mailbox::Receive(int * message) {
+  lock->Acquire();
+
+  if(capacity == 0) {
+    RendezvousReceive(message);
+  } else {
+    while(count == 0) {
+      receiveWait->Wait(lock);
+    }
+    *message = ring[head];
+    head = (head + 1) % capacity;
+    count--;
+    sendWait->Signal(lock);
+  }
+
+  lock->Release();
+}
+
+
+//----------------------------------------------------------------------
+// Mailbox::TrySend
+// Send the message only if that can be done without waiting: there is
+// a free slot in the ring, or, on a rendezvous mailbox, a receive call
+// is waiting that no other send call has been matched with.
+//
+// "message" the message to be passed.
+//
+// Return value is TRUE if the message was sent, FALSE otherwise.
+//----------------------------------------------------------------------
+bool Mailbox::TrySend(int message) {
+  bool sent = FALSE;
+
+  lock->Acquire();
+
+  if(capacity == 0) {
+    if(bufferRead == 0 && receivePres > sendPres) {
+      RendezvousSend(message);//will not wait
+      sent = TRUE;
+    }
+  } else if(count < capacity) {
+    ring[(head + count) % capacity] = message;
+    count++;
+    receiveWait->Signal(lock);
+    sent = TRUE;
+  }
+
+  lock->Release();
+  return sent;
+}
+
+
+//----------------------------------------------------------------------
+// Mailbox::TryReceive
+// Receive a message only if one is available: the ring is not empty,
+// or, on a rendezvous mailbox, a send call is waiting that no other
+// receive call has been matched with. In the latter case we may still
+// have to wait for that send call to run, but never for one to arrive.
+//
+// "message" pointer to external method that message will be passed into.
+//
+// Return value is TRUE if a message was received, FALSE otherwise.
+//----------------------------------------------------------------------
+bool Mailbox::TryReceive(int * message) {
+  bool received = FALSE;
+
+  lock->Acquire();
+
+  if(capacity == 0) {
+    if(sendPres > receivePres) {
+      RendezvousReceive(message);
+      received = TRUE;
+    }
+  } else if(count > 0) {
+    *message = ring[head];
+    head = (head + 1) % capacity;
+    count--;
+    sendWait->Signal(lock);
+    received = TRUE;
+  }
+
+  lock->Release();
+  return received;
+}
+
+
+//----------------------------------------------------------------------
+// Mailbox::SendMany
+// Acquire lock once and send every message, in order. When the ring
+// fills up, wait for room, then queue as many messages as fit at once
+// and alert all receive calls.
+//
+// "messages" the messages to be passed
+// "n" how many messages there are
+//----------------------------------------------------------------------
+void Mailbox::SendMany(int * messages, int n) {
+  int sent = 0;
+
+  lock->Acquire();
+
+  if(capacity == 0) {
+    for(; sent < n; sent++)
+      RendezvousSend(messages[sent]);
+  } else {
+    while(sent < n) {
+      while(count == capacity) {
+        sendWait->Wait(lock);
+      }
+      for(; sent < n && count < capacity; sent++, count++)
+        ring[(head + count) % capacity] = messages[sent];
+      receiveWait->Broadcast(lock);
+    }
+  }
+
+  lock->Release();
+}
+
+
+//----------------------------------------------------------------------
+// Mailbox::ReceiveMany
+// Acquire lock once, wait for at least one message and take as many as
+// are queued, up to "max", alerting all send calls of the free room.
+// A rendezvous mailbox has at most one message to take.
+//
+// "messages" buffer the messages will be passed into
+// "max" the size of that buffer
+//
+// Return value is the number of messages received.
+//----------------------------------------------------------------------
+int Mailbox::ReceiveMany(int * messages, int max) {
+  int received = 0;
+
+  ASSERT(max > 0);
+  lock->Acquire();
+
+  if(capacity == 0) {
+    RendezvousReceive(messages);
+    received = 1;
+  } else {
+    while(count == 0) {
+      receiveWait->Wait(lock);
+    }
+    for(; received < max && count > 0; received++, count--) {
+      messages[received] = ring[head];
+      head = (head + 1) % capacity;
+    }
+    sendWait->Broadcast(lock);
+  }
 
   lock->Release();
+  return received;
 }
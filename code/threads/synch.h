@@ -21,6 +21,10 @@
 #include "thread.h"
 #include "list.h"
 
+struct SynchProfile;		// contention statistics for one name, "-lp"
+
+extern void SynchProfileReport();	// print the contention statistics
+
 // The following class defines a "semaphore" whose value is a non-negative
 // integer.  The semaphore has only two operations P() and V():
 //
@@ -46,11 +50,13 @@ public:
 
     void P();	 // these are the only operations on a semaphore
     void V();	 // they are both *atomic*
+    void V(int n); // n V()'s at once, waking up to n waiters
 
 private:
     char* name;        // useful for debugging
     int value;         // semaphore value, always >= 0
     List *queue;       // threads waiting in P() for the value to be > 0
+    SynchProfile *profile; // statistics for this name, if "-lp" is on
 };
 
 // The following class defines a "lock".  A lock can be BUSY or FREE.
@@ -89,6 +95,58 @@ private:
     Thread * threadHeld; // pointer to currently held thread
     List *queue;  // threads waiting on lock for the locked value to be free
     int donate; // For priority donation
+    SynchProfile *profile; // statistics for this name, if "-lp" is on
+    int acquiredAt; // totalTicks when the holder got the lock
+};
+
+// The following class defines a "reader-writer lock".  Any number of
+// readers may hold the lock at once, or a single writer may hold it
+// alone.  The operations are:
+//
+//	AcquireRead -- wait until no writer holds or is waiting for the
+//		lock, then hold it in shared mode
+//
+//	ReleaseRead -- give up shared mode; the last reader out hands the
+//		lock to a waiting writer, if there is one
+//
+//	AcquireWrite -- wait until no one holds the lock, then hold it
+//		in exclusive mode
+//
+//	ReleaseWrite -- give up exclusive mode, handing the lock to the
+//		next waiting writer or, if there is none, to *all* waiting
+//		readers at once
+//
+// Writers are preferred: once a writer is waiting, new readers queue
+// behind it, so a steady stream of readers cannot starve writers.  The
+// lock is handed directly to the threads it wakes up, so a woken thread
+// never has to re-check and go back to sleep.  Like Lock, it may only
+// be released by a thread that holds it.
+
+class ReaderWriterLock {
+public:
+    ReaderWriterLock(char* debugName);	// initialize lock to be FREE
+    ~ReaderWriterLock();		// deallocate lock
+    char* getName() {
+        return name;    // debugging assist
+    }
+
+    void AcquireRead();		// shared mode
+    void ReleaseRead();
+    void AcquireWrite();	// exclusive mode
+    void ReleaseWrite();
+
+    bool isWriteHeldByCurrentThread();	// true if the current thread
+    // holds this lock in exclusive mode
+
+private:
+    char* name;				// for debugging
+
+    int readers;			// number of readers holding the lock
+    Thread *writer;			// writer holding the lock, or NULL
+    int waitingReaders;			// threads sleeping in AcquireRead
+    int waitingWriters;			// threads sleeping in AcquireWrite
+    List *readQueue;			// readers waiting for the lock
+    List *writeQueue;			// writers waiting for the lock
 };
 
 // The following class defines a "condition variable".  A condition
@@ -143,6 +201,7 @@ public:
 private:
     char* name; //debug
     List * waitQ;//queue of threads that have been put to sleep.
+    SynchProfile *profile; // statistics for this name, if "-lp" is on
 };
 
 
@@ -229,11 +288,25 @@ private:
 //  be at least one corresponding call to the other method. This 
 //  implementation does not pair up any calls s it simply waits for
 //  each of the methods to be called once.
+//
+//  A Mailbox created with a "capacity" greater than 0 is instead
+//  bounded: messages are queued in a ring buffer of that many slots,
+//  Send only waits while the ring is full and Receive only waits while
+//  it is empty. Messages are received in the order they were sent.
+//
+//  TrySend/TryReceive never wait for the other side to arrive; they
+//  return FALSE instead. On a rendezvous Mailbox they only succeed if a
+//  matching Receive/Send is already waiting.
+//
+//  SendMany/ReceiveMany move a batch of messages per lock acquisition.
+//  SendMany returns once every message has been sent; ReceiveMany
+//  waits for at least one message and takes as many as are queued, up
+//  to "max". On a rendezvous Mailbox ReceiveMany takes one at a time.
 class Mailbox {
 
 public:
-  Mailbox(char* debugName);//Initialize the mailbox to no recievers or
-                           //senders
+  Mailbox(char* debugName, int maxQueued=0);//Initialize the mailbox to no
+                           //recievers or senders, 0 maxQueued = rendezvous
 
   ~Mailbox();//Deallocate the mailbox
   void Send(int message);//Waits until Receive is called then copies message
@@ -242,6 +315,14 @@ public:
   void Receive(int * message);//Waits until Send is called and that Send has
                               //
 
+  bool TrySend(int message);//Send without waiting, FALSE if it would wait
+  bool TryReceive(int * message);//Receive without waiting, FALSE if it
+                                 //would wait
+
+  void SendMany(int * messages, int n);//Send "n" messages in order
+  int ReceiveMany(int * messages, int max);//Receive 1 to "max" messages,
+                                           //returns how many
+
 private:
   char * name;//Debug name
 
@@ -253,6 +334,15 @@ private:
   int receivePres;//number of receive calls that have been made
   int  buffer;//buffer will allow transfer between sends and recieves
   int bufferRead;//indicates if buffer is occupied
+  int sendPres;//number of send calls waiting for a receive
+
+  int capacity;//slots in the ring, 0 for a rendezvous mailbox
+  int * ring;//queued messages, when capacity > 0
+  int head;//slot of the oldest queued message
+  int count;//number of queued messages
+
+  void RendezvousSend(int message);//Send/Receive for capacity 0, with
+  void RendezvousReceive(int * message);//the lock already held
 };
 
 #endif // SYNCH_H
@@ -7,6 +7,7 @@
 
 #include "copyright.h"
 #include "system.h"
+#include "synch.h"
 
 // This defines *all* of the global data structures used by Nachos.
 // These are all initialized and de-allocated by this file.
@@ -18,6 +19,10 @@ Interrupt *interrupt;			// interrupt status
 Statistics *stats;			// performance metrics
 Timer *timer;				// the hardware timer device,
 // for invoking context switches
+bool paintStacks;			// paint thread stacks, and report
+// the deepest usage at Cleanup
+bool profileSynch;			// keep lock contention statistics,
+// and report them at Cleanup
 
 #ifdef FILESYS_NEEDED
 FileSystem  *fileSystem;
@@ -25,10 +30,13 @@ FileSystem  *fileSystem;
 
 #ifdef FILESYS
 SynchDisk   *synchDisk;
+BufferCache *bufferCache;
+Journal     *journal;
 #endif
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
 Machine *machine;	// user program memory and registers
+Profiler *profiler;	// user program profiles, or NULL
 #endif
 
 #ifdef NETWORK
@@ -83,10 +91,22 @@ Initialize(int argc, char **argv)
 
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
+    bool decodeCache = TRUE;		// cache decoded user instructions
+    bool blockEngine = FALSE;		// run user programs a block at a time
+    bool checkBlocks = FALSE;		// check the block engine as it runs
+    int profileInterval = 0;		// sample every this many instructions
+    char *traceFile = NULL;		// record memory references here
+    int physPages = DefaultPhysPages;	// frames of main memory
+    int tlbEntries = DefaultTLBSize;	// entries in the TLB, if any
+    char *checkpointFile = NULL;	// write a checkpoint here,
+    int checkpointTime = 0;		// at this time
 #endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
 #endif
+#ifdef FILESYS
+    DiskPolicy diskPolicy = DiskFCFS;	// order of queued disk requests
+#endif
 #ifdef NETWORK
     double rely = 1;		// network reliability
     int netname = 0;		// UNIX socket name
@@ -107,15 +127,63 @@ Initialize(int argc, char **argv)
             // number generator
             randomYield = TRUE;
             argCount = 2;
+        } else if (!strcmp(*argv, "-sp")) {
+            paintStacks = TRUE;		// measure stack usage
+        } else if (!strcmp(*argv, "-lp")) {
+            profileSynch = TRUE;	// measure lock contention
         }
 #ifdef USER_PROGRAM
         if (!strcmp(*argv, "-s"))
             debugUserProg = TRUE;
+        else if (!strcmp(*argv, "-ndc"))
+            decodeCache = FALSE;
+        else if (!strcmp(*argv, "-be"))
+            blockEngine = TRUE;
+        else if (!strcmp(*argv, "-bc"))
+            blockEngine = checkBlocks = TRUE;
+        else if (!strcmp(*argv, "-np")) {
+            ASSERT(argc > 1);
+            physPages = atoi(*(argv + 1));	// size of main memory
+            ASSERT(physPages > 0);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-nt")) {
+            ASSERT(argc > 1);
+            tlbEntries = atoi(*(argv + 1));	// size of the TLB
+            ASSERT(tlbEntries > 0);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-mt")) {
+            ASSERT(argc > 1);
+            traceFile = *(argv + 1);	// trace memory references
+            argCount = 2;
+        } else if (!strcmp(*argv, "-ck")) {
+            ASSERT(argc > 2);
+            checkpointFile = *(argv + 1);	// checkpoint the machine
+            checkpointTime = atoi(*(argv + 2));
+            argCount = 3;
+        } else if (!strcmp(*argv, "-up")) {
+            ASSERT(argc > 1);
+            profileInterval = atoi(*(argv + 1));	// profile user programs
+            argCount = 2;
+        }
 #endif
 #ifdef FILESYS_NEEDED
         if (!strcmp(*argv, "-f"))
             format = TRUE;
 #endif
+#ifdef FILESYS
+        if (!strcmp(*argv, "-ds")) {
+            ASSERT(argc > 1);
+            if (!strcmp(*(argv + 1), "sstf"))
+                diskPolicy = DiskSSTF;
+            else if (!strcmp(*(argv + 1), "scan"))
+                diskPolicy = DiskSCAN;
+            else if (!strcmp(*(argv + 1), "clook"))
+                diskPolicy = DiskCLOOK;
+            else
+                ASSERT(!strcmp(*(argv + 1), "fcfs"));
+            argCount = 2;
+        }
+#endif
 #ifdef NETWORK
         if (!strcmp(*argv, "-l")) {
             ASSERT(argc > 1);
@@ -148,11 +216,21 @@ Initialize(int argc, char **argv)
     CallOnUserAbort(Cleanup);			// if user hits ctl-C
 
 #ifdef USER_PROGRAM
-    machine = new Machine(debugUserProg);	// this must come first
+    machine = new Machine(debugUserProg, physPages, tlbEntries);
+    // this must come first
+    machine->useDecodeCache = decodeCache;
+    machine->useBlockEngine = blockEngine;
+    machine->checkBlocks = checkBlocks;
+    profiler = (profileInterval > 0) ? new Profiler(profileInterval) : NULL;
+    if (traceFile != NULL)
+        machine->trace = new MemoryTrace(traceFile);
+    if (checkpointFile != NULL)
+        ScheduleCheckpoint(checkpointFile, checkpointTime);
 #endif
 
 #ifdef FILESYS
-    synchDisk = new SynchDisk("DISK");
+    synchDisk = new SynchDisk("DISK", diskPolicy);
+    bufferCache = new BufferCache(NumCacheBuffers);
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -173,11 +251,17 @@ Cleanup()
 {
     printf("\nCleaning up...\n");
     stats->Print();
+    StackUsageReport();
+    SynchProfileReport();
 #ifdef NETWORK
     delete postOffice;
 #endif
 
 #ifdef USER_PROGRAM
+    if (profiler != NULL) {
+        profiler->Print();
+        delete profiler;
+    }
     delete machine;
 #endif
 
@@ -186,6 +270,7 @@ Cleanup()
 #endif
 
 #ifdef FILESYS
+    delete bufferCache;
     delete synchDisk;
 #endif
 
@@ -28,10 +28,16 @@ extern Scheduler *scheduler;			// the ready list
 extern Interrupt *interrupt;			// interrupt status
 extern Statistics *stats;			// performance metrics
 extern Timer *timer;				// the hardware alarm clock
+extern bool paintStacks;			// measure thread stack usage
+extern bool profileSynch;			// measure lock contention
 
 #ifdef USER_PROGRAM
 #include "machine.h"
+#include "profile.h"
+#include "memtrace.h"
+#include "checkpoint.h"
 extern Machine* machine;	// user program memory and registers
+extern Profiler *profiler;	// user program profiles ("-up"), or NULL
 #endif
 
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
@@ -41,7 +47,12 @@ extern FileSystem  *fileSystem;
 
 #ifdef FILESYS
 #include "synchdisk.h"
+#include "bufcache.h"
+#include "journal.h"
 extern SynchDisk   *synchDisk;
+extern BufferCache *bufferCache;	// every sector the file system uses
+extern Journal     *journal;		// the file system's metadata log,
+					// once it is mounted
 #endif
 
 #ifdef NETWORK
@@ -24,6 +24,26 @@
 // execution stack, for detecting
 // stack overflows
 
+#define STACK_PAINT 0xcafebabe		// fills unused stack words when
+// stacks are painted ("-sp"), so the
+// deepest usage can be measured
+
+#define MaxStackRecords 64		// distinct thread names we report on
+
+// The deepest stack usage seen for all threads with the same name.
+// Filled in as threads are destroyed, and printed by StackUsageReport.
+struct StackRecord {
+  char *name;		// thread name, as passed to the constructor
+  int threads;		// number of threads measured
+  int size;		// largest stack allocated, in words
+  int maxUsed;		// deepest usage seen, in words
+};
+
+static StackRecord stackRecords[MaxStackRecords];
+static int numStackRecords = 0;
+
+static void RecordStackUsage(char *threadName, int size, int used);
+
 //----------------------------------------------------------------------
 // Thread::Thread
 // 	Initialize a thread control block, so that we can then call
@@ -32,12 +52,16 @@
 //	"threadName" is an arbitrary string, useful for debugging.
 //	"Pjoin" is an int value that indicates if a thread can be joined.
 //	 0 indicates that it cannot and non-zero indicates that it can
+//	"stackWords" is the size of the execution stack to allocate on
+//	 Fork, in words.  Small helper threads can ask for less than the
+//	 default StackSize; it is never less than MinStackSize.
 //----------------------------------------------------------------------
 
-Thread::Thread(char* threadName, int Pjoin) {
+Thread::Thread(char* threadName, int Pjoin, int stackWords) {
   name = threadName;
   stackTop = NULL;
   stack = NULL;
+  stackSize = max(stackWords, MinStackSize);
   status = JUST_CREATED;
 #ifdef USER_PROGRAM
   space = NULL;
@@ -79,8 +103,11 @@ Thread::~Thread() {
   DEBUG('t', "Deleting thread \"%s\"\n", name);
 
   ASSERT(this != currentThread);
-  if (stack != NULL)
-    DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+  if (stack != NULL) {
+    if (paintStacks)
+      RecordStackUsage(name, stackSize, StackHighWater());
+    DeallocBoundedArray((char *) stack, stackSize * sizeof(int));
+  }
 
   delete lock;
   delete cv;
@@ -137,13 +164,100 @@ void Thread::Fork(VoidFunctionPtr func, int arg) {
 void Thread::CheckOverflow() {
   if (stack != NULL)
 #ifdef HOST_SNAKE			// Stacks grow upward on the Snakes
-    ASSERT(stack[StackSize - 1] == STACK_FENCEPOST);
+    ASSERT(stack[stackSize - 1] == STACK_FENCEPOST);
 #else
   ASSERT((int) *stack == (int) STACK_FENCEPOST);
 #endif
 }
 
 
+//----------------------------------------------------------------------
+// Thread::StackHighWater
+// 	Return the deepest this thread's stack has ever grown, in words.
+//	Found by scanning in from the far end of the stack for the first
+//	word that no longer holds STACK_PAINT.
+//
+//	Only meaningful if the stack was painted when it was allocated
+//	("-sp"); otherwise, and for the main thread (whose stack we did
+//	not allocate), returns 0.
+//----------------------------------------------------------------------
+int Thread::StackHighWater() {
+  int i;
+
+  if (stack == NULL || !paintStacks)
+    return 0;
+
+#ifdef HOST_SNAKE
+  for (i = stackSize - 2; i > 0 && stack[i] == (int) STACK_PAINT; i--)
+    ;
+  return i + 1;
+#else
+  for (i = 1; i < stackSize && stack[i] == (int) STACK_PAINT; i++)
+    ;
+  return stackSize - i;
+#endif
+}
+
+
+//----------------------------------------------------------------------
+// RecordStackUsage
+// 	Fold the stack usage of one thread into the record kept for all
+//	threads of the same name.  Names beyond MaxStackRecords are
+//	silently dropped.
+//
+//	"threadName" is the name of the thread being measured
+//	"size" is the size of its stack, in words
+//	"used" is the deepest usage of its stack, in words
+//----------------------------------------------------------------------
+static void RecordStackUsage(char *threadName, int size, int used) {
+  StackRecord *rec = NULL;
+
+  for (int i = 0; i < numStackRecords; i++) {
+    if (!strcmp(stackRecords[i].name, threadName)) {
+      rec = &stackRecords[i];
+      break;
+    }
+  }
+
+  if (rec == NULL) {
+    if (numStackRecords == MaxStackRecords)
+      return;
+    rec = &stackRecords[numStackRecords++];
+    rec->name = threadName;
+    rec->threads = rec->size = rec->maxUsed = 0;
+  }
+
+  rec->threads++;
+  rec->size = max(rec->size, size);
+  rec->maxUsed = max(rec->maxUsed, used);
+}
+
+
+//----------------------------------------------------------------------
+// StackUsageReport
+// 	Print the deepest stack usage seen for each thread name, so
+//	that stack sizes can be trimmed for threads that don't need the
+//	default.  The current thread hasn't been destroyed yet, so it is
+//	measured here.
+//----------------------------------------------------------------------
+void StackUsageReport() {
+  if (!paintStacks)
+    return;
+
+  if (currentThread != NULL && currentThread->StackHighWater() > 0)
+    RecordStackUsage(currentThread->getName(),
+                     currentThread->getStackSize(),
+                     currentThread->StackHighWater());
+
+  printf("Stack usage (words):\n");
+  for (int i = 0; i < numStackRecords; i++)
+    printf("  %-24s threads %5d, size %6d, deepest %6d (%d%%)\n",
+           stackRecords[i].name, stackRecords[i].threads,
+           stackRecords[i].size, stackRecords[i].maxUsed,
+           (100 * stackRecords[i].maxUsed) / stackRecords[i].size);
+}
+
+
 //----------------------------------------------------------------------
 // Thread::Finish
 // 	Called by ThreadRoot when a thread is done executing the
@@ -448,19 +562,24 @@ void ThreadPrint(int arg) {
 //	"arg" is the parameter to be passed to the procedure
 //----------------------------------------------------------------------
 void Thread::StackAllocate (VoidFunctionPtr func, int arg) {
-  stack = (int *) AllocBoundedArray(StackSize * sizeof(int));
+  stack = (int *) AllocBoundedArray(stackSize * sizeof(int));
+
+  if (paintStacks) {		// so StackHighWater can find the deepest use
+    for (int i = 0; i < stackSize; i++)
+      stack[i] = STACK_PAINT;
+  }
 
 #ifdef HOST_SNAKE
   // HP stack works from low addresses to high addresses
   stackTop = stack + 16;	// HP requires 64-byte frame marker
-  stack[StackSize - 1] = STACK_FENCEPOST;
+  stack[stackSize - 1] = STACK_FENCEPOST;
 #else
   // i386 & MIPS & SPARC stack works from high addresses to low addresses
 #ifdef HOST_SPARC
   // SPARC stack must contains at least 1 activation record to start with.
-  stackTop = stack + StackSize - 96;
+  stackTop = stack + stackSize - 96;
 #else  // HOST_MIPS  || HOST_i386
-  stackTop = stack + StackSize - 4;	// -4 to be on the safe side!
+  stackTop = stack + stackSize - 4;	// -4 to be on the safe side!
 #ifdef HOST_i386
   // the 80386 passes the return address on the stack.  In order for
   // SWITCH() to go to ThreadRoot when we switch to this thread, the
@@ -511,6 +630,7 @@ void Thread::RestoreUserState() {
   }
   machine->pageTable = currentThread->space->getPageTable();
   machine->pageTableSize = currentThread->space->getNumPages();
+  machine->FlushTranslations();
 }
 
 #endif
@@ -24,7 +24,11 @@
 //	that your thread stacks are too small.)
 //
 //	One thing to try if you find yourself with seg faults is to
-//	increase the size of thread stack -- ThreadStackSize.
+//	increase the size of thread stack -- ThreadStackSize.  The size
+//	can also be chosen per thread, when the Thread is constructed;
+//	running with "-sp" paints every stack and reports the deepest
+//	usage seen for each thread name at Cleanup(), which tells you
+//	how small a given kind of thread can safely be made.
 //
 //  	In this interface, forking a thread takes two steps.
 //	We must first allocate a data structure for it: "t = new Thread".
@@ -54,7 +58,8 @@
 
 // Size of the thread's private execution stack.
 // WATCH OUT IF THIS ISN'T BIG ENOUGH!!!!!
-#define StackSize	(4 * 1024)	// in words
+#define StackSize	(4 * 1024)	// in words, the default
+#define MinStackSize	256		// in words, smallest we will allocate
 
 
 // Thread state
@@ -90,7 +95,9 @@ private:
     int machineState[MachineStateSize];  // all registers except for stackTop
 
 public:
-    Thread(char* debugName, int join=0);		// initialize a Thread
+    Thread(char* debugName, int join=0, int stackWords=StackSize);
+    // initialize a Thread, with a
+    // stack of "stackWords" words
 
     ~Thread(); 				// deallocate a Thread
     // NOTE -- thread being deleted
@@ -108,6 +115,11 @@ public:
 
     void CheckOverflow();   			// Check if thread has
     // overflowed its stack
+    int StackHighWater();			// Deepest stack usage so far,
+    // in words (needs "-sp")
+    int getStackSize() {
+        return stackSize;
+    }
     void setStatus(ThreadStatus st) {
         status = st;
     }
@@ -156,6 +168,7 @@ private:
     int* stack; 	 		// Bottom of the stack
     // NULL if this is the main thread
     // (If NULL, don't deallocate stack)
+    int stackSize;			// Size of "stack", in words
     ThreadStatus status;		// ready, running or blocked
     char* name;
     int priority;  // priority of running of the threads
@@ -211,6 +224,10 @@ public:
 #endif
 };
 
+// Print the deepest stack usage recorded for each thread name.
+// Only meaningful when stacks are painted ("-sp"); called from Cleanup().
+extern void StackUsageReport();
+
 // Magical machine-dependent routines, defined in switch.s
 
 extern "C" {
@@ -1373,6 +1373,362 @@ void WhaleDeleteEmpty() {
 }
 
 
+//----------------------------------------------------------------------
+// ReaderWriterLock tests
+//----------------------------------------------------------------------
+#define RWReaders     8    // reader threads in the contention benchmark
+#define RWWriters     2    // writer threads in the contention benchmark
+#define RWIterations  20   // critical sections entered by each thread
+#define RWHoldYields  3    // yields while holding the lock, to simulate work
+
+ReaderWriterLock * rwLock;  // lock under test, or NULL to use rwPlainLock
+Lock * rwPlainLock;         // exclusive lock to compare against
+Semaphore * rwDone;         // V'ed by each benchmark thread when done
+int rwInside;               // readers inside the critical section now
+int rwMaxInside;            // most readers ever inside at once
+
+
+//----------------------------------------------------------------------
+// RWReader
+// Benchmark thread that repeatedly enters a read-mostly critical section
+// in shared mode (or exclusively, if only the plain lock is in use).
+//----------------------------------------------------------------------
+void RWReader(int param) {
+  for(int i = 0; i < RWIterations; i++) {
+    if(rwLock) rwLock->AcquireRead(); else rwPlainLock->Acquire();
+
+    rwInside++;
+    rwMaxInside = max(rwMaxInside, rwInside);
+    MultiYield(RWHoldYields);
+    rwInside--;
+
+    if(rwLock) rwLock->ReleaseRead(); else rwPlainLock->Release();
+    currentThread->Yield();
+  }
+  rwDone->V();
+}
+
+
+//----------------------------------------------------------------------
+// RWWriter
+// Benchmark thread that repeatedly enters the critical section in
+// exclusive mode and checks that no reader is inside with it.
+//----------------------------------------------------------------------
+void RWWriter(int param) {
+  for(int i = 0; i < RWIterations; i++) {
+    if(rwLock) rwLock->AcquireWrite(); else rwPlainLock->Acquire();
+
+    ASSERT(rwInside == 0);
+    MultiYield(RWHoldYields);
+    ASSERT(rwInside == 0);
+
+    if(rwLock) rwLock->ReleaseWrite(); else rwPlainLock->Release();
+    MultiYield(RWReaders);
+  }
+  rwDone->V();
+}
+
+
+//----------------------------------------------------------------------
+// RWRunBenchmark
+// Helper method that runs RWReaders readers and RWWriters writers to
+// completion against the current lock, and reports the simulated time
+// taken and how many readers were ever inside at once.
+//
+// "label" names the lock being measured
+//----------------------------------------------------------------------
+void RWRunBenchmark(char * label) {
+  int start = stats->totalTicks;
+  Thread * t;
+
+  rwInside = rwMaxInside = 0;
+  rwDone = new Semaphore("RW benchmark done", 0);
+
+  for(int i = 0; i < RWReaders; i++) {
+    t = new Thread("RW reader", 0, StackSize / 4);
+    t->Fork(RWReader, i);
+  }
+  for(int i = 0; i < RWWriters; i++) {
+    t = new Thread("RW writer", 0, StackSize / 4);
+    t->Fork(RWWriter, i);
+  }
+
+  for(int i = 0; i < RWReaders + RWWriters; i++)
+    rwDone->P();
+
+  fprintf(stderr, "%s: %d ticks, at most %d readers inside at once\n",
+      label, stats->totalTicks - start, rwMaxInside);
+  delete rwDone;
+}
+
+
+//----------------------------------------------------------------------
+// RWLockContentionBenchmark
+// Compares a read-mostly workload on a plain Lock against the same
+// workload on a ReaderWriterLock. Readers should overlap only on the
+// ReaderWriterLock, and writers should never overlap with anyone.
+//----------------------------------------------------------------------
+void RWLockContentionBenchmark() {
+  fprintf(stderr, "%d readers and %d writers, %d critical sections each\n",
+      RWReaders, RWWriters, RWIterations);
+
+  rwLock = NULL;
+  rwPlainLock = new Lock("RW benchmark plain lock");
+  RWRunBenchmark("Lock");
+  delete rwPlainLock;
+
+  rwLock = new ReaderWriterLock("RW benchmark lock");
+  RWRunBenchmark("ReaderWriterLock");
+  delete rwLock;
+}
+
+
+//----------------------------------------------------------------------
+// RWNamedReader / RWNamedWriter
+// Helpers that take the lock, announce it, hold it across a few yields
+// and release it.
+//
+// "param" identifies the thread in the output
+//----------------------------------------------------------------------
+void RWNamedReader(int param) {
+  rwLock->AcquireRead();
+  fprintf(stderr, "Reader %d has the lock\n", param);
+  MultiYield(5);
+  rwLock->ReleaseRead();
+}
+
+void RWNamedWriter(int param) {
+  rwLock->AcquireWrite();
+  fprintf(stderr, "Writer %d has the lock\n", param);
+  MultiYield(5);
+  rwLock->ReleaseWrite();
+}
+
+
+//----------------------------------------------------------------------
+// RWLockWriterPreference
+// Tests that a reader arriving while a writer waits queues behind the
+// writer, and that the readers queued behind a writer are all let in
+// together when it releases.
+//----------------------------------------------------------------------
+void RWLockWriterPreference() {
+  rwLock = new ReaderWriterLock("RW preference lock");
+  Thread * t;
+
+  t = new Thread("reader 1");
+  t->Fork(RWNamedReader, 1);
+  MultiYield(1);
+
+  t = new Thread("writer 1");
+  t->Fork(RWNamedWriter, 1);
+  MultiYield(1);
+
+  for(int i = 2; i <= 4; i++) {
+    t = new Thread("queued reader");
+    t->Fork(RWNamedReader, i);
+  }
+
+  fprintf(stderr, "Expect reader 1, then writer 1, then readers 2-4 ");
+  fprintf(stderr, "together\n");
+  MultiYield(60);
+  delete rwLock;
+}
+
+
+//----------------------------------------------------------------------
+// SemaphoreWaiter
+// Helper method that waits on the test semaphore once.
+//----------------------------------------------------------------------
+Semaphore * batchSema;
+
+void SemaphoreWaiter(int param) {
+  batchSema->P();
+  fprintf(stderr, "Waiter %d woke up\n", param);
+}
+
+
+//----------------------------------------------------------------------
+// SemaphoreBatchV
+// Tests that V(n) wakes exactly n waiters at once.
+//----------------------------------------------------------------------
+void SemaphoreBatchV() {
+  batchSema = new Semaphore("batch semaphore", 0);
+  Thread * t;
+
+  for(int i = 0; i < 5; i++) {
+    t = new Thread("waiter");
+    t->Fork(SemaphoreWaiter, i);
+  }
+  MultiYield(10);
+
+  fprintf(stderr, "Calling V(3), three waiters should wake up\n");
+  batchSema->V(3);
+  MultiYield(10);
+
+  fprintf(stderr, "Calling V(2), the last two waiters should wake up\n");
+  batchSema->V(2);
+  MultiYield(10);
+
+  delete batchSema;
+}
+
+
+//----------------------------------------------------------------------
+// Mailbox throughput tests
+//----------------------------------------------------------------------
+#define MBMessages  240   // messages moved by each benchmark run
+#define MBBatch     8     // messages per SendMany/ReceiveMany
+
+Mailbox * mbSubject;  // mailbox being measured
+int mbBatched;        // use SendMany/ReceiveMany instead of Send/Receive
+int mbErrors;         // messages received out of order
+Semaphore * mbDone;   // V'ed by the receiver when all have arrived
+
+
+//----------------------------------------------------------------------
+// MBProducer
+// Benchmark thread that sends messages 0 to MBMessages-1, in order.
+//----------------------------------------------------------------------
+void MBProducer(int param) {
+  int batch[MBBatch];
+
+  for(int i = 0; i < MBMessages; ) {
+    if(mbBatched) {
+      int n = min(MBBatch, MBMessages - i);
+      for(int j = 0; j < n; j++)
+        batch[j] = i + j;
+      mbSubject->SendMany(batch, n);
+      i += n;
+    } else {
+      mbSubject->Send(i++);
+    }
+  }
+}
+
+
+//----------------------------------------------------------------------
+// MBConsumer
+// Benchmark thread that receives MBMessages messages and checks that
+// they arrive in the order they were sent.
+//----------------------------------------------------------------------
+void MBConsumer(int param) {
+  int batch[MBBatch];
+  int n;
+
+  for(int i = 0; i < MBMessages; ) {
+    if(mbBatched) {
+      n = mbSubject->ReceiveMany(batch, MBBatch);
+    } else {
+      mbSubject->Receive(batch);
+      n = 1;
+    }
+    for(int j = 0; j < n; j++, i++)
+      if(batch[j] != i)
+        mbErrors++;
+  }
+  mbDone->V();
+}
+
+
+//----------------------------------------------------------------------
+// MBRunBenchmark
+// Helper method that moves MBMessages messages from one producer to one
+// consumer through a fresh mailbox and reports the throughput.
+//
+// "label" describes the run
+// "capacity" is passed to the Mailbox constructor
+// "batched" selects SendMany/ReceiveMany
+//----------------------------------------------------------------------
+void MBRunBenchmark(char * label, int capacity, int batched) {
+  int start = stats->totalTicks;
+  int ticks;
+  Thread * t;
+
+  mbSubject = new Mailbox("benchmark mailbox", capacity);
+  mbBatched = batched;
+  mbErrors = 0;
+  mbDone = new Semaphore("mailbox benchmark done", 0);
+
+  t = new Thread("MB consumer");
+  t->Fork(MBConsumer, 0);
+  t = new Thread("MB producer");
+  t->Fork(MBProducer, 0);
+  mbDone->P();
+
+  ticks = stats->totalTicks - start;
+  fprintf(stderr, "%-28s %6d ticks, %5d messages per 1000 ticks, "
+      "%d out of order\n", label, ticks, (MBMessages * 1000) / ticks,
+      mbErrors);
+
+  delete mbDone;
+  delete mbSubject;
+}
+
+
+//----------------------------------------------------------------------
+// MailboxThroughputBenchmark
+// Compares the rendezvous Mailbox used by the MultiSender/MultiReceive
+// tests with bounded mailboxes, with and without batching.
+//----------------------------------------------------------------------
+void MailboxThroughputBenchmark() {
+  fprintf(stderr, "Moving %d messages from one thread to another\n",
+      MBMessages);
+  MBRunBenchmark("rendezvous Send/Receive", 0, 0);
+  MBRunBenchmark("capacity 1 Send/Receive", 1, 0);
+  MBRunBenchmark("capacity 8 Send/Receive", MBBatch, 0);
+  MBRunBenchmark("capacity 8 SendMany/ReceiveMany", MBBatch, 1);
+  MBRunBenchmark("capacity 32 SendMany/ReceiveMany", 4 * MBBatch, 1);
+}
+
+
+//----------------------------------------------------------------------
+// MailboxTryTest
+// Tests that TrySend/TryReceive never wait, on both kinds of mailbox.
+//----------------------------------------------------------------------
+void MailboxTryTest() {
+  int msg = -1;
+  Thread * t;
+
+  subject = new Mailbox("bounded mailbox", 2);
+  fprintf(stderr, "Bounded, empty: TryReceive gives %d (expect 0)\n",
+      subject->TryReceive(&msg));
+  int first = subject->TrySend(1);
+  int second = subject->TrySend(2);
+  int third = subject->TrySend(3);
+  fprintf(stderr, "Bounded: TrySend 1, 2, 3 give %d %d %d (expect 1 1 0)\n",
+      first, second, third);
+  subject->TryReceive(&msg);
+  fprintf(stderr, "Bounded: TryReceive got message %d (expect 1)\n", msg);
+  subject->Receive(&msg);
+  fprintf(stderr, "Bounded: Receive got message %d (expect 2)\n", msg);
+  delete subject;
+
+  subject = new Mailbox("rendezvous mailbox");
+  fprintf(stderr, "Rendezvous, no receiver: TrySend gives %d (expect 0)\n",
+      subject->TrySend(7));
+
+  buffer = &msg;
+  t = new Thread("receiver");
+  t->Fork(callReceive, 0);
+  MultiYield(10);
+  fprintf(stderr, "Rendezvous, receiver waiting: TrySend gives %d "
+      "(expect 1)\n", subject->TrySend(8));
+  MultiYield(10);
+  fprintf(stderr, "Receiver got message %d (expect 8)\n", msg);
+
+  message = 9;
+  t = new Thread("sender");
+  t->Fork(callSend, 0);
+  MultiYield(10);
+  int received = subject->TryReceive(&msg);
+  fprintf(stderr, "Rendezvous, sender waiting: TryReceive gives %d ",
+      received);
+  fprintf(stderr, "with message %d (expect 1 with 9)\n", msg);
+  MultiYield(10);
+  delete subject;
+}
+
+
 //----------------------------------------------------------------------
 // ThreadTest
 //  Invoke a test routine.
@@ -1487,6 +1843,21 @@ void ThreadTest() {
     case 36:  MatchmakerCrash();
               break;
 
+    case 37:  RWLockContentionBenchmark();
+              break;
+
+    case 38:  RWLockWriterPreference();
+              break;
+
+    case 39:  SemaphoreBatchV();
+              break;
+
+    case 40:  MailboxThroughputBenchmark();
+              break;
+
+    case 41:  MailboxTryTest();
+              break;
+
     default:  fprintf(stderr, "No test specified.\n");
               break;
   }
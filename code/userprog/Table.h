@@ -15,7 +15,8 @@ class Table {
     int Alloc(void * object);
 
     /* Retrieve the object from table slot at "index", or NULL if that
-       slot has not been allocated. */
+       slot has not been allocated.  Lookups only take the table lock
+       in shared mode, so they do not serialize behind each other. */
     void * Get(int index);
 
     /* Free the table slot at index. */
@@ -23,7 +24,7 @@ class Table {
 
   private:
 
-    Lock * lock;
+    ReaderWriterLock * lock;
 
     void ** tableptr;
 
@@ -74,6 +74,11 @@ static void SwapHeader (NoffHeader *noffH) {
 //----------------------------------------------------------------------
 
 AddrSpace::AddrSpace(OpenFile *executable) {
+  static int spacesCreated = 0;
+
+  programName = NULL;
+  profile = NULL;
+  traceID = ++spacesCreated;
   //fprintf(stderr, "CONSTRUCT %x\n", (unsigned int) this);
 }
 
@@ -90,6 +95,7 @@ AddrSpace::~AddrSpace() {
   pageTable = 0;
  // fprintf(stderr, "pageTable after: %x\n", (unsigned int)pageTable);
   delete [] argv;
+  delete [] programName;
   delete currentExecutable;
 }
 
@@ -174,6 +180,7 @@ int AddrSpace::allocVirtualPage(int virtualAddr) {
 
   bzero(machine->mainMemory + (pageTable[vpn].physicalPage * PageSize),
                                PageSize);
+  machine->InvalidateFrame(pageTable[vpn].physicalPage);
  
   int flag = 0;
 
@@ -268,6 +275,9 @@ void AddrSpace::SaveState() {}
 void AddrSpace::RestoreState() {
   machine->pageTable = pageTable;
   machine->pageTableSize = numPages;
+  machine->FlushTranslations();
+  machine->profile = profile;
+  machine->traceProcess = traceID;
 }
 
 
@@ -404,11 +414,13 @@ int AddrSpace::allocateThreadSpace() {
 
   delete pageTable;
   pageTable = newTable;
+  machine->FlushTranslations();	// they may point into the old table
 
   // zero out the entire address space, to zero the unitialized data segment
   // and the stack segment
   for(unsigned int i = numPages; i < numPages + newPages; i++) {
     bzero(machine->mainMemory + (pageTable[i].physicalPage * PageSize), PageSize);
+    machine->InvalidateFrame(pageTable[i].physicalPage);
   }
 
   numPages = numPages + newPages;
@@ -449,6 +461,44 @@ int AddrSpace::getStoreID() {
 }
 
 
+//----------------------------
+// setter for profile
+//----------------------------
+void AddrSpace::setProfile(ProfileImage * value) {
+  profile = value;
+}
+
+
+//----------------------------
+// getter for programName
+//----------------------------
+char * AddrSpace::getProgramName() {
+  return programName;
+}
+
+
+//----------------------------
+// setter for programName
+//----------------------------
+void AddrSpace::setProgramName(char * value) {
+  delete [] programName;
+  programName = new char[strlen(value) + 1];
+  strcpy(programName, value);
+}
+
+
+/*
+ * Replace the page table, and the address space's size with it; used
+ * when restoring a checkpoint, whose table may have grown by Forks
+ */
+void AddrSpace::setPageTable(TranslationEntry * table, unsigned int size) {
+  delete [] pageTable;
+  pageTable = table;
+  numPages = size;
+  machine->FlushTranslations();	// they may point into the old table
+}
+
+
 // MemoryManager Class //
 
 /*
@@ -489,6 +539,10 @@ int MemoryManager::AllocPage() {
 void MemoryManager::FreePage(int physPageNum) {
   lock->Acquire();
   pages->Clear(physPageNum);
+  // whatever was decoded or translated from the frame is dead now,
+  // whether it was evicted or its process exited
+  machine->InvalidateFrame(physPageNum);
+  machine->FlushTranslations();
   lock->Release();
 }
 
@@ -505,6 +559,17 @@ bool MemoryManager::PageIsAllocated(int physPageNum) {
 }
 
 
+/*
+ * Allocate a particular page, as it was when a checkpoint was taken
+ */
+void MemoryManager::TakePage(int physPageNum) {
+  lock->Acquire();
+  ASSERT(!pages->Test(physPageNum));
+  pages->Mark(physPageNum);
+  lock->Release();
+}
+
+
 
 //----------------------------
 // Constructor
@@ -597,12 +662,37 @@ void BackingStore::pageIn(int virtualPage) {
 
   file->ReadAt(&(machine->mainMemory[pte[virtualPage].physicalPage * PageSize]),
                PageSize, virtualPage * PageSize);
+  machine->InvalidateFrame(pte[virtualPage].physicalPage);
 
   pte[virtualPage].valid = TRUE;
   delete file;
 }
 
 
+//----------------------------
+// readPage - copy a page that has been paged out into "buffer"
+//----------------------------
+void BackingStore::readPage(int virtualPage, char * buffer) {
+  OpenFile * file = fileSystem->Open(filename);
+
+  ASSERT(pages->Test(virtualPage));
+  file->ReadAt(buffer, PageSize, virtualPage * PageSize);
+  delete file;
+}
+
+
+//----------------------------
+// writePage - store "buffer" as the paged out copy of a page
+//----------------------------
+void BackingStore::writePage(int virtualPage, char * buffer) {
+  OpenFile * file = fileSystem->Open(filename);
+
+  pages->Mark(virtualPage);
+  file->WriteAt(buffer, PageSize, virtualPage * PageSize);
+  delete file;
+}
+
+
 //----------------------------
 // check whether it's been written or not
 //----------------------------
@@ -840,6 +930,14 @@ void CoreMap::evictAll(BackingStore * bs) {
 }
 
 
+//----------------------------
+// getter for head
+//----------------------------
+CorePage * CoreMap::getHead() {
+  return head;
+}
+
+
 //----------------------------
 // Check if CoreMap is Full
 //----------------------------
@@ -27,6 +27,7 @@ class BitMap;
 class BackingStore;
 class CorePage;
 class CoreMap;
+class ProfileImage;
 
 class AddrSpace {
 public:
@@ -63,6 +64,13 @@ public:
     int getStoreID();
     void setStoreID(int value);
 
+    void setProfile(ProfileImage * value); // profile samples here
+
+    char * getProgramName(); // file the program was loaded from
+    void setProgramName(char * value);
+
+    void setPageTable(TranslationEntry * table, unsigned int size);
+
 private:
     TranslationEntry *pageTable;	// Assume linear page table translation
     // for now!
@@ -78,6 +86,10 @@ private:
 
     BackingStore * backingStore;
     int storeID;
+
+    char * programName;      // copy of the executable's file name
+    ProfileImage * profile;  // this program's profile, or NULL
+    int traceID;             // names this address space in memory traces
 };
 
 
@@ -101,6 +113,9 @@ class BackingStore {
     void pageOut(int virtualPage);
     void pageIn(int virtualPage);
 
+    void readPage(int virtualPage, char * buffer);  // copy a stored page
+    void writePage(int virtualPage, char * buffer); // store a page
+
     int contains(int virtualPage);
     
     AddrSpace * getSpace();
@@ -114,7 +129,7 @@ class MemoryManager {
 public:
 
   /* Create a manager to track the allocation of numPages of physical memory.  
-   You will create one by calling the constructor with NumPhysPages as
+   You will create one by calling the constructor with machine->numPhysPages as
    the parameter.  All physical pages start as free, unallocated pages. */
   MemoryManager(int numPages);
 
@@ -130,6 +145,10 @@ public:
   /* True if the physical page is allocated, false otherwise. */
   bool PageIsAllocated(int physPageNum);
 
+  /* Allocate the given physical page, which must be free; used to
+   rebuild memory from a checkpoint. */
+  void TakePage(int physPageNum);
+
 private:
   Lock * lock;     // For synchronization
   BitMap * pages;  // keep track of which pages are available
@@ -173,6 +192,8 @@ class CoreMap {
     void evictAll(BackingStore * backingStore);
 
     int isFull();
+
+    CorePage * getHead(); // oldest page, first to be considered for eviction
 };
 
 #endif // ADDRSPACE_H
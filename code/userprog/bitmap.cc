@@ -15,15 +15,23 @@
 //	it can be added somewhere on a list.
 //
 //	"nitems" is the number of bits in the bitmap.
+//	"size" is the number of bits in each group whose clear bits are
+//		counted, or 0 for no groups.
 //----------------------------------------------------------------------
 
-BitMap::BitMap(int nitems)
+BitMap::BitMap(int nitems, int size)
 {
     numBits = nitems;
     numWords = divRoundUp(numBits, BitsInWord);
     map = new unsigned int[numWords];
-    for (int i = 0; i < numBits; i++)
-        Clear(i);
+    for (int i = 0; i < numWords; i++)
+        map[i] = 0;
+    groupSize = size;
+    numGroups = (groupSize > 0) ? divRoundUp(numBits, groupSize) : 0;
+    groupClear = (numGroups > 0) ? new int[numGroups] : NULL;
+    Count();
+    dirtyLow = 0;			// never written back
+    dirtyHigh = numWords - 1;
 }
 
 //----------------------------------------------------------------------
@@ -34,6 +42,27 @@ BitMap::BitMap(int nitems)
 BitMap::~BitMap()
 {
     delete map;
+    delete [] groupClear;
+}
+
+//----------------------------------------------------------------------
+// BitMap::Count
+// 	Count the clear bits from scratch, in all and in each group.
+//	Afterwards Mark and Clear keep the counts up to date.
+//----------------------------------------------------------------------
+
+void
+BitMap::Count()
+{
+    numClear = 0;
+    for (int g = 0; g < numGroups; g++)
+        groupClear[g] = 0;
+    for (int i = 0; i < numBits; i++)
+        if (!Test(i)) {
+            numClear++;
+            if (groupClear != NULL)
+                groupClear[i / groupSize]++;
+        }
 }
 
 //----------------------------------------------------------------------
@@ -47,7 +76,14 @@ void
 BitMap::Mark(int which)
 {
     ASSERT(which >= 0 && which < numBits);
+    if (Test(which))
+        return;
     map[which / BitsInWord] |= 1 << (which % BitsInWord);
+    numClear--;
+    if (groupClear != NULL)
+        groupClear[which / groupSize]--;
+    dirtyLow = min(dirtyLow, which / BitsInWord);
+    dirtyHigh = max(dirtyHigh, which / BitsInWord);
 }
 
 //----------------------------------------------------------------------
@@ -61,7 +97,14 @@ void
 BitMap::Clear(int which)
 {
     ASSERT(which >= 0 && which < numBits);
+    if (!Test(which))
+        return;
     map[which / BitsInWord] &= ~(1 << (which % BitsInWord));
+    numClear++;
+    if (groupClear != NULL)
+        groupClear[which / groupSize]++;
+    dirtyLow = min(dirtyLow, which / BitsInWord);
+    dirtyHigh = max(dirtyHigh, which / BitsInWord);
 }
 
 //----------------------------------------------------------------------
@@ -82,6 +125,50 @@ BitMap::Test(int which)
         return FALSE;
 }
 
+//----------------------------------------------------------------------
+// BitMap::NextClear, BitMap::NextSet
+// 	Return the number of the first clear (or set) bit at or after
+//	"from", or numBits if there is none.  We look a word at a time:
+//	the lowest bit wanted in a word is found by counting the word's
+//	trailing zeroes, which the hardware does in one instruction.
+//	NextClear also steps over whole groups with no clear bits.
+//
+//	"from" is the first bit to look at
+//----------------------------------------------------------------------
+
+int
+BitMap::NextClear(int from)
+{
+    unsigned int word;
+
+    while (from < numBits) {
+        if (groupClear != NULL && groupClear[from / groupSize] == 0) {
+            from = (from / groupSize + 1) * groupSize;
+            continue;
+        }
+        word = ~map[from / BitsInWord] & (~0u << (from % BitsInWord));
+        if (word != 0)		// bits past numBits are clear, too
+            return min(from - from % BitsInWord + __builtin_ctz(word),
+                       numBits);
+        from += BitsInWord - from % BitsInWord;
+    }
+    return numBits;
+}
+
+int
+BitMap::NextSet(int from)
+{
+    unsigned int word;
+
+    while (from < numBits) {
+        word = map[from / BitsInWord] & (~0u << (from % BitsInWord));
+        if (word != 0)
+            return from - from % BitsInWord + __builtin_ctz(word);
+        from += BitsInWord - from % BitsInWord;
+    }
+    return numBits;
+}
+
 //----------------------------------------------------------------------
 // BitMap::Find
 // 	Return the number of the first bit which is clear.
@@ -94,12 +181,101 @@ BitMap::Test(int which)
 int
 BitMap::Find()
 {
-    for (int i = 0; i < numBits; i++)
-        if (!Test(i)) {
-            Mark(i);
-            return i;
+    return FindNear(0);
+}
+
+//----------------------------------------------------------------------
+// BitMap::FindNear
+// 	Return the number of the first clear bit at or after bit "goal",
+//	or if there is none, the first clear bit, and set it.
+//
+//	If no bits are clear, return -1.
+//
+//	"goal" is where to start looking
+//----------------------------------------------------------------------
+
+int
+BitMap::FindNear(int goal)
+{
+    int which;
+
+    if (numClear == 0)
+        return -1;
+    which = NextClear(goal % numBits);
+    if (which == numBits)
+        which = NextClear(0);
+    Mark(which);
+    return which;
+}
+
+//----------------------------------------------------------------------
+// BitMap::FindRun
+// 	Find the first run of "count" clear bits in a row, at or after
+//	bit "goal" (going round to the start of the map, if need be), or
+//	if there isn't one, the longest run there is, and set the bits.
+//	Return the number of the first bit in the run, and store how many
+//	were set in "found".
+//
+//	If no bits are clear, return -1.
+//
+//	"count" is the number of bits wanted
+//	"found" is where to store the number of bits set
+//	"goal" is where to start looking
+//----------------------------------------------------------------------
+
+int
+BitMap::FindRun(int count, int *found, int goal)
+{
+    int start, end, bestStart = -1, bestLength = 0;
+    int from, to;
+
+    goal %= numBits;
+    for (int pass = 0; pass < 2 && bestLength < count; pass++) {
+        from = (pass == 0) ? goal : 0;	// from the goal to the end,
+        to = (pass == 0) ? numBits : goal;	// then up to the goal
+        while (bestLength < count) {
+            start = NextClear(from);
+            if (start >= to)
+                break;
+            end = min(NextSet(start), start + count);
+            if (end - start > bestLength) {
+                bestStart = start;
+                bestLength = end - start;
+            }
+            from = end;
         }
-    return -1;
+    }
+    for (int i = 0; i < bestLength; i++)
+        Mark(bestStart + i);
+    *found = bestLength;
+    return bestStart;
+}
+
+//----------------------------------------------------------------------
+// BitMap::FindGroup
+// 	Return the first group at or after "group" (going round to the
+//	first group, if need be) with at least "count" clear bits, or if
+//	there isn't one, the group with the most.  No bits are set.
+//
+//	"group" is where to start looking
+//	"count" is the number of clear bits wanted
+//----------------------------------------------------------------------
+
+int
+BitMap::FindGroup(int group, int count)
+{
+    int g, best;
+
+    ASSERT(groupClear != NULL);
+    best = group % numGroups;
+    for (int i = 0; i < numGroups; i++) {
+        g = (group + i) % numGroups;
+        if (groupClear[g] >= count)
+            return g;
+        if (groupClear[g] > groupClear[best])
+            best = g;
+    }
+    return best;
 }
 
 //----------------------------------------------------------------------
@@ -111,11 +287,7 @@ BitMap::Find()
 int
 BitMap::NumClear()
 {
-    int count = 0;
-
-    for (int i = 0; i < numBits; i++)
-        if (!Test(i)) count++;
-    return count;
+    return numClear;
 }
 
 //----------------------------------------------------------------------
@@ -149,11 +321,16 @@ void
 BitMap::FetchFrom(OpenFile *file)
 {
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    Count();
+    dirtyLow = numWords;		// nothing changed yet
+    dirtyHigh = -1;
 }
 
 //----------------------------------------------------------------------
 // BitMap::WriteBack
-// 	Store the contents of a bitmap to a Nachos file.
+// 	Store the contents of a bitmap to a Nachos file.  Only the words
+//	changed since the bitmap was fetched or last written back are
+//	written; all of them, the first time a new bitmap is written.
 //
 //	"file" is the place to write the bitmap to
 //----------------------------------------------------------------------
@@ -161,5 +338,11 @@ BitMap::FetchFrom(OpenFile *file)
 void
 BitMap::WriteBack(OpenFile *file)
 {
-    file->WriteAt((char *)map, numWords * sizeof(unsigned), 0);
+    if (dirtyLow > dirtyHigh)
+        return;				// nothing changed
+    file->WriteAt((char *)&map[dirtyLow],
+                  (dirtyHigh - dirtyLow + 1) * sizeof(unsigned),
+                  dirtyLow * sizeof(unsigned));
+    dirtyLow = numWords;
+    dirtyHigh = -1;
 }
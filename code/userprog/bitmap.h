@@ -6,7 +6,9 @@
 //	modulo arithmetic to find the bit we are interested in.
 //
 //	The bitmap can be parameterized with with the number of bits being
-//	managed.
+//	managed, and optionally with the size of groups of bits (such as
+//	the sectors of a disk track) whose clear bits are to be counted, so
+//	that a search can skip groups with none.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation
@@ -33,8 +35,11 @@
 
 class BitMap {
 public:
-    BitMap(int nitems);		// Initialize a bitmap, with "nitems" bits
-    // initially, all bits are cleared.
+    BitMap(int nitems, int groupSize = 0);
+    // Initialize a bitmap, with "nitems" bits
+    // initially, all bits are cleared;
+    // count the clear bits in each group
+    // of "groupSize", if it isn't 0
     ~BitMap();			// De-allocate bitmap
 
     void Mark(int which);   	// Set the "nth" bit
@@ -43,6 +48,15 @@ public:
     int Find();            	// Return the # of a clear bit, and as a side
     // effect, set the bit.
     // If no bits are clear, return -1.
+    int FindNear(int goal);	// Find and set a clear bit, at or
+    // after "goal" if there is one
+    int FindRun(int count, int *found, int goal = 0);
+    // Find and set a run of up to "count"
+    // clear bits, as long as possible,
+    // looking from "goal" on
+    int FindGroup(int group, int count);
+    // Find a group, from "group" on, with
+    // at least "count" clear bits
     int NumClear();		// Return the number of clear bits
 
     void Print();		// Print contents of bitmap
@@ -50,15 +64,25 @@ public:
     // These aren't needed until FILESYS, when we will need to read and
     // write the bitmap to a file
     void FetchFrom(OpenFile *file); 	// fetch contents from disk
-    void WriteBack(OpenFile *file); 	// write contents to disk
+    void WriteBack(OpenFile *file); 	// write changed contents to disk
 
 private:
+    int NextClear(int from);		// First clear bit from "from" on
+    int NextSet(int from);		// First set bit from "from" on
+    void Count();			// Recount the clear bits
+
     int numBits;			// number of bits in the bitmap
     int numWords;			// number of words of bitmap storage
     // (rounded up if numBits is not a
     //  multiple of the number of bits in
     //  a word)
     unsigned int *map;			// bit storage
+    int numClear;			// number of clear bits
+    int groupSize;			// bits in each group, or 0
+    int numGroups;
+    int *groupClear;			// number of clear bits in each group
+    int dirtyLow, dirtyHigh;		// the words changed since the last
+    // FetchFrom or WriteBack
 };
 
 #endif // BITMAP_H
@@ -0,0 +1,415 @@
+// checkpoint.cc
+//	Routines to write the state of the simulated machine to a UNIX
+//	file, and to restore it at start-up.  See checkpoint.h for what
+//	is saved, and when a checkpoint can be taken.
+//
+//	The file is a sequence of 4 byte little-endian words, except for
+//	main memory and backing store pages, which are copied as they are
+//	(they are already in the simulated machine's byte order):
+//
+//	    magic, memory size, PageSize, frames, TLB entries (or 0)
+//	    totalTicks, idleTicks, systemTicks, userTicks
+//	    registers, main memory, TLB entries
+//	    number of pending interrupts, then type and time of each
+//	    program name, process table slot, backing store id
+//	    number of pages, then each page table entry
+//	    for each frame, whether it is allocated
+//	    number of core map entries, then physical and virtual page of
+//		each, oldest first
+//	    for each page in the backing store, its number and contents,
+//		then -1
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "checkpoint.h"
+#include "addrspace.h"
+#include "syscall.h"
+#include "Table.h"
+
+#include <stdio.h>
+
+extern MemoryManager * memoryManager;
+extern Table * TablePtr;
+extern Table * storeTable;
+extern CoreMap * coreMap;
+
+//----------------------------------------------------------------------
+// PutWord, GetWord
+// 	Write or read one word of a checkpoint.  GetWord sets "*ok" to
+//	FALSE if the file ends early.
+//----------------------------------------------------------------------
+
+static void PutWord(FILE *file, int value) {
+  unsigned int word = WordToMachine((unsigned int) value);
+
+  fwrite(&word, 4, 1, file);
+}
+
+static int GetWord(FILE *file, bool *ok) {
+  unsigned int word = 0;
+
+  if (fread(&word, 4, 1, file) != 1)
+    *ok = FALSE;
+  return (int) WordToHost(word);
+}
+
+static void PutEntry(FILE *file, TranslationEntry *entry) {
+  PutWord(file, entry->virtualPage);
+  PutWord(file, entry->physicalPage);
+  PutWord(file, entry->valid);
+  PutWord(file, entry->use);
+  PutWord(file, entry->dirty);
+  PutWord(file, entry->readOnly);
+}
+
+static void GetEntry(FILE *file, TranslationEntry *entry, bool *ok) {
+  entry->virtualPage = GetWord(file, ok);
+  entry->physicalPage = GetWord(file, ok);
+  entry->valid = (GetWord(file, ok) != 0);
+  entry->use = (GetWord(file, ok) != 0);
+  entry->dirty = (GetWord(file, ok) != 0);
+  entry->readOnly = (GetWord(file, ok) != 0);
+}
+
+//----------------------------------------------------------------------
+// CanCheckpoint
+// 	Return TRUE if the whole system is one user thread, which was
+//	running user code when the checkpoint interrupt came; set
+//	"*slot" to its process table slot.
+//----------------------------------------------------------------------
+
+static bool CanCheckpoint(int *slot) {
+  AddrSpace *space = currentThread->space;
+  Thread *thread;
+  BackingStore *store;
+
+  if (interrupt->getInterruptedStatus() != UserMode || space == NULL
+      || space->getProgramName() == NULL || !scheduler->IsEmpty()
+      || TablePtr == NULL)
+    return FALSE;
+  if (space->getThreadCount() != 1 || currentThread->getPipeValue() != 0)
+    return FALSE;
+
+  *slot = -1;
+  for (int i = 0; i < MAXPROCESS; i++) {
+    thread = (Thread *) TablePtr->Get(i);
+    if (thread == currentThread)
+      *slot = i;
+    else if (thread != NULL)
+      return FALSE;
+    store = (BackingStore *) storeTable->Get(i);
+    if (store != NULL && store != space->getBackingStore())
+      return FALSE;
+  }
+  return (*slot >= 0);
+}
+
+//----------------------------------------------------------------------
+// WriteCheckpoint
+// 	Write everything needed to restore the running process to
+//	"fileName".  Called with interrupts off, so nothing changes
+//	while we do.
+//----------------------------------------------------------------------
+
+static void WriteCheckpoint(char *fileName, int slot) {
+  AddrSpace *space = currentThread->space;
+  BackingStore *store = space->getBackingStore();
+  TranslationEntry *pageTable = space->getPageTable();
+  IntType types[MaxPendingSaved];
+  int whens[MaxPendingSaved];
+  char page[PageSize];
+  char *name = space->getProgramName();
+  int numPending, numCore, i;
+  CorePage *corePage;
+  FILE *file;
+
+  file = fopen(fileName, "wb");
+  if (file == NULL) {
+    fprintf(stderr, "Couldn't write checkpoint %s\n", fileName);
+    return;
+  }
+
+  PutWord(file, CheckpointMagic);
+  PutWord(file, machine->memorySize);
+  PutWord(file, PageSize);
+  PutWord(file, machine->numPhysPages);
+  PutWord(file, (machine->tlb != NULL) ? machine->tlbSize : 0);
+
+  PutWord(file, stats->totalTicks);
+  PutWord(file, stats->idleTicks);
+  PutWord(file, stats->systemTicks);
+  PutWord(file, stats->userTicks);
+
+  for (i = 0; i < NumTotalRegs; i++)
+    PutWord(file, machine->ReadRegister(i));
+  fwrite(machine->mainMemory, 1, machine->memorySize, file);
+  if (machine->tlb != NULL)
+    for (i = 0; i < machine->tlbSize; i++)
+      PutEntry(file, &machine->tlb[i]);
+
+  numPending = interrupt->Pending(types, whens, MaxPendingSaved);
+  if (numPending > MaxPendingSaved)
+    numPending = MaxPendingSaved;
+  PutWord(file, numPending);
+  for (i = 0; i < numPending; i++) {
+    PutWord(file, types[i]);
+    PutWord(file, whens[i]);
+  }
+
+  PutWord(file, strlen(name));
+  fwrite(name, 1, strlen(name), file);
+  PutWord(file, slot);
+  PutWord(file, store->getStoreID());
+  PutWord(file, space->getNumPages());
+  for (i = 0; i < (int) space->getNumPages(); i++)
+    PutEntry(file, &pageTable[i]);
+
+  for (i = 0; i < machine->numPhysPages; i++)
+    PutWord(file, memoryManager->PageIsAllocated(i));
+  numCore = 0;
+  for (corePage = coreMap->getHead(); corePage != NULL;
+       corePage = corePage->getNext())
+    numCore++;
+  PutWord(file, numCore);
+  for (corePage = coreMap->getHead(); corePage != NULL;
+       corePage = corePage->getNext()) {
+    PutWord(file, corePage->getPhysicalPage());
+    PutWord(file, corePage->getVirtualPage());
+  }
+
+  for (i = 0; i < (int) space->getNumPages(); i++)
+    if (store->contains(i)) {
+      store->readPage(i, page);
+      PutWord(file, i);
+      fwrite(page, 1, PageSize, file);
+    }
+  PutWord(file, -1);
+
+  if (fclose(file) != 0)
+    fprintf(stderr, "Couldn't write checkpoint %s\n", fileName);
+  else
+    printf("Checkpoint of %s written to %s at time %d\n", name, fileName,
+           stats->totalTicks);
+}
+
+//----------------------------------------------------------------------
+// CheckpointHandler
+// 	Interrupt handler for "-ck": write the checkpoint if the system
+//	can be restored from this point, and otherwise try again a little
+//	later.
+//
+//	"arg" is the name of the file to write, cast to an int.
+//----------------------------------------------------------------------
+
+static void CheckpointHandler(int arg) {
+  int slot;
+
+  if (!CanCheckpoint(&slot)) {
+    DEBUG('a', "Can't checkpoint at time %d, retrying\n", stats->totalTicks);
+    interrupt->Schedule(CheckpointHandler, arg, CheckpointRetry,
+                        CheckpointInt);
+    return;
+  }
+  WriteCheckpoint((char *) arg, slot);
+}
+
+//----------------------------------------------------------------------
+// ScheduleCheckpoint
+// 	Arrange for a checkpoint to be written to "fileName", at simulated
+//	time "when" or soon after.
+//----------------------------------------------------------------------
+
+void ScheduleCheckpoint(char *fileName, int when) {
+#ifdef FILESYS_STUB
+  int fromNow = when - stats->totalTicks;
+
+  interrupt->Schedule(CheckpointHandler, (int) fileName,
+                      (fromNow > 0) ? fromNow : 1, CheckpointInt);
+#else
+  fprintf(stderr, "Checkpoints need FILESYS_STUB; ignoring -ck\n");
+#endif
+}
+
+//----------------------------------------------------------------------
+// AllocSlot
+// 	Put "object" in slot "slot" of "table", which is empty: Alloc
+//	hands out the lowest free slot, so fill the ones before it, then
+//	free them again.
+//----------------------------------------------------------------------
+
+static void AllocSlot(Table *table, void *object, int slot) {
+  for (int i = 0; i < slot; i++)
+    table->Alloc(object);
+  ASSERT(table->Alloc(object) == slot);
+  for (int i = 0; i < slot; i++)
+    table->Release(i);
+}
+
+//----------------------------------------------------------------------
+// RestoreCheckpoint
+// 	Read the checkpoint in "fileName", and make its process the one
+//	the current thread runs.  The process tables, core map and memory
+//	manager must have been created, and be empty.
+//
+//	Returns FALSE, after saying why, if the file isn't a checkpoint
+//	of a machine configured like this one.
+//----------------------------------------------------------------------
+
+bool RestoreCheckpoint(char *fileName) {
+  FILE *file = fopen(fileName, "rb");
+  bool ok = TRUE;
+  TranslationEntry *pageTable;
+  BackingStore *store;
+  AddrSpace *space;
+  OpenFile *executable;
+  IntType types[MaxPendingSaved];
+  int whens[MaxPendingSaved], ticks[4];
+  char page[PageSize];
+  char *name;
+  int numPending, length, slot, storeID, numPages, numCore;
+  int physicalPage, i;
+
+  if (file == NULL) {
+    fprintf(stderr, "Unable to open checkpoint %s\n", fileName);
+    return FALSE;
+  }
+  if (GetWord(file, &ok) != CheckpointMagic || !ok) {
+    fprintf(stderr, "%s is not a Nachos checkpoint\n", fileName);
+    fclose(file);
+    return FALSE;
+  }
+  if (GetWord(file, &ok) != machine->memorySize
+      || GetWord(file, &ok) != PageSize
+      || GetWord(file, &ok) != machine->numPhysPages
+      || GetWord(file, &ok)
+         != ((machine->tlb != NULL) ? machine->tlbSize : 0)) {
+    fprintf(stderr, "Checkpoint %s is of a differently configured machine "
+            "(see -np and -nt)\n", fileName);
+    fclose(file);
+    return FALSE;
+  }
+
+  for (i = 0; i < 4; i++)
+    ticks[i] = GetWord(file, &ok);
+
+  for (i = 0; i < NumTotalRegs; i++)
+    machine->WriteRegister(i, GetWord(file, &ok));
+  if (fread(machine->mainMemory, 1, machine->memorySize, file)
+      != (size_t) machine->memorySize)
+    ok = FALSE;
+  for (i = 0; i < machine->numPhysPages; i++)
+    machine->InvalidateFrame(i);
+  if (machine->tlb != NULL)
+    for (i = 0; i < machine->tlbSize; i++)
+      GetEntry(file, &machine->tlb[i], &ok);
+
+  numPending = GetWord(file, &ok);
+  if (numPending < 0 || numPending > MaxPendingSaved)
+    ok = FALSE;
+  for (i = 0; i < numPending && ok; i++) {
+    types[i] = (IntType) GetWord(file, &ok);
+    whens[i] = GetWord(file, &ok);
+  }
+
+  length = GetWord(file, &ok);
+  if (!ok || length <= 0 || length > MAXSIZE) {
+    fprintf(stderr, "Checkpoint %s is damaged\n", fileName);
+    fclose(file);
+    return FALSE;
+  }
+  name = new char[length + 1];
+  if (fread(name, 1, length, file) != (size_t) length)
+    ok = FALSE;
+  name[length] = '\0';
+  slot = GetWord(file, &ok);
+  storeID = GetWord(file, &ok);
+  numPages = GetWord(file, &ok);
+  if (!ok || slot < 0 || slot >= MAXPROCESS || storeID < 0
+      || storeID >= MAXPROCESS || numPages <= 0) {
+    fprintf(stderr, "Checkpoint %s is damaged\n", fileName);
+    delete [] name;
+    fclose(file);
+    return FALSE;
+  }
+  pageTable = new TranslationEntry[numPages];
+  for (i = 0; i < numPages; i++)
+    GetEntry(file, &pageTable[i], &ok);
+
+  // the program is read again as pages of it are faulted in
+  executable = fileSystem->Open(name);
+  if (executable == NULL) {
+    fprintf(stderr, "Unable to open file %s\n", name);
+    delete [] name;
+    delete [] pageTable;
+    fclose(file);
+    return FALSE;
+  }
+  store = new BackingStore();
+  AllocSlot(storeTable, store, storeID);
+  space = new AddrSpace(executable);
+  if (space->Initialize(executable) != 0) {
+    fprintf(stderr, "Couldn't Initialize Process\n");
+    delete [] name;
+    delete [] pageTable;
+    fclose(file);
+    return FALSE;
+  }
+  space->setPageTable(pageTable, numPages);
+  space->setProgramName(name);
+  if (store->Initialize(space, storeID) != 0) {
+    fprintf(stderr, "Couldn't Initialize Backing Store\n");
+    delete [] name;
+    fclose(file);
+    return FALSE;
+  }
+
+  for (i = 0; i < machine->numPhysPages; i++)
+    if (GetWord(file, &ok))
+      memoryManager->TakePage(i);
+  numCore = GetWord(file, &ok);
+  for (i = 0; i < numCore && ok; i++) {
+    physicalPage = GetWord(file, &ok);
+    coreMap->addCorePage(new CorePage(store, physicalPage,
+                                      GetWord(file, &ok)));
+  }
+  while (ok && (i = GetWord(file, &ok)) >= 0) {
+    if (i >= numPages || fread(page, 1, PageSize, file) != PageSize) {
+      ok = FALSE;
+      break;
+    }
+    store->writePage(i, page);
+  }
+  fclose(file);
+  if (!ok) {
+    fprintf(stderr, "Checkpoint %s is damaged\n", fileName);
+    delete [] name;
+    return FALSE;
+  }
+
+  currentThread->space = space;
+  space->setThreadCount(1);
+  if (profiler != NULL)
+    space->setProfile(profiler->ImageFor(name, numPages * PageSize));
+  AllocSlot(TablePtr, currentThread, slot);
+  space->RestoreState();		// load page table register
+
+  // the kernel work above has moved the clock on, and the devices have
+  // scheduled their first interrupts; put them back where they were
+  stats->totalTicks = ticks[0];
+  stats->idleTicks = ticks[1];
+  stats->systemTicks = ticks[2];
+  stats->userTicks = ticks[3];
+  for (i = 0; i < numPending; i++)
+    if (!interrupt->Reschedule(types[i], whens[i]))
+      DEBUG('a', "Checkpoint had an interrupt of type %d, we have none\n",
+            types[i]);
+
+  printf("Restored %s from %s at time %d\n", name, fileName,
+         stats->totalTicks);
+  delete [] name;
+  return TRUE;
+}
@@ -0,0 +1,49 @@
+// checkpoint.h
+//	Save the whole simulated machine to a UNIX file, and start Nachos
+//	again from it later, so a benchmark can skip its start-up (process
+//	creation, demand paging, filling the core map) and be run again
+//	and again from the same warm state.
+//
+//	"nachos -ck <file> <time> -x <program>" writes a checkpoint at the
+//	first moment, at or after simulated time <time>, that the machine
+//	is in a state we can write out: one process, with one thread,
+//	interrupted while running user code, and no other thread in the
+//	system.  Nachos threads run on host stacks, which can't be saved,
+//	so one blocked in the kernel (or waiting on the ready list) could
+//	not be restored; until there are none, the checkpoint waits.
+//	"nachos -xk <file>" then starts from the checkpoint, instead of
+//	loading a program.
+//
+//	A checkpoint holds the CPU registers, main memory and TLB, the
+//	process's page table, the core map and the frames in use, the
+//	pages in its backing store, and when each pending device interrupt
+//	is due.  The clock carries on from the checkpoint; the other
+//	statistics start from zero, so they count only the run after it.
+//
+//	Restrictions: checkpoints are written from an interrupt handler,
+//	which must not wait for the disk, so they need FILESYS_STUB (the
+//	backing store is in UNIX files).  Pipes and console input not yet
+//	read aren't saved.  With "-rs", the timer's random intervals after
+//	a restore follow the seed given then.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "copyright.h"
+
+#define CheckpointMagic	0x4e434b50	// "NCKP"
+#define CheckpointRetry	100	// ticks to wait, if we can't checkpoint yet
+#define MaxPendingSaved	16	// most pending interrupts we keep
+
+// Write a checkpoint to "fileName" once it is "when" or later
+extern void ScheduleCheckpoint(char *fileName, int when);
+
+// Rebuild the process saved in "fileName", ready for Machine::Run.
+// Returns FALSE if the file isn't a usable checkpoint.
+extern bool RestoreCheckpoint(char *fileName);
+
+#endif // CHECKPOINT_H
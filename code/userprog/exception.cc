@@ -43,7 +43,7 @@ extern CoreMap * coreMap;
  * Table's constructor
  */
 Table::Table(int size){
-  lock = new Lock("lock for the table in syscall");
+  lock = new ReaderWriterLock("lock for the table in syscall");
   tableSize = size;
   tableptr = new void*[size];
 
@@ -56,35 +56,36 @@ Table::Table(int size){
  * Alloc - Allocates void pointers to a table for later access
  */
 int Table::Alloc(void * object){
-  lock->Acquire();
+  lock->AcquireWrite();
 
   for(int i = 0; i < tableSize; i++) {
     if(tableptr[i] == NULL) {
       tableptr[i] = object;
-      lock->Release();
+      lock->ReleaseWrite();
       return i;
     }
   }
 
-  lock->Release();
+  lock->ReleaseWrite();
 
   return -1;
 }
 
 /*
- * Get - Gets a void pointer at a particular index in the table
+ * Get - Gets a void pointer at a particular index in the table.
+ * Readers share the lock, so concurrent lookups don't block each other.
  */
 void * Table:: Get(int index) {
-  lock->Acquire();
+  lock->AcquireRead();
 
   if(index >= tableSize || index < 0 ) {
-    lock->Release();
+    lock->ReleaseRead();
     return NULL;
   }
 
   void * toReturn = tableptr[index];
 
-  lock->Release();
+  lock->ReleaseRead();
 
   return toReturn;
 }
@@ -93,16 +94,16 @@ void * Table:: Get(int index) {
  * Release - Removes a void pointer from the table at a particular index
  */
 void Table::Release(int index) { 
-  lock->Acquire();  
+  lock->AcquireWrite();
 
   if(index >= tableSize || index < 0 ) {
-    lock->Release();
+    lock->ReleaseWrite();
     return;
   }
 
   tableptr[index] = NULL;
 
-  lock->Release();
+  lock->ReleaseWrite();
 }
 
 
@@ -473,6 +474,10 @@ SpaceId Exec2(char *name, int argc, char **argv, int willJoin) {
 
  // delete executable;			// close file
   space->setThreadCount(space->getThreadCount()+1);
+  space->setProgramName(internalFilename);
+  if (profiler != NULL)
+    space->setProfile(profiler->ImageFor(internalFilename,
+                                         space->getNumPages() * PageSize));
 
   newCurrentThread->Fork(ProcessStartExec, 0);
 
@@ -727,6 +732,9 @@ void ExceptionHandler(ExceptionType which)
     if(type == SC_Halt) {
       
       DEBUG('a', "Shutdown, initiated by user program.\n");
+#ifdef FILESYS
+      bufferCache->Flush();	// Halt doesn't wait for the flusher
+#endif
       interrupt->Halt();
     }
 
@@ -16,6 +16,7 @@
 #include "syscall.h"
 #include "Table.h"
 #include "SynchConsole.h"
+#include "checkpoint.h"
 
 int MAXPROCESS = 14;
 
@@ -33,18 +34,25 @@ CoreMap * coreMap;
 // StartProcess
 // 	Run a user program.  Open the executable, load it into
 //	memory, and jump to it.
+//
+//	InitProcessTables sets up the memory manager, core map and process
+//	tables that every user program shares.
 //----------------------------------------------------------------------
 
-void StartProcess(char *filename) {
-  OpenFile *executable = fileSystem->Open(filename);
-  AddrSpace *space;
-
-  memoryManager = new MemoryManager(NumPhysPages);
+static void InitProcessTables() {
+  memoryManager = new MemoryManager(machine->numPhysPages);
   TablePtr = new Table(MAXPROCESS);
   storeTable = new Table(MAXPROCESS);
   synchConsole = new SynchConsole(NULL, NULL);
   
-  coreMap = new CoreMap(NumPhysPages);
+  coreMap = new CoreMap(machine->numPhysPages);
+}
+
+void StartProcess(char *filename) {
+  OpenFile *executable = fileSystem->Open(filename);
+  AddrSpace *space;
+
+  InitProcessTables();
 
   if (executable == NULL) {
     printf("Unable to open file %s\n", filename);
@@ -78,6 +86,10 @@ void StartProcess(char *filename) {
   }
 
   space->setThreadCount(space->getThreadCount() + 1);
+  space->setProgramName(filename);
+  if (profiler != NULL)
+    space->setProfile(profiler->ImageFor(filename,
+                                         space->getNumPages() * PageSize));
 
   space->InitRegisters();		// set the initial register values
   space->RestoreState();		// load page table register
@@ -90,6 +102,22 @@ void StartProcess(char *filename) {
   // by doing the syscall "exit"
 }
 
+//----------------------------------------------------------------------
+// RestoreProcess
+// 	Run a user program from where a checkpoint of it was taken (see
+//	checkpoint.h), instead of from its beginning.
+//----------------------------------------------------------------------
+
+void RestoreProcess(char *checkpointFile) {
+  InitProcessTables();
+
+  if (!RestoreCheckpoint(checkpointFile))
+    return;
+
+  machine->Run();			// carry on with the user program
+  ASSERT(FALSE);			// machine->Run never returns
+}
+
 // Data structures needed for the console test.  Threads making
 // I/O requests wait on a Semaphore to delay until the I/O completes.
 